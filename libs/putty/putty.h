@@ -943,6 +943,9 @@ void cleanup_exit(int);
     X(INT, NONE, sndbuf) \
     X(INT, NONE, force_remote_cmd2) \
     X(INT, NONE, change_password) \
+    X(INT, NONE, ssh2_maxpkt) /* 0 = default SSH-2 channel max packet */ \
+    X(INT, NONE, compression_level) /* 0 = built-in sshzlib.c */ \
+    X(INT, NONE, ssh_crypto_thread) /* seal outgoing packets on a worker */ \
     /* MPEXT END */ \
 
 /* Now define the actual enum of option keywords using that macro. */
@@ -23,6 +23,8 @@ int get_ssh_state_closed(void * handle);
 int get_ssh_state_session(void * handle);
 int get_ssh_exitcode(void * handle);
 const unsigned int * ssh2_remmaxpkt(void * handle);
+unsigned long get_ssh_packet_allocations(void * handle);
+void ssh_crypto_flush(void * handle, int wait);
 const unsigned int * ssh2_remwindow(void * handle);
 void md5checksum(const char * buffer, int len, unsigned char output[16]);
 typedef const struct ssh_signkey * cp_ssh_signkey;
@@ -65,6 +67,10 @@ void select_result(WPARAM wParam, LPARAM lParam);
 
 extern const struct ssh_compress ssh_zlib;
 
+// from sshzlibx.c
+
+extern const struct ssh_compress ssh_zlibx;
+
 // from sshaes.c
 
 void * call_aes_make_context();
@@ -359,6 +359,11 @@ static unsigned char *ssh2_mpint_fmt(Bignum b, int *len);
 static void ssh1_pkt_addmp(struct Packet *, Bignum b);
 static void ssh2_pkt_addmp(struct Packet *, Bignum b);
 static int ssh2_pkt_construct(Ssh, struct Packet *);
+#ifdef MPEXT
+static void ssh2_seal_flush(Ssh, int);
+static int ssh2_open_pipelined(Ssh);
+static void ssh2_open_submit(Ssh, struct Packet *);
+#endif
 static void ssh2_pkt_send(Ssh, struct Packet *);
 static void ssh2_pkt_send_noqueue(Ssh, struct Packet *);
 static int do_ssh1_login(Ssh ssh, const unsigned char *in, int inlen,
@@ -406,6 +411,11 @@ static void ssh2_msg_something_unimplemented(Ssh ssh, struct Packet *pktin);
  *  - OUR_V2_PACKETLIMIT is actually the maximum size of SSH
  *    _packet_ we're prepared to cope with.  It must be a multiple
  *    of the cipher block size, and must be at least 35000.
+ *
+ *  - OUR_V2_MAXPKT_LIMIT is the largest "maximum packet size" we
+ *    advertise when CONF_ssh2_maxpkt asks for bigger channel data
+ *    messages. The packet limit and the default window then grow
+ *    in proportion (see ssh2_init_packet_limits).
  */
 
 #define SSH1_BUFFER_LIMIT 32768
@@ -414,6 +424,14 @@ static void ssh2_msg_something_unimplemented(Ssh ssh, struct Packet *pktin);
 #define OUR_V2_BIGWIN 0x7fffffff
 #define OUR_V2_MAXPKT 0x4000UL
 #define OUR_V2_PACKETLIMIT 0x9000UL
+#define OUR_V2_MAXPKT_LIMIT 0x40000UL
+
+/*
+ * SSH_PACKET_POOL_SIZE is the number of spare SSH-2 packets (with
+ * their data buffers) a connection keeps for reuse. Packets are
+ * normally sent or dispatched one at a time, so a few are plenty.
+ */
+#define SSH_PACKET_POOL_SIZE 8
 
 struct ssh_signkey_with_user_pref_id {
     const struct ssh_signkey *alg;
@@ -458,6 +476,9 @@ const static struct ssh_compress ssh_comp_none = {
     ssh_comp_none_disable, NULL
 };
 extern const struct ssh_compress ssh_zlib;
+#ifdef MPEXT
+extern const struct ssh_compress ssh_zlibx;
+#endif
 const static struct ssh_compress *const compressions[] = {
     &ssh_zlib, &ssh_comp_none
 };
@@ -558,6 +579,11 @@ struct ssh_channel {
 	    unsigned remwindow, remmaxpkt;
 	    /* locwindow is signed so we can cope with excess data. */
 	    int locwindow, locmaxwin;
+	    /*
+	     * Total data received on the channel, used to estimate the
+	     * bandwidth-delay product in high-throughput mode.
+	     */
+	    unsigned long rcvd;
 	    /*
 	     * remlocwin is the amount of local window that we think
 	     * the remote end had available to it after it sent the
@@ -662,7 +688,7 @@ struct Packet {
     long length;	    /* length of packet: see below */
     long forcepad;	    /* SSH-2: force padding to at least this length */
     int type;		    /* only used for incoming packets */
-    unsigned long sequence; /* SSH-2 incoming sequence number */
+    unsigned long sequence; /* SSH-2 sequence number */
     unsigned char *data;    /* allocated storage */
     unsigned char *body;    /* offset of payload within `data' */
     long savedpos;	    /* dual-purpose saved packet position: see below */
@@ -698,6 +724,33 @@ struct Packet {
      * static string - it will not be freed. */
     unsigned downstream_id;
     const char *additional_log_text;
+
+    /* Pool the packet returns to when freed (NULL if not pooled). */
+    struct ssh_packet_pool *pool;
+    struct Packet *next_free;
+
+#ifdef MPEXT
+    /* Packets on the crypto worker: outgoing ones being sealed (see
+     * ssh2_pkt_send_pipelined), incoming ones being opened (see
+     * ssh2_open_pipelined). crypto_ok is the incoming MAC result. */
+    Ssh crypto_ssh;
+    struct Packet *crypto_next;
+    unsigned long crypto_job;
+    int crypto_len;
+    int crypto_ok;
+#endif
+};
+
+/*
+ * Per-connection cache of SSH-2 packets. A pool may outlive its
+ * connection until the last packet allocated from it is freed.
+ */
+struct ssh_packet_pool {
+    struct Packet *head;	    /* spare packets, linked by next_free */
+    int count;			    /* number of spare packets */
+    int live;			    /* packets handed out and not freed */
+    int closed;			    /* connection has been freed */
+    unsigned long allocations;	    /* heap allocations made for packets */
 };
 
 static void ssh1_protocol(Ssh ssh, const void *vin, int inlen,
@@ -736,7 +789,7 @@ struct rdpkt1_state_tag {
 };
 
 struct rdpkt2_state_tag {
-    long len, pad, payload, packetlen, maclen;
+    long len, packetlen, maclen;
     int i;
     int cipherblk;
     unsigned long incoming_sequence;
@@ -778,6 +831,13 @@ struct ssh_tag {
     int agentfwd_enabled;
     int X11_fwd_enabled;
     int remote_bugs;
+    /*
+     * Our advertised maximum channel data size, the largest packet
+     * we accept and the default channel window (see
+     * ssh2_init_packet_limits).
+     */
+    unsigned long v2_maxpkt, v2_packetlimit;
+    int v2_winsize;
     const struct ssh_cipher *cipher;
     void *v1_cipher_ctx;
     void *crcda_ctx;
@@ -833,6 +893,19 @@ struct ssh_tag {
 
     struct Packet **queue;
     int queuelen, queuesize;
+
+    struct ssh_packet_pool *pktpool;
+#ifdef MPEXT
+    /* Packets handed to crypto_worker, in sequence order */
+    Worker crypto_worker;
+    struct Packet *sealq_head, *sealq_tail;
+    int sealq_len;
+    struct Packet *openq_head, *openq_tail;
+    int openq_len;
+    /* Second context for decrypting lengths, when the cipher has
+     * SSH_CIPHER_SEPARATE_LENGTH: the worker owns sc_cipher_ctx. */
+    void *sc_length_ctx;
+#endif
     int queueing;
     unsigned char *deferred_send_data;
     int deferred_len, deferred_size;
@@ -1230,8 +1303,21 @@ static void c_write_str(Ssh ssh, const char *buf)
 
 static void ssh_free_packet(struct Packet *pkt)
 {
+    struct ssh_packet_pool *pool = pkt->pool;
+
+    if (pool) {
+	pool->live--;
+	if (!pool->closed && pool->count < SSH_PACKET_POOL_SIZE) {
+	    pkt->next_free = pool->head;
+	    pool->head = pkt;
+	    pool->count++;
+	    return;
+	}
+    }
     sfree(pkt->data);
     sfree(pkt);
+    if (pool && pool->closed && pool->live == 0)
+	sfree(pool);
 }
 static struct Packet *ssh_new_packet(void)
 {
@@ -1239,9 +1325,71 @@ static struct Packet *ssh_new_packet(void)
 
     pkt->body = pkt->data = NULL;
     pkt->maxlen = 0;
+    pkt->pool = NULL;
 
     return pkt;
 }
+/*
+ * Take a packet from the connection's pool. A recycled packet keeps
+ * its data buffer (and maxlen), everything else is to be set up by
+ * the caller, as with ssh_new_packet.
+ */
+static struct Packet *ssh_new_pooled_packet(Ssh ssh)
+{
+    struct ssh_packet_pool *pool = ssh->pktpool;
+    struct Packet *pkt;
+
+    if (pool->head) {
+	pkt = pool->head;
+	pool->head = pkt->next_free;
+	pool->count--;
+	pkt->body = NULL;
+    } else {
+	pkt = ssh_new_packet();
+	pkt->pool = pool;
+	pool->allocations++;
+    }
+    pool->live++;
+
+    return pkt;
+}
+static struct ssh_packet_pool *ssh_packet_pool_new(void)
+{
+    struct ssh_packet_pool *pool = snew(struct ssh_packet_pool);
+
+    pool->head = NULL;
+    pool->count = pool->live = pool->closed = 0;
+    pool->allocations = 0;
+
+    return pool;
+}
+static void ssh_packet_pool_close(struct ssh_packet_pool *pool)
+{
+    pool->closed = TRUE;
+    while (pool->head) {
+	struct Packet *pkt = pool->head;
+	pool->head = pkt->next_free;
+	sfree(pkt->data);
+	sfree(pkt);
+    }
+    pool->count = 0;
+    if (pool->live == 0)
+	sfree(pool);
+}
+/*
+ * Make sure an incoming packet has room for `length' bytes, keeping
+ * its contents. A recycled packet that is big enough already is left
+ * alone, so maxlen may exceed what the packet currently needs.
+ */
+static void ssh_pkt_reserve(struct Packet *pkt, long length)
+{
+    if (pkt->maxlen < length) {
+	pkt->maxlen = length;
+	pkt->data = sresize(pkt->data, pkt->maxlen + APIEXTRA, unsigned char);
+	if (pkt->pool)
+	    pkt->pool->allocations++;
+    }
+}
 
 static void ssh1_log_incoming_packet(Ssh ssh, struct Packet *pkt)
 {
@@ -1616,6 +1764,79 @@ static void ssh2_log_outgoing_packet(Ssh ssh, struct Packet *pkt)
     pkt->length += (long)(pkt->body - pkt->data);
 }
 
+/*
+ * The rest of reading an SSH-2 packet, once it is decrypted and its
+ * MAC checked: padding, decompression and logging. `len' is the
+ * packet length field. Returns NULL if the packet is not to be
+ * dispatched.
+ */
+static struct Packet *ssh2_rdpkt_finish(Ssh ssh, struct Packet *pktin,
+                                        long len)
+{
+    long pad;
+
+    /* Get and sanity-check the amount of random padding. */
+    pad = pktin->data[4];
+    if (pad < 4 || len - pad < 1) {
+	bombout(("Invalid padding length on received packet"));
+	ssh_free_packet(pktin);
+	return NULL;
+    }
+
+    /*
+     * This enables us to deduce the payload length.
+     */
+    pktin->length = len + 4 - pad;
+    assert(pktin->length >= 0);
+
+    /*
+     * Decompress packet payload.
+     */
+    {
+	unsigned char *newpayload;
+	int newlen;
+	if (ssh->sccomp &&
+	    ssh->sccomp->decompress(ssh->sc_comp_ctx,
+				    pktin->data + 5, pktin->length - 5,
+				    &newpayload, &newlen)) {
+	    if (pktin->maxlen < newlen + 5) {
+		pktin->maxlen = newlen + 5;
+		pktin->data = sresize(pktin->data,
+				      pktin->maxlen + APIEXTRA,
+				      unsigned char);
+	    }
+	    pktin->length = 5 + newlen;
+	    memcpy(pktin->data + 5, newpayload, newlen);
+	    sfree(newpayload);
+	}
+    }
+
+    /*
+     * RFC 4253 doesn't explicitly say that completely empty packets
+     * with no type byte are forbidden, so treat them as deserving
+     * an SSH_MSG_UNIMPLEMENTED.
+     */
+    if (pktin->length <= 5) { /* == 5 we hope, but robustness */
+        ssh2_msg_something_unimplemented(ssh, pktin);
+        return NULL;
+    }
+    /*
+     * pktin->body and pktin->length should identify the semantic
+     * content of the packet, excluding the initial type byte.
+     */
+    pktin->type = pktin->data[5];
+    pktin->body = pktin->data + 6;
+    pktin->length -= 6;
+    assert(pktin->length >= 0);    /* one last double-check */
+
+    if (ssh->logctx)
+        ssh2_log_incoming_packet(ssh, pktin);
+
+    pktin->savedpos = 0;
+
+    return pktin;
+}
+
 static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
                                  int *datalen)
 {
@@ -1623,7 +1844,7 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
 
     crBegin(ssh->ssh2_rdpkt_crstate);
 
-    st->pktin = ssh_new_packet();
+    st->pktin = ssh_new_pooled_packet(ssh);
 
     st->pktin->type = 0;
     st->pktin->length = 0;
@@ -1656,8 +1877,7 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
 	 */
 
 	/* May as well allocate the whole lot now. */
-	st->pktin->data = snewn(OUR_V2_PACKETLIMIT + st->maclen + APIEXTRA,
-				unsigned char);
+	ssh_pkt_reserve(st->pktin, ssh->v2_packetlimit + st->maclen);
 
 	/* Read an amount corresponding to the MAC. */
 	for (st->i = 0; st->i < st->maclen; st->i++) {
@@ -1697,18 +1917,14 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
 		((st->len = toint(GET_32BIT(st->pktin->data))) ==
                  st->packetlen-4))
 		    break;
-	    if (st->packetlen >= OUR_V2_PACKETLIMIT) {
+	    if (st->packetlen >= ssh->v2_packetlimit) {
 		bombout(("No valid incoming packet found"));
 		ssh_free_packet(st->pktin);
 		crStop(NULL);
 	    }
 	}
-	st->pktin->maxlen = st->packetlen + st->maclen;
-	st->pktin->data = sresize(st->pktin->data,
-				  st->pktin->maxlen + APIEXTRA,
-				  unsigned char);
     } else if (ssh->scmac && ssh->scmac_etm) {
-	st->pktin->data = snewn(4 + APIEXTRA, unsigned char);
+	ssh_pkt_reserve(st->pktin, 4);
 
         /*
          * OpenSSH encrypt-then-MAC mode: the packet length is
@@ -1725,7 +1941,13 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
             /* Keep the packet the same though, so the MAC passes */
             unsigned char len[4];
             memcpy(len, st->pktin->data, 4);
+#ifdef MPEXT
+            ssh->sccipher->decrypt_length(
+                ssh->sc_length_ctx ? ssh->sc_length_ctx : ssh->sc_cipher_ctx,
+                len, 4, st->incoming_sequence);
+#else
             ssh->sccipher->decrypt_length(ssh->sc_cipher_ctx, len, 4, st->incoming_sequence);
+#endif
             st->len = toint(GET_32BIT(len));
         } else {
             st->len = toint(GET_32BIT(st->pktin->data));
@@ -1735,7 +1957,7 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
 	 * _Completely_ silly lengths should be stomped on before they
 	 * do us any more damage.
 	 */
-	if (st->len < 0 || st->len > OUR_V2_PACKETLIMIT ||
+	if (st->len < 0 || st->len > ssh->v2_packetlimit ||
 	    st->len % st->cipherblk != 0) {
 	    bombout(("Incoming packet length field was garbled"));
 	    ssh_free_packet(st->pktin);
@@ -1750,10 +1972,7 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
 	/*
 	 * Allocate memory for the rest of the packet.
 	 */
-	st->pktin->maxlen = st->packetlen + st->maclen;
-	st->pktin->data = sresize(st->pktin->data,
-				  st->pktin->maxlen + APIEXTRA,
-				  unsigned char);
+	ssh_pkt_reserve(st->pktin, st->packetlen + st->maclen);
 
 	/*
 	 * Read the remainder of the packet.
@@ -1765,6 +1984,17 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
 	    (*datalen)--;
 	}
 
+#ifdef MPEXT
+	if (ssh2_open_pipelined(ssh)) {
+	    /* The crypto worker checks the MAC and decrypts the rest;
+	     * ssh_process_incoming_data picks the packet up from there. */
+	    st->pktin->encrypted_len = st->packetlen;
+	    st->pktin->sequence = st->incoming_sequence++;
+	    ssh2_open_submit(ssh, st->pktin);
+	    crStop(NULL);
+	}
+#endif
+
 	/*
 	 * Check the MAC.
 	 */
@@ -1782,7 +2012,7 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
 				   st->pktin->data + 4,
 				   st->packetlen - 4);
     } else {
-	st->pktin->data = snewn(st->cipherblk + APIEXTRA, unsigned char);
+	ssh_pkt_reserve(st->pktin, st->cipherblk);
 
 	/*
 	 * Acquire and decrypt the first block of the packet. This will
@@ -1808,7 +2038,7 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
 	 * _Completely_ silly lengths should be stomped on before they
 	 * do us any more damage.
 	 */
-	if (st->len < 0 || st->len > OUR_V2_PACKETLIMIT ||
+	if (st->len < 0 || st->len > ssh->v2_packetlimit ||
 	    (st->len + 4) % st->cipherblk != 0) {
 	    bombout(("Incoming packet was garbled on decryption"));
 	    ssh_free_packet(st->pktin);
@@ -1823,10 +2053,7 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
 	/*
 	 * Allocate memory for the rest of the packet.
 	 */
-	st->pktin->maxlen = st->packetlen + st->maclen;
-	st->pktin->data = sresize(st->pktin->data,
-				  st->pktin->maxlen + APIEXTRA,
-				  unsigned char);
+	ssh_pkt_reserve(st->pktin, st->packetlen + st->maclen);
 
 	/*
 	 * Read and decrypt the remainder of the packet.
@@ -1855,70 +2082,12 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, const unsigned char **data,
 	    crStop(NULL);
 	}
     }
-    /* Get and sanity-check the amount of random padding. */
-    st->pad = st->pktin->data[4];
-    if (st->pad < 4 || st->len - st->pad < 1) {
-	bombout(("Invalid padding length on received packet"));
-	ssh_free_packet(st->pktin);
-	crStop(NULL);
-    }
-    /*
-     * This enables us to deduce the payload length.
-     */
-    st->payload = st->len - st->pad - 1;
-
-    st->pktin->length = st->payload + 5;
     st->pktin->encrypted_len = st->packetlen;
-
     st->pktin->sequence = st->incoming_sequence++;
 
-    st->pktin->length = st->packetlen - st->pad;
-    assert(st->pktin->length >= 0);
-
-    /*
-     * Decompress packet payload.
-     */
-    {
-	unsigned char *newpayload;
-	int newlen;
-	if (ssh->sccomp &&
-	    ssh->sccomp->decompress(ssh->sc_comp_ctx,
-				    st->pktin->data + 5, st->pktin->length - 5,
-				    &newpayload, &newlen)) {
-	    if (st->pktin->maxlen < newlen + 5) {
-		st->pktin->maxlen = newlen + 5;
-		st->pktin->data = sresize(st->pktin->data,
-					  st->pktin->maxlen + APIEXTRA,
-					  unsigned char);
-	    }
-	    st->pktin->length = 5 + newlen;
-	    memcpy(st->pktin->data + 5, newpayload, newlen);
-	    sfree(newpayload);
-	}
-    }
-
-    /*
-     * RFC 4253 doesn't explicitly say that completely empty packets
-     * with no type byte are forbidden, so treat them as deserving
-     * an SSH_MSG_UNIMPLEMENTED.
-     */
-    if (st->pktin->length <= 5) { /* == 5 we hope, but robustness */
-        ssh2_msg_something_unimplemented(ssh, st->pktin);
-        crStop(NULL);
-    }
-    /*
-     * pktin->body and pktin->length should identify the semantic
-     * content of the packet, excluding the initial type byte.
-     */
-    st->pktin->type = st->pktin->data[5];
-    st->pktin->body = st->pktin->data + 6;
-    st->pktin->length -= 6;
-    assert(st->pktin->length >= 0);    /* one last double-check */
-
-    if (ssh->logctx)
-        ssh2_log_incoming_packet(ssh, st->pktin);
-
-    st->pktin->savedpos = 0;
+    st->pktin = ssh2_rdpkt_finish(ssh, st->pktin, st->len);
+    if (!st->pktin)
+	crStop(NULL);
 
     crFinish(st->pktin);
 }
@@ -1942,13 +2111,13 @@ static struct Packet *ssh2_bare_connection_rdpkt(Ssh ssh,
     }
 
     st->packetlen = toint(GET_32BIT_MSB_FIRST(st->length));
-    if (st->packetlen <= 0 || st->packetlen >= OUR_V2_PACKETLIMIT) {
+    if (st->packetlen <= 0 || st->packetlen >= ssh->v2_packetlimit) {
         bombout(("Invalid packet length received"));
         crStop(NULL);
     }
 
-    st->pktin = ssh_new_packet();
-    st->pktin->data = snewn(st->packetlen, unsigned char);
+    st->pktin = ssh_new_pooled_packet(ssh);
+    ssh_pkt_reserve(st->pktin, st->packetlen);
 
     st->pktin->encrypted_len = st->packetlen;
 
@@ -2189,6 +2358,8 @@ static void ssh_pkt_ensure(struct Packet *pkt, int length)
 	pkt->maxlen = length + 256;
 	pkt->data = sresize(pkt->data, pkt->maxlen + APIEXTRA, unsigned char);
 	if (body) pkt->body = pkt->data + offset;
+	if (pkt->pool)
+	    pkt->pool->allocations++;
     }
 }
 static void ssh_pkt_adddata(struct Packet *pkt, const void *data, int len)
@@ -2286,9 +2457,8 @@ static struct Packet *ssh1_pkt_init(int pkt_type)
 #define ssh2_pkt_addstring_data(pkt, data, len) ssh_pkt_addstring_data(pkt, data, len)
 #define ssh2_pkt_addstring(pkt, data) ssh_pkt_addstring(pkt, data)
 
-static struct Packet *ssh2_pkt_init(int pkt_type)
+static struct Packet *ssh2_pkt_setup(struct Packet *pkt, int pkt_type)
 {
-    struct Packet *pkt = ssh_new_packet();
     pkt->length = 5; /* space for packet length + padding length */
     pkt->forcepad = 0;
     pkt->type = pkt_type;
@@ -2299,12 +2469,26 @@ static struct Packet *ssh2_pkt_init(int pkt_type)
     return pkt;
 }
 
+static struct Packet *ssh2_pkt_init(int pkt_type)
+{
+    return ssh2_pkt_setup(ssh_new_packet(), pkt_type);
+}
+
 /*
- * Construct an SSH-2 final-form packet: compress it, encrypt it,
- * put the MAC on it. Final packet, ready to be sent, is stored in
- * pkt->data. Total length is returned.
+ * Same as ssh2_pkt_init, with the packet taken from the connection's
+ * pool. Used for bulk channel data.
  */
-static int ssh2_pkt_construct(Ssh ssh, struct Packet *pkt)
+static struct Packet *ssh2_pkt_init_pooled(Ssh ssh, int pkt_type)
+{
+    return ssh2_pkt_setup(ssh_new_pooled_packet(ssh), pkt_type);
+}
+
+/*
+ * First half of ssh2_pkt_construct: compress and pad the packet and
+ * allocate its sequence number. Returns the total length the final
+ * packet will have.
+ */
+static int ssh2_pkt_prepare(Ssh ssh, struct Packet *pkt)
 {
     int cipherblk, maclen, padding, unencrypted_prefix, i;
 
@@ -2361,10 +2545,25 @@ static int ssh2_pkt_construct(Ssh ssh, struct Packet *pkt)
 	pkt->data[pkt->length + i] = random_byte();
     PUT_32BIT(pkt->data, pkt->length + padding - 4);
 
+    pkt->sequence = ssh->v2_outgoing_sequence++; /* whether or not we MAC */
+    pkt->encrypted_len = pkt->length + padding;
+
+    /* Ready-to-send packet starts at pkt->data. We return length. */
+    pkt->body = pkt->data;
+    return pkt->length + padding + maclen;
+}
+
+/*
+ * Second half of ssh2_pkt_construct: encrypt the prepared packet and
+ * put the MAC on it. Uses nothing but the client-to-server cipher and
+ * MAC, so it may run on the crypto worker.
+ */
+static void ssh2_pkt_seal(Ssh ssh, struct Packet *pkt)
+{
     /* Encrypt length if the scheme requires it */
     if (ssh->cscipher && (ssh->cscipher->flags & SSH_CIPHER_SEPARATE_LENGTH)) {
         ssh->cscipher->encrypt_length(ssh->cs_cipher_ctx, pkt->data, 4,
-                                      ssh->v2_outgoing_sequence);
+                                      pkt->sequence);
     }
 
     if (ssh->csmac && ssh->csmac_etm) {
@@ -2373,30 +2572,185 @@ static int ssh2_pkt_construct(Ssh ssh, struct Packet *pkt)
          */
         if (ssh->cscipher)
             ssh->cscipher->encrypt(ssh->cs_cipher_ctx,
-                                   pkt->data + 4, pkt->length + padding - 4);
+                                   pkt->data + 4, pkt->encrypted_len - 4);
         ssh->csmac->generate(ssh->cs_mac_ctx, pkt->data,
-                             pkt->length + padding,
-                             ssh->v2_outgoing_sequence);
+                             pkt->encrypted_len, pkt->sequence);
     } else {
         /*
          * SSH-2 standard protocol.
          */
         if (ssh->csmac)
             ssh->csmac->generate(ssh->cs_mac_ctx, pkt->data,
-                                 pkt->length + padding,
-                                 ssh->v2_outgoing_sequence);
+                                 pkt->encrypted_len, pkt->sequence);
         if (ssh->cscipher)
             ssh->cscipher->encrypt(ssh->cs_cipher_ctx,
-                                   pkt->data, pkt->length + padding);
+                                   pkt->data, pkt->encrypted_len);
     }
+}
 
-    ssh->v2_outgoing_sequence++;       /* whether or not we MACed */
-    pkt->encrypted_len = pkt->length + padding;
+/*
+ * Construct an SSH-2 final-form packet: compress it, encrypt it,
+ * put the MAC on it. Final packet, ready to be sent, is stored in
+ * pkt->data. Total length is returned.
+ */
+static int ssh2_pkt_construct(Ssh ssh, struct Packet *pkt)
+{
+    int len;
 
-    /* Ready-to-send packet starts at pkt->data. We return length. */
-    pkt->body = pkt->data;
-    return pkt->length + padding + maclen;
+#ifdef MPEXT
+    /* Packets on the crypto worker use the same contexts, and go first */
+    ssh2_seal_flush(ssh, 0);
+#endif
+    len = ssh2_pkt_prepare(ssh, pkt);
+    if (!ssh->bare_connection)
+	ssh2_pkt_seal(ssh, pkt);
+    return len;
+}
+
+#ifdef MPEXT
+/*
+ * Pipelined crypto (CONF_ssh_crypto_thread). ssh2_pkt_send_noqueue
+ * prepares each packet here and queues it on a worker thread, which
+ * encrypts and MACs the packets one at a time in sequence order; the
+ * main thread writes them out in the same order as they complete, and
+ * meanwhile gets on with the transfer.
+ *
+ * Anything that encrypts on the main thread, replaces the keys or
+ * writes to the socket drains the queue first.
+ *
+ * Incoming packets go the same way where their length can be known
+ * without the MAC context: in ETM mode the length is sent in clear,
+ * and ChaCha20-Poly1305 decrypts it with a key of its own (for which
+ * the main thread keeps sc_length_ctx). ssh2_rdpkt then frames the
+ * packet and leaves the MAC check and decryption to the worker, and
+ * ssh_process_incoming_data finishes and dispatches the packets in
+ * order while later ones are being opened. Other modes (CBC with a
+ * plain MAC, or an encrypted length) are read synchronously.
+ */
+#define SSH_CRYPTO_MAX_QUEUE 32
+
+static void ssh2_seal_job(void *ctx)
+{
+    struct Packet *pkt = (struct Packet *)ctx;
+    ssh2_pkt_seal(pkt->crypto_ssh, pkt);
+}
+
+/*
+ * Write out the sealed packets from the head of the queue, waiting
+ * for more to complete until no more than `maxqueued' are left.
+ */
+static void ssh2_seal_flush(Ssh ssh, int maxqueued)
+{
+    struct Packet *pkt;
+    int backlog = 0;
+
+    while ((pkt = ssh->sealq_head) != NULL) {
+	if (!worker_done(ssh->crypto_worker, pkt->crypto_job)) {
+	    if (ssh->sealq_len <= maxqueued)
+		break;
+	    worker_wait(ssh->crypto_worker, pkt->crypto_job);
+	}
+	ssh->sealq_head = pkt->crypto_next;
+	if (!ssh->sealq_head)
+	    ssh->sealq_tail = NULL;
+	ssh->sealq_len--;
+
+	backlog = s_write(ssh, pkt->body, pkt->crypto_len);
+	ssh->outgoing_data_size += pkt->encrypted_len;
+	ssh_free_packet(pkt);
+    }
+
+    if (backlog > SSH_MAX_BACKLOG)
+	ssh_throttle_all(ssh, 1, backlog);
+}
+
+static void ssh2_pkt_send_pipelined(Ssh ssh, struct Packet *pkt)
+{
+    pkt->crypto_len = ssh2_pkt_prepare(ssh, pkt);
+    pkt->crypto_ssh = ssh;
+    pkt->crypto_next = NULL;
+    if (ssh->sealq_tail)
+	ssh->sealq_tail->crypto_next = pkt;
+    else
+	ssh->sealq_head = pkt;
+    ssh->sealq_tail = pkt;
+    ssh->sealq_len++;
+    pkt->crypto_job = worker_submit(ssh->crypto_worker, ssh2_seal_job, pkt);
+
+    ssh2_seal_flush(ssh, SSH_CRYPTO_MAX_QUEUE);
+
+    if (!ssh->kex_in_progress &&
+	ssh->max_data_size != 0 &&
+	ssh->outgoing_data_size > ssh->max_data_size)
+	do_ssh2_transport(ssh, "too much data sent", -1, NULL);
+}
+
+/*
+ * Whether ssh2_rdpkt may hand the packet it is reading to the worker.
+ * Not during key exchange: the packet after the server's NEWKEYS uses
+ * keys that are only set up once NEWKEYS is dispatched, so nothing
+ * may be read ahead of it. The server cannot send NEWKEYS before we
+ * answer its KEXINIT, so packets read ahead of a KEXINIT are safe.
+ */
+static int ssh2_open_pipelined(Ssh ssh)
+{
+    return ssh->crypto_worker && !ssh->kex_in_progress &&
+	ssh->scmac && ssh->scmac_etm &&
+	(!ssh->sccipher ||
+	 !(ssh->sccipher->flags & SSH_CIPHER_SEPARATE_LENGTH) ||
+	 ssh->sc_length_ctx);
+}
+
+static void ssh2_open_job(void *ctx)
+{
+    struct Packet *pkt = (struct Packet *)ctx;
+    Ssh ssh = pkt->crypto_ssh;
+
+    pkt->crypto_ok =
+	ssh->scmac->verify(ssh->sc_mac_ctx, pkt->data, pkt->crypto_len,
+			   pkt->sequence);
+    /* Decrypt everything between the length field and the MAC. */
+    if (pkt->crypto_ok && ssh->sccipher)
+	ssh->sccipher->decrypt(ssh->sc_cipher_ctx, pkt->data + 4,
+			       pkt->crypto_len - 4);
+}
+
+static void ssh2_open_submit(Ssh ssh, struct Packet *pkt)
+{
+    pkt->crypto_len = pkt->encrypted_len;
+    pkt->crypto_ssh = ssh;
+    pkt->crypto_next = NULL;
+    if (ssh->openq_tail)
+	ssh->openq_tail->crypto_next = pkt;
+    else
+	ssh->openq_head = pkt;
+    ssh->openq_tail = pkt;
+    ssh->openq_len++;
+    pkt->crypto_job = worker_submit(ssh->crypto_worker, ssh2_open_job, pkt);
+}
+
+/*
+ * Take the packet at the head of the incoming queue, once the worker
+ * is done with it, and finish it as ssh2_rdpkt would.
+ */
+static struct Packet *ssh2_open_finish(Ssh ssh)
+{
+    struct Packet *pkt = ssh->openq_head;
+
+    worker_wait(ssh->crypto_worker, pkt->crypto_job);
+    ssh->openq_head = pkt->crypto_next;
+    if (!ssh->openq_head)
+	ssh->openq_tail = NULL;
+    ssh->openq_len--;
+
+    if (!pkt->crypto_ok) {
+	bombout(("Incorrect MAC received on packet"));
+	ssh_free_packet(pkt);
+	return NULL;
+    }
+    return ssh2_rdpkt_finish(ssh, pkt, pkt->crypto_len - 4);
 }
+#endif
 
 /*
  * Routines called from the main SSH code to send packets. There
@@ -2451,6 +2805,12 @@ static void ssh2_pkt_send_noqueue(Ssh ssh, struct Packet *pkt)
 	ssh_pkt_defersend(ssh);
 	return;
     }
+#ifdef MPEXT
+    if (ssh->crypto_worker && !ssh->bare_connection) {
+	ssh2_pkt_send_pipelined(ssh, pkt);
+	return;
+    }
+#endif
     len = ssh2_pkt_construct(ssh, pkt);
     backlog = s_write(ssh, pkt->body, len);
     if (backlog > SSH_MAX_BACKLOG)
@@ -3361,6 +3721,19 @@ static void ssh_process_incoming_data(Ssh ssh,
 {
     struct Packet *pktin;
 
+#ifdef MPEXT
+    /*
+     * Packets opened on the crypto worker come before anything still
+     * unread. More are read ahead only while there is data and room
+     * in the queue, and the packet at its head is not ready yet.
+     */
+    if (ssh->openq_head &&
+	(*datalen == 0 || ssh->openq_len >= SSH_CRYPTO_MAX_QUEUE ||
+	 !ssh2_open_pipelined(ssh) ||
+	 worker_done(ssh->crypto_worker, ssh->openq_head->crypto_job)))
+	pktin = ssh2_open_finish(ssh);
+    else
+#endif
     pktin = ssh->s_rdpkt(ssh, data, datalen);
     if (pktin) {
 	ssh->protocol(ssh, NULL, 0, pktin);
@@ -3368,6 +3741,19 @@ static void ssh_process_incoming_data(Ssh ssh,
     }
 }
 
+#ifdef MPEXT
+/* Dispatch the packets that were read ahead, unless frozen again. */
+static void ssh_process_opened_incoming_data(Ssh ssh)
+{
+    const unsigned char *data = NULL;
+    int datalen = 0;
+
+    while (!ssh->frozen && ssh->openq_head &&
+	   ssh->state != SSH_STATE_CLOSED)
+	ssh_process_incoming_data(ssh, &data, &datalen);
+}
+#endif
+
 static void ssh_queue_incoming_data(Ssh ssh,
 				    const unsigned char **data, int *datalen)
 {
@@ -3382,6 +3768,10 @@ static void ssh_process_queued_incoming_data(Ssh ssh)
     const unsigned char *data;
     int len, origlen;
 
+#ifdef MPEXT
+    /* packets read ahead before the freeze go first */
+    ssh_process_opened_incoming_data(ssh);
+#endif
     while (!ssh->frozen && bufchain_size(&ssh->queued_incoming_data)) {
 	bufchain_prefix(&ssh->queued_incoming_data, &vdata, &len);
 	data = vdata;
@@ -3393,6 +3783,9 @@ static void ssh_process_queued_incoming_data(Ssh ssh)
 	if (origlen > len)
 	    bufchain_consume(&ssh->queued_incoming_data, origlen - len);
     }
+#ifdef MPEXT
+    ssh_process_opened_incoming_data(ssh);
+#endif
 }
 
 static void ssh_set_frozen(Ssh ssh, int frozen)
@@ -3436,7 +3829,11 @@ static void ssh_gotdata(Ssh ssh, const unsigned char *data, int datalen)
      */
 
     while (1) {
-	while (bufchain_size(&ssh->queued_incoming_data) > 0 || datalen > 0) {
+	while (bufchain_size(&ssh->queued_incoming_data) > 0 || datalen > 0
+#ifdef MPEXT
+	       || ssh->openq_head
+#endif
+	       ) {
 	    if (ssh->frozen) {
 		ssh_queue_incoming_data(ssh, &data, &datalen);
 		/* This uses up all data and cannot cause anything interesting
@@ -3470,6 +3867,10 @@ static int ssh_do_close(Ssh ssh, int notify_exit)
     ssh->state = SSH_STATE_CLOSED;
     expire_timer_context(ssh);
     if (ssh->s) {
+#ifdef MPEXT
+	/* e.g. a DISCONNECT still on the crypto worker */
+	ssh2_seal_flush(ssh, 0);
+#endif
         sk_close(ssh->s);
         ssh->s = NULL;
         if (notify_exit)
@@ -6527,7 +6928,14 @@ static void do_ssh2_transport(Ssh ssh, const void *vin, int inlen,
 	 * Set up preferred compression.
 	 */
 	if (conf_get_int(ssh->conf, CONF_compression))
+#ifdef MPEXT
+	    /* a compression level selects the bundled zlib */
+	    s->preferred_comp =
+		conf_get_int(ssh->conf, CONF_compression_level) > 0 ?
+		&ssh_zlibx : &ssh_zlib;
+#else
 	    s->preferred_comp = &ssh_zlib;
+#endif
 	else
 	    s->preferred_comp = &ssh_comp_none;
 
@@ -6677,6 +7085,12 @@ static void do_ssh2_transport(Ssh ssh, const void *vin, int inlen,
 	    }
 	    for (i = 0; i < lenof(compressions); i++) {
 		const struct ssh_compress *c = compressions[i];
+#ifdef MPEXT
+		/* another implementation of the preferred method */
+		if (c != s->preferred_comp &&
+		    !strcmp(c->name, s->preferred_comp->name))
+		    continue;
+#endif
 		alg = ssh2_kexinit_addalg(s->kexlists[j], c->name);
 		alg->u.comp = c;
 		if (s->userauth_succeeded && c->delayed_name) {
@@ -7507,6 +7921,11 @@ static void do_ssh2_transport(Ssh ssh, const void *vin, int inlen,
      * We've sent client NEWKEYS, so create and initialise
      * client-to-server session keys.
      */
+#ifdef MPEXT
+    /* NEWKEYS and everything before it must be sealed with the old keys */
+    if (ssh->crypto_worker)
+	ssh2_seal_flush(ssh, 0);
+#endif
     if (ssh->cs_cipher_ctx)
 	ssh->cscipher->free_context(ssh->cs_cipher_ctx);
     ssh->cscipher = s->cscipher_tobe;
@@ -7522,6 +7941,12 @@ static void do_ssh2_transport(Ssh ssh, const void *vin, int inlen,
     if (ssh->cs_comp_ctx)
 	ssh->cscomp->compress_cleanup(ssh->cs_comp_ctx);
     ssh->cscomp = s->cscomp_tobe;
+#ifdef MPEXT
+    if (ssh->cscomp->compress_init_level)
+	ssh->cs_comp_ctx = ssh->cscomp->compress_init_level(
+	    conf_get_int(ssh->conf, CONF_compression_level));
+    else
+#endif
     ssh->cs_comp_ctx = ssh->cscomp->compress_init();
 
     /*
@@ -7586,11 +8011,24 @@ static void do_ssh2_transport(Ssh ssh, const void *vin, int inlen,
      * We've seen server NEWKEYS, so create and initialise
      * server-to-client session keys.
      */
+#ifdef MPEXT
+    /* nothing is read ahead during key exchange, see ssh2_open_pipelined */
+    assert(!ssh->openq_head);
+    if (ssh->sc_length_ctx) {
+	ssh->sccipher->free_context(ssh->sc_length_ctx);
+	ssh->sc_length_ctx = NULL;
+    }
+#endif
     if (ssh->sc_cipher_ctx)
 	ssh->sccipher->free_context(ssh->sc_cipher_ctx);
     if (s->sccipher_tobe) {
 	ssh->sccipher = s->sccipher_tobe;
 	ssh->sc_cipher_ctx = ssh->sccipher->make_context();
+#ifdef MPEXT
+	if (ssh->crypto_worker &&
+	    (ssh->sccipher->flags & SSH_CIPHER_SEPARATE_LENGTH))
+	    ssh->sc_length_ctx = ssh->sccipher->make_context();
+#endif
     }
 
     if (ssh->sc_mac_ctx)
@@ -7616,12 +8054,20 @@ static void do_ssh2_transport(Ssh ssh, const void *vin, int inlen,
 	key = ssh2_mkkey(ssh, s->K, s->exchange_hash, 'D',
                          ssh->sccipher->padded_keybytes);
 	ssh->sccipher->setkey(ssh->sc_cipher_ctx, key);
+#ifdef MPEXT
+	if (ssh->sc_length_ctx)
+	    ssh->sccipher->setkey(ssh->sc_length_ctx, key);
+#endif
         smemclr(key, ssh->sccipher->padded_keybytes);
         sfree(key);
 
 	key = ssh2_mkkey(ssh, s->K, s->exchange_hash, 'B',
                          ssh->sccipher->blksize);
 	ssh->sccipher->setiv(ssh->sc_cipher_ctx, key);
+#ifdef MPEXT
+	if (ssh->sc_length_ctx)
+	    ssh->sccipher->setiv(ssh->sc_length_ctx, key);
+#endif
         smemclr(key, ssh->sccipher->blksize);
         sfree(key);
     }
@@ -7808,7 +8254,7 @@ static int ssh2_try_send(struct ssh_channel *c)
 	    len = c->v.v2.remwindow;
 	if ((unsigned)len > c->v.v2.remmaxpkt)
 	    len = c->v.v2.remmaxpkt;
-	pktout = ssh2_pkt_init(SSH2_MSG_CHANNEL_DATA);
+	pktout = ssh2_pkt_init_pooled(ssh, SSH2_MSG_CHANNEL_DATA);
 	ssh2_pkt_adduint32(pktout, c->remoteid);
 	ssh2_pkt_addstring_start(pktout);
 	ssh2_pkt_addstring_data(pktout, data, len);
@@ -7885,7 +8331,8 @@ static void ssh_channel_init(struct ssh_channel *c)
     c->throttling_conn = FALSE;
     if (ssh->version == 2) {
 	c->v.v2.locwindow = c->v.v2.locmaxwin = c->v.v2.remlocwin =
-	    ssh_is_simple(ssh) ? OUR_V2_BIGWIN : OUR_V2_WINSIZE;
+	    ssh_is_simple(ssh) ? OUR_V2_BIGWIN : ssh->v2_winsize;
+	c->v.v2.rcvd = 0;
 	c->v.v2.chanreq_head = NULL;
 	c->v.v2.throttle_state = UNTHROTTLED;
 	bufchain_init(&c->v.v2.outbuffer);
@@ -7905,7 +8352,7 @@ static struct Packet *ssh2_chanopen_init(struct ssh_channel *c,
     ssh2_pkt_addstring(pktout, type);
     ssh2_pkt_adduint32(pktout, c->localid);
     ssh2_pkt_adduint32(pktout, c->v.v2.locwindow);/* our window size */
-    ssh2_pkt_adduint32(pktout, OUR_V2_MAXPKT);      /* our max pkt size */
+    ssh2_pkt_adduint32(pktout, c->ssh->v2_maxpkt);  /* our max pkt size */
     return pktout;
 }
 
@@ -7984,6 +8431,11 @@ static void ssh_channel_unthrottle(struct ssh_channel *c, int bufsize)
 /*
  * Potentially enlarge the window on an SSH-2 channel.
  */
+struct winadj_ctx {
+    unsigned size;
+    /* channel data received when the winadj was sent */
+    unsigned long rcvd;
+};
 static void ssh2_handle_winadj_response(struct ssh_channel *, struct Packet *,
 					void *);
 static void ssh2_set_window(struct ssh_channel *c, int newwin)
@@ -8012,8 +8464,8 @@ static void ssh2_set_window(struct ssh_channel *c, int newwin)
      * window so that it has no choice (assuming it doesn't ignore the
      * window as well).
      */
-    if ((ssh->remote_bugs & BUG_SSH2_MAXPKT) && newwin > OUR_V2_MAXPKT)
-	newwin = OUR_V2_MAXPKT;
+    if ((ssh->remote_bugs & BUG_SSH2_MAXPKT) && newwin > (int)ssh->v2_maxpkt)
+	newwin = ssh->v2_maxpkt;
 
     /*
      * Only send a WINDOW_ADJUST if there's significantly more window
@@ -8024,7 +8476,7 @@ static void ssh2_set_window(struct ssh_channel *c, int newwin)
      */
     if (newwin / 2 >= c->v.v2.locwindow) {
 	struct Packet *pktout;
-	unsigned *up;
+	struct winadj_ctx *wc;
 
 	/*
 	 * In order to keep track of how much window the client
@@ -8038,10 +8490,11 @@ static void ssh2_set_window(struct ssh_channel *c, int newwin)
 	 */
 	if (newwin == c->v.v2.locmaxwin &&
             !(ssh->remote_bugs & BUG_CHOKES_ON_WINADJ)) {
-	    up = snew(unsigned);
-	    *up = newwin - c->v.v2.locwindow;
+	    wc = snew(struct winadj_ctx);
+	    wc->size = newwin - c->v.v2.locwindow;
+	    wc->rcvd = c->v.v2.rcvd;
 	    pktout = ssh2_chanreq_init(c, "winadj@putty.projects.tartarus.org",
-				       ssh2_handle_winadj_response, up);
+				       ssh2_handle_winadj_response, wc);
 	    ssh2_pkt_send(ssh, pktout);
 
 	    if (c->v.v2.throttle_state != UNTHROTTLED)
@@ -8100,7 +8553,7 @@ static struct ssh_channel *ssh_channel_msg(Ssh ssh, struct Packet *pktin)
 static void ssh2_handle_winadj_response(struct ssh_channel *c,
 					struct Packet *pktin, void *ctx)
 {
-    unsigned *sizep = ctx;
+    struct winadj_ctx *wc = ctx;
 
     /*
      * Winadj responses should always be failures. However, at least
@@ -8110,8 +8563,19 @@ static void ssh2_handle_winadj_response(struct ssh_channel *c,
      * life, we don't worry about what kind of response we got.
      */
 
-    c->v.v2.remlocwin += *sizep;
-    sfree(sizep);
+    c->v.v2.remlocwin += wc->size;
+    /*
+     * Data that arrived while the winadj was in flight is what the
+     * server could send in one round trip, i.e. the bandwidth-delay
+     * product capped by our window. In high-throughput mode, if it
+     * (nearly) filled the window, it is the window that limits us,
+     * so double it.
+     */
+    if (c->ssh->v2_maxpkt > OUR_V2_MAXPKT && pktin &&
+        c->v.v2.rcvd - wc->rcvd >= (unsigned long)c->v.v2.locmaxwin / 4 * 3 &&
+        c->v.v2.locmaxwin < 0x40000000)
+	c->v.v2.locmaxwin *= 2;
+    sfree(wc);
     /*
      * winadj messages are only sent when the window is fully open, so
      * if we get an ack of one, we know any pending unthrottle is
@@ -8173,6 +8637,7 @@ static void ssh2_msg_channel_data(Ssh ssh, struct Packet *pktin)
 	int bufsize;
 	c->v.v2.locwindow -= length;
 	c->v.v2.remlocwin -= length;
+	c->v.v2.rcvd += length;
 	if (ext_type != 0 && ext_type != SSH2_EXTENDED_DATA_STDERR)
 	    length = 0; /* Don't do anything with unknown extended data. */
 	bufsize = ssh_channel_data(c, ext_type == SSH2_EXTENDED_DATA_STDERR,
@@ -8184,7 +8649,7 @@ static void ssh2_msg_channel_data(Ssh ssh, struct Packet *pktin)
 	 */
 	if (c->v.v2.remlocwin <= 0 && c->v.v2.throttle_state == UNTHROTTLED &&
 	    c->v.v2.locmaxwin < 0x40000000)
-	    c->v.v2.locmaxwin += OUR_V2_WINSIZE;
+	    c->v.v2.locmaxwin += ssh->v2_winsize;
 	/*
 	 * If we are not buffering too much data,
 	 * enlarge the window again at the remote side.
@@ -8970,7 +9435,7 @@ static void ssh2_msg_channel_open(Ssh ssh, struct Packet *pktin)
 	ssh2_pkt_adduint32(pktout, c->remoteid);
 	ssh2_pkt_adduint32(pktout, c->localid);
 	ssh2_pkt_adduint32(pktout, c->v.v2.locwindow);
-	ssh2_pkt_adduint32(pktout, OUR_V2_MAXPKT);	/* our max pkt size */
+	ssh2_pkt_adduint32(pktout, ssh->v2_maxpkt);	/* our max pkt size */
 	ssh2_pkt_send(ssh, pktout);
     }
 }
@@ -9009,7 +9474,7 @@ void sshfwd_x11_is_local(struct ssh_channel *c)
      * exchange mode.
      */
     c->u.x11.initial = FALSE;
-    ssh2_set_window(c, ssh_is_simple(c->ssh) ? OUR_V2_BIGWIN : OUR_V2_WINSIZE);
+    ssh2_set_window(c, ssh_is_simple(c->ssh) ? OUR_V2_BIGWIN : c->ssh->v2_winsize);
 }
 
 /*
@@ -11290,6 +11755,26 @@ static void ssh_cache_conf_values(Ssh ssh)
     ssh->logomitdata = conf_get_int(ssh->conf, CONF_logomitdata);
 }
 
+/*
+ * Work out our SSH-2 channel data message size, packet limit and
+ * default window from CONF_ssh2_maxpkt. Zero (or anything below it)
+ * means the stock OUR_V2_MAXPKT. The size is rounded down to whole
+ * kilobytes, so the packet limit stays a multiple of any cipher
+ * block size.
+ */
+static void ssh2_init_packet_limits(Ssh ssh)
+{
+    int maxpkt = conf_get_int(ssh->conf, CONF_ssh2_maxpkt) & ~0x3FF;
+
+    if (maxpkt < (int)OUR_V2_MAXPKT)
+	maxpkt = OUR_V2_MAXPKT;
+    else if (maxpkt > (int)OUR_V2_MAXPKT_LIMIT)
+	maxpkt = OUR_V2_MAXPKT_LIMIT;
+    ssh->v2_maxpkt = maxpkt;
+    ssh->v2_packetlimit = maxpkt + (OUR_V2_PACKETLIMIT - OUR_V2_MAXPKT);
+    ssh->v2_winsize = OUR_V2_WINSIZE / OUR_V2_MAXPKT * maxpkt;
+}
+
 /*
  * Called to set up the connection.
  *
@@ -11306,6 +11791,7 @@ static const char *ssh_init(void *frontend_handle, void **backend_handle,
     ssh = snew(struct ssh_tag);
     ssh->conf = conf_copy(conf);
     ssh_cache_conf_values(ssh);
+    ssh2_init_packet_limits(ssh);
     ssh->version = 0;		       /* when not ready yet */
     ssh->s = NULL;
     ssh->cipher = NULL;
@@ -11363,6 +11849,16 @@ static const char *ssh_init(void *frontend_handle, void **backend_handle,
     ssh->v1_stdout_throttling = 0;
     ssh->queue = NULL;
     ssh->queuelen = ssh->queuesize = 0;
+    ssh->pktpool = ssh_packet_pool_new();
+#ifdef MPEXT
+    ssh->crypto_worker = conf_get_int(ssh->conf, CONF_ssh_crypto_thread) ?
+	worker_new() : NULL;
+    ssh->sealq_head = ssh->sealq_tail = NULL;
+    ssh->sealq_len = 0;
+    ssh->openq_head = ssh->openq_tail = NULL;
+    ssh->openq_len = 0;
+    ssh->sc_length_ctx = NULL;
+#endif
     ssh->queueing = FALSE;
     ssh->qhead = ssh->qtail = NULL;
     ssh->deferred_rekey_reason = NULL;
@@ -11445,6 +11941,24 @@ static void ssh_free(void *handle)
     struct ssh_rportfwd *pf;
     struct X11FakeAuth *auth;
 
+#ifdef MPEXT
+    if (ssh->crypto_worker) {
+	/* let the worker finish with the cipher contexts, then discard */
+	worker_free(ssh->crypto_worker);
+	while (ssh->sealq_head) {
+	    struct Packet *pkt = ssh->sealq_head;
+	    ssh->sealq_head = pkt->crypto_next;
+	    ssh_free_packet(pkt);
+	}
+	while (ssh->openq_head) {
+	    struct Packet *pkt = ssh->openq_head;
+	    ssh->openq_head = pkt->crypto_next;
+	    ssh_free_packet(pkt);
+	}
+    }
+    if (ssh->sc_length_ctx)
+	ssh->sccipher->free_context(ssh->sc_length_ctx);
+#endif
     if (ssh->v1_cipher_ctx)
 	ssh->cipher->free_context(ssh->v1_cipher_ctx);
     if (ssh->cs_cipher_ctx)
@@ -11474,6 +11988,7 @@ static void ssh_free(void *handle)
     while (ssh->queuelen-- > 0)
 	ssh_free_packet(ssh->queue[ssh->queuelen]);
     sfree(ssh->queue);
+    ssh_packet_pool_close(ssh->pktpool);
 
     while (ssh->qhead) {
 	struct queued_handler *qh = ssh->qhead;
@@ -12194,6 +12709,21 @@ int get_ssh_exitcode(void * handle)
   return ssh_return_exitcode(handle);
 }
 
+unsigned long get_ssh_packet_allocations(void * handle)
+{
+  return ((Ssh)handle)->pktpool->allocations;
+}
+
+void ssh_crypto_flush(void * handle, int wait)
+{
+  Ssh ssh = (Ssh)handle;
+  // write out what the crypto worker has sealed, or all of it
+  if (ssh->crypto_worker)
+  {
+    ssh2_seal_flush(ssh, wait ? 0 : INT_MAX);
+  }
+}
+
 const unsigned int * ssh2_remmaxpkt(void * handle)
 {
   return &((Ssh)handle)->mainchan->v.v2.remmaxpkt;
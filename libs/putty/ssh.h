@@ -458,6 +458,11 @@ struct ssh_compress {
 		       unsigned char **outblock, int *outlen);
     int (*disable_compression) (void *);
     const char *text_name;
+#ifdef MPEXT
+    /* If non-NULL, used instead of compress_init to honour
+     * CONF_compression_level. */
+    void *(*compress_init_level) (int level);
+#endif
 };
 
 struct ssh2_userkey {
@@ -28,16 +28,45 @@
  * the sequence number which is passed in addition when calling
  * encrypt/decrypt on it.
  */
-
 #include "ssh.h"
-#include "sshbn.h"
 
 #ifndef INLINE
 #define INLINE
 #endif
 
+/*
+ * Check whether the compiler can build the SSE2/AVX2 versions of the
+ * ChaCha20 block function. Which one (if any) is used is decided at
+ * run time from CPUID, as sshaes.c does for AES-NI.
+ */
+#if defined(_FORCE_SOFTWARE_CHACHA)
+    /* no vector code */
+#elif defined(__clang__)
+#   if (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8)) && (defined(__x86_64__) || defined(__i386))
+#       define COMPILER_SUPPORTS_CHACHA_SIMD
+#   endif
+#elif defined(__GNUC__)
+#   if (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && (defined(__x86_64__) || defined(__i386))
+#       define COMPILER_SUPPORTS_CHACHA_SIMD
+#   endif
+#elif defined(_MSC_VER)
+#   if (defined(_M_X64) || defined(_M_IX86)) && _MSC_VER >= 1700
+#       define COMPILER_SUPPORTS_CHACHA_SIMD
+#   endif
+#endif
+
 /* ChaCha20 implementation, only supporting 256-bit keys */
 
+struct chacha20;
+
+/*
+ * XOR the key stream of `nblocks' whole 64-byte blocks into `blk'
+ * and advance the block counter. `nblocks' is a multiple of the
+ * function's batch size, and the low counter word must not wrap.
+ */
+typedef void (*chacha20_blocks_fn)(struct chacha20 *ctx,
+                                   unsigned char *blk, int nblocks);
+
 /* State for each ChaCha20 instance */
 struct chacha20 {
     /* Current context, usually with the count incremented
@@ -50,6 +79,10 @@ struct chacha20 {
     unsigned char current[64];
     /* The index of the above currently used to allow a true streaming cipher */
     int currentIndex;
+    /* Vectorised multi-block function for this CPU (NULL if none),
+     * and the number of blocks it processes at once */
+    chacha20_blocks_fn blocks;
+    int blocksBatch;
 };
 
 static INLINE void chacha20_round(struct chacha20 *ctx)
@@ -119,6 +152,8 @@ static INLINE void chacha20_round(struct chacha20 *ctx)
     }
 }
 
+static void chacha20_select_blocks(struct chacha20 *ctx);
+
 /* Initialise context with 256bit key */
 static void chacha20_key(struct chacha20 *ctx, const unsigned char *key)
 {
@@ -142,6 +177,8 @@ static void chacha20_key(struct chacha20 *ctx, const unsigned char *key)
 
     /* New key, dump context */
     ctx->currentIndex = 64;
+
+    chacha20_select_blocks(ctx);
 }
 
 static void chacha20_iv(struct chacha20 *ctx, const unsigned char *iv)
@@ -158,6 +195,22 @@ static void chacha20_iv(struct chacha20 *ctx, const unsigned char *iv)
 static void chacha20_encrypt(struct chacha20 *ctx, unsigned char *blk, int len)
 {
     while (len) {
+        /*
+         * On a block boundary, hand whole batches of blocks to the
+         * vectorised function. It does not carry into the high counter
+         * word, so leave a wrap of the low word to the code below.
+         */
+        if (ctx->currentIndex >= 64 && ctx->blocks &&
+            len >= ctx->blocksBatch * 64) {
+            int nblocks = len / 64 / ctx->blocksBatch * ctx->blocksBatch;
+            if (ctx->state[12] <= 0xFFFFFFFFU - (uint32)nblocks) {
+                ctx->blocks(ctx, blk, nblocks);
+                blk += nblocks * 64;
+                len -= nblocks * 64;
+                continue;
+            }
+        }
+
         /* If we don't have any state left, then cycle to the next */
         if (ctx->currentIndex >= 64) {
             chacha20_round(ctx);
@@ -178,587 +231,364 @@ static INLINE void chacha20_decrypt(struct chacha20 *ctx,
     chacha20_encrypt(ctx, blk, len);
 }
 
-/* Poly1305 implementation (no AES, nonce is not encrypted) */
+#ifdef COMPILER_SUPPORTS_CHACHA_SIMD
+
+#if defined(__clang__) || defined(__GNUC__)
+#    define FUNC_ISA_SSE2 __attribute__ ((target("sse2")))
+#    define FUNC_ISA_AVX2 __attribute__ ((target("avx2")))
+#    include <cpuid.h>
+#else
+#    define FUNC_ISA_SSE2
+#    define FUNC_ISA_AVX2
+#    include <intrin.h>
+#endif
 
-#define NWORDS ((130 + BIGNUM_INT_BITS-1) / BIGNUM_INT_BITS)
-typedef struct bigval {
-    BignumInt w[NWORDS];
-} bigval;
+#include <emmintrin.h>
+#include <immintrin.h>
 
-static void bigval_clear(bigval *r)
+/*
+ * Determinators of CPU type
+ */
+static void chacha20_cpuid(int leaf, unsigned int regs[4])
 {
-    int i;
-    for (i = 0; i < NWORDS; i++)
-        r->w[i] = 0;
+#if defined(__clang__) || defined(__GNUC__)
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#else
+    int info[4];
+    __cpuidex(info, leaf, 0);
+    regs[0] = info[0];
+    regs[1] = info[1];
+    regs[2] = info[2];
+    regs[3] = info[3];
+#endif
 }
 
-static void bigval_import_le(bigval *r, const void *vdata, int len)
+static int supports_sse2(void)
 {
-    const unsigned char *data = (const unsigned char *)vdata;
-    int i;
-    bigval_clear(r);
-    for (i = 0; i < len; i++)
-        r->w[i / BIGNUM_INT_BYTES] |=
-            (BignumInt)data[i] << (8 * (i % BIGNUM_INT_BYTES));
+#if defined(__x86_64__) || defined(_M_X64)
+    return TRUE;                       /* part of the x86-64 baseline */
+#else
+    unsigned int regs[4];
+    chacha20_cpuid(1, regs);
+    return (regs[3] & (1 << 26)) != 0;
+#endif
 }
 
-static void bigval_export_le(const bigval *r, void *vdata, int len)
+static int supports_avx2(void)
 {
-    unsigned char *data = (unsigned char *)vdata;
-    int i;
-    for (i = 0; i < len; i++)
-        data[i] = (unsigned char)(r->w[i / BIGNUM_INT_BYTES] >> (8 * (i % BIGNUM_INT_BYTES)));
+    unsigned int regs[4];
+    unsigned int xcr0;
+
+    chacha20_cpuid(0, regs);
+    if (regs[0] < 7)
+        return FALSE;
+    chacha20_cpuid(1, regs);
+    /* OSXSAVE and AVX, so that we can ask the OS about YMM state */
+    if ((regs[2] & ((1 << 27) | (1 << 28))) != ((1 << 27) | (1 << 28)))
+        return FALSE;
+#if defined(__clang__) || defined(__GNUC__)
+    {
+        unsigned int edx;
+        __asm__ ("xgetbv" : "=a" (xcr0), "=d" (edx) : "c" (0));
+    }
+#else
+    xcr0 = (unsigned int)_xgetbv(0);
+#endif
+    /* XMM and YMM state enabled by the OS */
+    if ((xcr0 & 6) != 6)
+        return FALSE;
+    chacha20_cpuid(7, regs);
+    return (regs[1] & (1 << 5)) != 0;
 }
 
 /*
- * Core functions to do arithmetic mod p = 2^130-5. The whole
- * collection of these, up to and including the surrounding #if, are
- * generated automatically for various sizes of BignumInt by
- * contrib/make1305.py.
+ * 4-way SSE2 version: each vector holds the same state word of four
+ * consecutive blocks.
  */
+#define ROTL128(x, n) \
+    _mm_or_si128(_mm_slli_epi32((x), (n)), _mm_srli_epi32((x), 32 - (n)))
+
+#define QR128(a, b, c, d)                                           \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = ROTL128(d, 16); \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = ROTL128(b, 12); \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = ROTL128(d, 8);  \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = ROTL128(b, 7)
+
+/* Transpose words a..d of four blocks and XOR them into the data */
+#define OUT128(a, b, c, d, offset) do {                                 \
+    __m128i t0 = _mm_unpacklo_epi32(a, b), t1 = _mm_unpacklo_epi32(c, d); \
+    __m128i t2 = _mm_unpackhi_epi32(a, b), t3 = _mm_unpackhi_epi32(c, d); \
+    __m128i *p;                                                         \
+    p = (__m128i *)(blk + (offset));                                    \
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p),               \
+                                      _mm_unpacklo_epi64(t0, t1)));     \
+    p = (__m128i *)(blk + 64 + (offset));                               \
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p),               \
+                                      _mm_unpackhi_epi64(t0, t1)));     \
+    p = (__m128i *)(blk + 128 + (offset));                              \
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p),               \
+                                      _mm_unpacklo_epi64(t2, t3)));     \
+    p = (__m128i *)(blk + 192 + (offset));                              \
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p),               \
+                                      _mm_unpackhi_epi64(t2, t3)));     \
+} while (0)
+
+FUNC_ISA_SSE2
+static void chacha20_blocks_sse2(struct chacha20 *ctx,
+                                 unsigned char *blk, int nblocks)
+{
+    __m128i s[16];
+    int i;
 
-#if BIGNUM_INT_BITS == 16
+    for (i = 0; i < 16; i++)
+        s[i] = _mm_set1_epi32((int)ctx->state[i]);
+
+    for (; nblocks > 0; nblocks -= 4, blk += 4 * 64) {
+        __m128i x0, x1, x2, x3, x4, x5, x6, x7;
+        __m128i x8, x9, x10, x11, x12, x13, x14, x15;
+
+        s[12] = _mm_add_epi32(_mm_set1_epi32((int)ctx->state[12]),
+                              _mm_set_epi32(3, 2, 1, 0));
+        x0 = s[0]; x1 = s[1]; x2 = s[2]; x3 = s[3];
+        x4 = s[4]; x5 = s[5]; x6 = s[6]; x7 = s[7];
+        x8 = s[8]; x9 = s[9]; x10 = s[10]; x11 = s[11];
+        x12 = s[12]; x13 = s[13]; x14 = s[14]; x15 = s[15];
+
+        for (i = 0; i < 20; i += 2) {
+            QR128(x0, x4, x8, x12);
+            QR128(x1, x5, x9, x13);
+            QR128(x2, x6, x10, x14);
+            QR128(x3, x7, x11, x15);
+            QR128(x0, x5, x10, x15);
+            QR128(x1, x6, x11, x12);
+            QR128(x2, x7, x8, x13);
+            QR128(x3, x4, x9, x14);
+        }
 
-static void bigval_add(bigval *r, const bigval *a, const bigval *b)
-{
-    BignumInt v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14;
-    BignumInt v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26;
-    BignumCarry carry;
-
-    v0 = a->w[0];
-    v1 = a->w[1];
-    v2 = a->w[2];
-    v3 = a->w[3];
-    v4 = a->w[4];
-    v5 = a->w[5];
-    v6 = a->w[6];
-    v7 = a->w[7];
-    v8 = a->w[8];
-    v9 = b->w[0];
-    v10 = b->w[1];
-    v11 = b->w[2];
-    v12 = b->w[3];
-    v13 = b->w[4];
-    v14 = b->w[5];
-    v15 = b->w[6];
-    v16 = b->w[7];
-    v17 = b->w[8];
-    BignumADC(v18, carry, v0, v9, 0);
-    BignumADC(v19, carry, v1, v10, carry);
-    BignumADC(v20, carry, v2, v11, carry);
-    BignumADC(v21, carry, v3, v12, carry);
-    BignumADC(v22, carry, v4, v13, carry);
-    BignumADC(v23, carry, v5, v14, carry);
-    BignumADC(v24, carry, v6, v15, carry);
-    BignumADC(v25, carry, v7, v16, carry);
-    v26 = v8 + v17 + carry;
-    r->w[0] = v18;
-    r->w[1] = v19;
-    r->w[2] = v20;
-    r->w[3] = v21;
-    r->w[4] = v22;
-    r->w[5] = v23;
-    r->w[6] = v24;
-    r->w[7] = v25;
-    r->w[8] = v26;
-}
+        x0 = _mm_add_epi32(x0, s[0]); x1 = _mm_add_epi32(x1, s[1]);
+        x2 = _mm_add_epi32(x2, s[2]); x3 = _mm_add_epi32(x3, s[3]);
+        x4 = _mm_add_epi32(x4, s[4]); x5 = _mm_add_epi32(x5, s[5]);
+        x6 = _mm_add_epi32(x6, s[6]); x7 = _mm_add_epi32(x7, s[7]);
+        x8 = _mm_add_epi32(x8, s[8]); x9 = _mm_add_epi32(x9, s[9]);
+        x10 = _mm_add_epi32(x10, s[10]); x11 = _mm_add_epi32(x11, s[11]);
+        x12 = _mm_add_epi32(x12, s[12]); x13 = _mm_add_epi32(x13, s[13]);
+        x14 = _mm_add_epi32(x14, s[14]); x15 = _mm_add_epi32(x15, s[15]);
+
+        OUT128(x0, x1, x2, x3, 0);
+        OUT128(x4, x5, x6, x7, 16);
+        OUT128(x8, x9, x10, x11, 32);
+        OUT128(x12, x13, x14, x15, 48);
+
+        ctx->state[12] += 4;
+    }
 
-static void bigval_mul_mod_p(bigval *r, const bigval *a, const bigval *b)
-{
-    BignumInt v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14;
-    BignumInt v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27;
-    BignumInt v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40;
-    BignumInt v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53;
-    BignumInt v54, v55, v56, v57, v58, v59, v60, v61, v62, v63, v64, v65, v66;
-    BignumInt v67, v68, v69, v70, v71, v72, v73, v74, v75, v76, v77, v78, v79;
-    BignumInt v80, v81, v82, v83, v84, v85, v86, v87, v88, v89, v90, v91, v92;
-    BignumInt v93, v94, v95, v96, v97, v98, v99, v100, v101, v102, v103, v104;
-    BignumInt v105, v106, v107, v108, v109, v110, v111, v112, v113, v114;
-    BignumInt v115, v116, v117, v118, v119, v120, v121, v122, v123, v124;
-    BignumInt v125, v126, v127, v128, v129, v130, v131, v132, v133, v134;
-    BignumInt v135, v136, v137, v138, v139, v140, v141, v142, v143, v144;
-    BignumInt v145, v146, v147, v148, v149, v150, v151, v152, v153, v154;
-    BignumInt v155, v156, v157, v158, v159, v160, v161, v162, v163, v164;
-    BignumInt v165, v166, v167, v168, v169, v170, v171, v172, v173, v174;
-    BignumInt v175, v176, v177, v178, v180, v181, v182, v183, v184, v185;
-    BignumInt v186, v187, v188, v189, v190, v191, v192, v193, v194, v195;
-    BignumInt v196, v197, v198, v199, v200, v201, v202, v203, v204, v205;
-    BignumInt v206, v207, v208, v210, v212, v213, v214, v215, v216, v217;
-    BignumInt v218, v219, v220, v221, v222, v223, v224, v225, v226, v227;
-    BignumInt v228, v229;
-    BignumCarry carry;
-
-    v0 = a->w[0];
-    v1 = a->w[1];
-    v2 = a->w[2];
-    v3 = a->w[3];
-    v4 = a->w[4];
-    v5 = a->w[5];
-    v6 = a->w[6];
-    v7 = a->w[7];
-    v8 = a->w[8];
-    v9 = b->w[0];
-    v10 = b->w[1];
-    v11 = b->w[2];
-    v12 = b->w[3];
-    v13 = b->w[4];
-    v14 = b->w[5];
-    v15 = b->w[6];
-    v16 = b->w[7];
-    v17 = b->w[8];
-    BignumMUL(v19, v18, v0, v9);
-    BignumMULADD(v21, v20, v0, v10, v19);
-    BignumMULADD(v23, v22, v0, v11, v21);
-    BignumMULADD(v25, v24, v0, v12, v23);
-    BignumMULADD(v27, v26, v0, v13, v25);
-    BignumMULADD(v29, v28, v0, v14, v27);
-    BignumMULADD(v31, v30, v0, v15, v29);
-    BignumMULADD(v33, v32, v0, v16, v31);
-    BignumMULADD(v35, v34, v0, v17, v33);
-    BignumMULADD(v37, v36, v1, v9, v20);
-    BignumMULADD2(v39, v38, v1, v10, v22, v37);
-    BignumMULADD2(v41, v40, v1, v11, v24, v39);
-    BignumMULADD2(v43, v42, v1, v12, v26, v41);
-    BignumMULADD2(v45, v44, v1, v13, v28, v43);
-    BignumMULADD2(v47, v46, v1, v14, v30, v45);
-    BignumMULADD2(v49, v48, v1, v15, v32, v47);
-    BignumMULADD2(v51, v50, v1, v16, v34, v49);
-    BignumMULADD2(v53, v52, v1, v17, v35, v51);
-    BignumMULADD(v55, v54, v2, v9, v38);
-    BignumMULADD2(v57, v56, v2, v10, v40, v55);
-    BignumMULADD2(v59, v58, v2, v11, v42, v57);
-    BignumMULADD2(v61, v60, v2, v12, v44, v59);
-    BignumMULADD2(v63, v62, v2, v13, v46, v61);
-    BignumMULADD2(v65, v64, v2, v14, v48, v63);
-    BignumMULADD2(v67, v66, v2, v15, v50, v65);
-    BignumMULADD2(v69, v68, v2, v16, v52, v67);
-    BignumMULADD2(v71, v70, v2, v17, v53, v69);
-    BignumMULADD(v73, v72, v3, v9, v56);
-    BignumMULADD2(v75, v74, v3, v10, v58, v73);
-    BignumMULADD2(v77, v76, v3, v11, v60, v75);
-    BignumMULADD2(v79, v78, v3, v12, v62, v77);
-    BignumMULADD2(v81, v80, v3, v13, v64, v79);
-    BignumMULADD2(v83, v82, v3, v14, v66, v81);
-    BignumMULADD2(v85, v84, v3, v15, v68, v83);
-    BignumMULADD2(v87, v86, v3, v16, v70, v85);
-    BignumMULADD2(v89, v88, v3, v17, v71, v87);
-    BignumMULADD(v91, v90, v4, v9, v74);
-    BignumMULADD2(v93, v92, v4, v10, v76, v91);
-    BignumMULADD2(v95, v94, v4, v11, v78, v93);
-    BignumMULADD2(v97, v96, v4, v12, v80, v95);
-    BignumMULADD2(v99, v98, v4, v13, v82, v97);
-    BignumMULADD2(v101, v100, v4, v14, v84, v99);
-    BignumMULADD2(v103, v102, v4, v15, v86, v101);
-    BignumMULADD2(v105, v104, v4, v16, v88, v103);
-    BignumMULADD2(v107, v106, v4, v17, v89, v105);
-    BignumMULADD(v109, v108, v5, v9, v92);
-    BignumMULADD2(v111, v110, v5, v10, v94, v109);
-    BignumMULADD2(v113, v112, v5, v11, v96, v111);
-    BignumMULADD2(v115, v114, v5, v12, v98, v113);
-    BignumMULADD2(v117, v116, v5, v13, v100, v115);
-    BignumMULADD2(v119, v118, v5, v14, v102, v117);
-    BignumMULADD2(v121, v120, v5, v15, v104, v119);
-    BignumMULADD2(v123, v122, v5, v16, v106, v121);
-    BignumMULADD2(v125, v124, v5, v17, v107, v123);
-    BignumMULADD(v127, v126, v6, v9, v110);
-    BignumMULADD2(v129, v128, v6, v10, v112, v127);
-    BignumMULADD2(v131, v130, v6, v11, v114, v129);
-    BignumMULADD2(v133, v132, v6, v12, v116, v131);
-    BignumMULADD2(v135, v134, v6, v13, v118, v133);
-    BignumMULADD2(v137, v136, v6, v14, v120, v135);
-    BignumMULADD2(v139, v138, v6, v15, v122, v137);
-    BignumMULADD2(v141, v140, v6, v16, v124, v139);
-    BignumMULADD2(v143, v142, v6, v17, v125, v141);
-    BignumMULADD(v145, v144, v7, v9, v128);
-    BignumMULADD2(v147, v146, v7, v10, v130, v145);
-    BignumMULADD2(v149, v148, v7, v11, v132, v147);
-    BignumMULADD2(v151, v150, v7, v12, v134, v149);
-    BignumMULADD2(v153, v152, v7, v13, v136, v151);
-    BignumMULADD2(v155, v154, v7, v14, v138, v153);
-    BignumMULADD2(v157, v156, v7, v15, v140, v155);
-    BignumMULADD2(v159, v158, v7, v16, v142, v157);
-    BignumMULADD2(v161, v160, v7, v17, v143, v159);
-    BignumMULADD(v163, v162, v8, v9, v146);
-    BignumMULADD2(v165, v164, v8, v10, v148, v163);
-    BignumMULADD2(v167, v166, v8, v11, v150, v165);
-    BignumMULADD2(v169, v168, v8, v12, v152, v167);
-    BignumMULADD2(v171, v170, v8, v13, v154, v169);
-    BignumMULADD2(v173, v172, v8, v14, v156, v171);
-    BignumMULADD2(v175, v174, v8, v15, v158, v173);
-    BignumMULADD2(v177, v176, v8, v16, v160, v175);
-    v178 = v8 * v17 + v161 + v177;
-    v180 = (v162) & ((((BignumInt)1) << 2)-1);
-    v181 = ((v162) >> 2) | ((v164) << 14);
-    v182 = ((v164) >> 2) | ((v166) << 14);
-    v183 = ((v166) >> 2) | ((v168) << 14);
-    v184 = ((v168) >> 2) | ((v170) << 14);
-    v185 = ((v170) >> 2) | ((v172) << 14);
-    v186 = ((v172) >> 2) | ((v174) << 14);
-    v187 = ((v174) >> 2) | ((v176) << 14);
-    v188 = ((v176) >> 2) | ((v178) << 14);
-    v189 = (v178) >> 2;
-    v190 = (v189) & ((((BignumInt)1) << 2)-1);
-    v191 = (v178) >> 4;
-    BignumMUL(v193, v192, 5, v181);
-    BignumMULADD(v195, v194, 5, v182, v193);
-    BignumMULADD(v197, v196, 5, v183, v195);
-    BignumMULADD(v199, v198, 5, v184, v197);
-    BignumMULADD(v201, v200, 5, v185, v199);
-    BignumMULADD(v203, v202, 5, v186, v201);
-    BignumMULADD(v205, v204, 5, v187, v203);
-    BignumMULADD(v207, v206, 5, v188, v205);
-    v208 = 5 * v190 + v207;
-    v210 = 25 * v191;
-    BignumADC(v212, carry, v18, v192, 0);
-    BignumADC(v213, carry, v36, v194, carry);
-    BignumADC(v214, carry, v54, v196, carry);
-    BignumADC(v215, carry, v72, v198, carry);
-    BignumADC(v216, carry, v90, v200, carry);
-    BignumADC(v217, carry, v108, v202, carry);
-    BignumADC(v218, carry, v126, v204, carry);
-    BignumADC(v219, carry, v144, v206, carry);
-    v220 = v180 + v208 + carry;
-    BignumADC(v221, carry, v212, v210, 0);
-    BignumADC(v222, carry, v213, 0, carry);
-    BignumADC(v223, carry, v214, 0, carry);
-    BignumADC(v224, carry, v215, 0, carry);
-    BignumADC(v225, carry, v216, 0, carry);
-    BignumADC(v226, carry, v217, 0, carry);
-    BignumADC(v227, carry, v218, 0, carry);
-    BignumADC(v228, carry, v219, 0, carry);
-    v229 = v220 + 0 + carry;
-    r->w[0] = v221;
-    r->w[1] = v222;
-    r->w[2] = v223;
-    r->w[3] = v224;
-    r->w[4] = v225;
-    r->w[5] = v226;
-    r->w[6] = v227;
-    r->w[7] = v228;
-    r->w[8] = v229;
+    smemclr(s, sizeof(s));
 }
 
-static void bigval_final_reduce(bigval *n)
-{
-    BignumInt v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v13, v14, v15;
-    BignumInt v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28;
-    BignumInt v29, v30, v31, v32, v34, v35, v36, v37, v38, v39, v40, v41, v42;
-    BignumInt v43;
-    BignumCarry carry;
-
-    v0 = n->w[0];
-    v1 = n->w[1];
-    v2 = n->w[2];
-    v3 = n->w[3];
-    v4 = n->w[4];
-    v5 = n->w[5];
-    v6 = n->w[6];
-    v7 = n->w[7];
-    v8 = n->w[8];
-    v9 = (v8) >> 2;
-    v10 = (v8) & ((((BignumInt)1) << 2)-1);
-    v11 = 5 * v9;
-    BignumADC(v13, carry, v0, v11, 0);
-    BignumADC(v14, carry, v1, 0, carry);
-    BignumADC(v15, carry, v2, 0, carry);
-    BignumADC(v16, carry, v3, 0, carry);
-    BignumADC(v17, carry, v4, 0, carry);
-    BignumADC(v18, carry, v5, 0, carry);
-    BignumADC(v19, carry, v6, 0, carry);
-    BignumADC(v20, carry, v7, 0, carry);
-    v21 = v10 + 0 + carry;
-    BignumADC(v22, carry, v13, 5, 0);
-    (void)v22;
-    BignumADC(v23, carry, v14, 0, carry);
-    (void)v23;
-    BignumADC(v24, carry, v15, 0, carry);
-    (void)v24;
-    BignumADC(v25, carry, v16, 0, carry);
-    (void)v25;
-    BignumADC(v26, carry, v17, 0, carry);
-    (void)v26;
-    BignumADC(v27, carry, v18, 0, carry);
-    (void)v27;
-    BignumADC(v28, carry, v19, 0, carry);
-    (void)v28;
-    BignumADC(v29, carry, v20, 0, carry);
-    (void)v29;
-    v30 = v21 + 0 + carry;
-    v31 = (v30) >> 2;
-    v32 = 5 * v31;
-    BignumADC(v34, carry, v13, v32, 0);
-    BignumADC(v35, carry, v14, 0, carry);
-    BignumADC(v36, carry, v15, 0, carry);
-    BignumADC(v37, carry, v16, 0, carry);
-    BignumADC(v38, carry, v17, 0, carry);
-    BignumADC(v39, carry, v18, 0, carry);
-    BignumADC(v40, carry, v19, 0, carry);
-    BignumADC(v41, carry, v20, 0, carry);
-    v42 = v21 + 0 + carry;
-    v43 = (v42) & ((((BignumInt)1) << 2)-1);
-    n->w[0] = v34;
-    n->w[1] = v35;
-    n->w[2] = v36;
-    n->w[3] = v37;
-    n->w[4] = v38;
-    n->w[5] = v39;
-    n->w[6] = v40;
-    n->w[7] = v41;
-    n->w[8] = v43;
-}
+#undef ROTL128
+#undef QR128
+#undef OUT128
 
-#elif BIGNUM_INT_BITS == 32
+/*
+ * 8-way AVX2 version: as above, with eight blocks per vector. The
+ * 16- and 8-bit rotations are byte shuffles.
+ */
+#define ROTL256(x, n) \
+    _mm256_or_si256(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+
+#define QR256(a, b, c, d)                                               \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a);             \
+    d = _mm256_shuffle_epi8(d, rot16);                                  \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c);             \
+    b = ROTL256(b, 12);                                                 \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a);             \
+    d = _mm256_shuffle_epi8(d, rot8);                                   \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c);             \
+    b = ROTL256(b, 7)
 
-static void bigval_add(bigval *r, const bigval *a, const bigval *b)
+/*
+ * Transpose words a..d within each 128-bit lane: afterwards rN holds
+ * those words of block N in the low lane and of block N+4 in the
+ * high lane.
+ */
+#define TRANSPOSE256(a, b, c, d) do {                                   \
+    __m256i t0 = _mm256_unpacklo_epi32(a, b), t1 = _mm256_unpacklo_epi32(c, d); \
+    __m256i t2 = _mm256_unpackhi_epi32(a, b), t3 = _mm256_unpackhi_epi32(c, d); \
+    a = _mm256_unpacklo_epi64(t0, t1);                                  \
+    b = _mm256_unpackhi_epi64(t0, t1);                                  \
+    c = _mm256_unpacklo_epi64(t2, t3);                                  \
+    d = _mm256_unpackhi_epi64(t2, t3);                                  \
+} while (0)
+
+/* XOR 32 bytes made of the given lanes of lo and hi into the data */
+#define OUT256(lo, hi, sel, offset) do {                                \
+    __m256i *p = (__m256i *)(blk + (offset));                           \
+    _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p),      \
+                        _mm256_permute2x128_si256(lo, hi, sel)));       \
+} while (0)
+
+FUNC_ISA_AVX2
+static void chacha20_blocks_avx2(struct chacha20 *ctx,
+                                 unsigned char *blk, int nblocks)
 {
-    BignumInt v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14;
-    BignumCarry carry;
-
-    v0 = a->w[0];
-    v1 = a->w[1];
-    v2 = a->w[2];
-    v3 = a->w[3];
-    v4 = a->w[4];
-    v5 = b->w[0];
-    v6 = b->w[1];
-    v7 = b->w[2];
-    v8 = b->w[3];
-    v9 = b->w[4];
-    BignumADC(v10, carry, v0, v5, 0);
-    BignumADC(v11, carry, v1, v6, carry);
-    BignumADC(v12, carry, v2, v7, carry);
-    BignumADC(v13, carry, v3, v8, carry);
-    v14 = v4 + v9 + carry;
-    r->w[0] = v10;
-    r->w[1] = v11;
-    r->w[2] = v12;
-    r->w[3] = v13;
-    r->w[4] = v14;
-}
+    const __m256i rot16 = _mm256_set_epi8(
+        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+    const __m256i rot8 = _mm256_set_epi8(
+        14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+        14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+    __m256i s[16];
+    int i;
 
-static void bigval_mul_mod_p(bigval *r, const bigval *a, const bigval *b)
-{
-    BignumInt v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14;
-    BignumInt v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27;
-    BignumInt v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40;
-    BignumInt v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53;
-    BignumInt v54, v55, v56, v57, v58, v60, v61, v62, v63, v64, v65, v66, v67;
-    BignumInt v68, v69, v70, v71, v72, v73, v74, v75, v76, v78, v80, v81, v82;
-    BignumInt v83, v84, v85, v86, v87, v88, v89;
-    BignumCarry carry;
-
-    v0 = a->w[0];
-    v1 = a->w[1];
-    v2 = a->w[2];
-    v3 = a->w[3];
-    v4 = a->w[4];
-    v5 = b->w[0];
-    v6 = b->w[1];
-    v7 = b->w[2];
-    v8 = b->w[3];
-    v9 = b->w[4];
-    BignumMUL(v11, v10, v0, v5);
-    BignumMULADD(v13, v12, v0, v6, v11);
-    BignumMULADD(v15, v14, v0, v7, v13);
-    BignumMULADD(v17, v16, v0, v8, v15);
-    BignumMULADD(v19, v18, v0, v9, v17);
-    BignumMULADD(v21, v20, v1, v5, v12);
-    BignumMULADD2(v23, v22, v1, v6, v14, v21);
-    BignumMULADD2(v25, v24, v1, v7, v16, v23);
-    BignumMULADD2(v27, v26, v1, v8, v18, v25);
-    BignumMULADD2(v29, v28, v1, v9, v19, v27);
-    BignumMULADD(v31, v30, v2, v5, v22);
-    BignumMULADD2(v33, v32, v2, v6, v24, v31);
-    BignumMULADD2(v35, v34, v2, v7, v26, v33);
-    BignumMULADD2(v37, v36, v2, v8, v28, v35);
-    BignumMULADD2(v39, v38, v2, v9, v29, v37);
-    BignumMULADD(v41, v40, v3, v5, v32);
-    BignumMULADD2(v43, v42, v3, v6, v34, v41);
-    BignumMULADD2(v45, v44, v3, v7, v36, v43);
-    BignumMULADD2(v47, v46, v3, v8, v38, v45);
-    BignumMULADD2(v49, v48, v3, v9, v39, v47);
-    BignumMULADD(v51, v50, v4, v5, v42);
-    BignumMULADD2(v53, v52, v4, v6, v44, v51);
-    BignumMULADD2(v55, v54, v4, v7, v46, v53);
-    BignumMULADD2(v57, v56, v4, v8, v48, v55);
-    v58 = v4 * v9 + v49 + v57;
-    v60 = (v50) & ((((BignumInt)1) << 2)-1);
-    v61 = ((v50) >> 2) | ((v52) << 30);
-    v62 = ((v52) >> 2) | ((v54) << 30);
-    v63 = ((v54) >> 2) | ((v56) << 30);
-    v64 = ((v56) >> 2) | ((v58) << 30);
-    v65 = (v58) >> 2;
-    v66 = (v65) & ((((BignumInt)1) << 2)-1);
-    v67 = (v58) >> 4;
-    BignumMUL(v69, v68, 5, v61);
-    BignumMULADD(v71, v70, 5, v62, v69);
-    BignumMULADD(v73, v72, 5, v63, v71);
-    BignumMULADD(v75, v74, 5, v64, v73);
-    v76 = 5 * v66 + v75;
-    v78 = 25 * v67;
-    BignumADC(v80, carry, v10, v68, 0);
-    BignumADC(v81, carry, v20, v70, carry);
-    BignumADC(v82, carry, v30, v72, carry);
-    BignumADC(v83, carry, v40, v74, carry);
-    v84 = v60 + v76 + carry;
-    BignumADC(v85, carry, v80, v78, 0);
-    BignumADC(v86, carry, v81, 0, carry);
-    BignumADC(v87, carry, v82, 0, carry);
-    BignumADC(v88, carry, v83, 0, carry);
-    v89 = v84 + 0 + carry;
-    r->w[0] = v85;
-    r->w[1] = v86;
-    r->w[2] = v87;
-    r->w[3] = v88;
-    r->w[4] = v89;
-}
+    for (i = 0; i < 16; i++)
+        s[i] = _mm256_set1_epi32((int)ctx->state[i]);
+
+    for (; nblocks > 0; nblocks -= 8, blk += 8 * 64) {
+        __m256i x0, x1, x2, x3, x4, x5, x6, x7;
+        __m256i x8, x9, x10, x11, x12, x13, x14, x15;
+
+        s[12] = _mm256_add_epi32(_mm256_set1_epi32((int)ctx->state[12]),
+                                 _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+        x0 = s[0]; x1 = s[1]; x2 = s[2]; x3 = s[3];
+        x4 = s[4]; x5 = s[5]; x6 = s[6]; x7 = s[7];
+        x8 = s[8]; x9 = s[9]; x10 = s[10]; x11 = s[11];
+        x12 = s[12]; x13 = s[13]; x14 = s[14]; x15 = s[15];
+
+        for (i = 0; i < 20; i += 2) {
+            QR256(x0, x4, x8, x12);
+            QR256(x1, x5, x9, x13);
+            QR256(x2, x6, x10, x14);
+            QR256(x3, x7, x11, x15);
+            QR256(x0, x5, x10, x15);
+            QR256(x1, x6, x11, x12);
+            QR256(x2, x7, x8, x13);
+            QR256(x3, x4, x9, x14);
+        }
 
-static void bigval_final_reduce(bigval *n)
-{
-    BignumInt v0, v1, v2, v3, v4, v5, v6, v7, v9, v10, v11, v12, v13, v14;
-    BignumInt v15, v16, v17, v18, v19, v20, v22, v23, v24, v25, v26, v27;
-    BignumCarry carry;
-
-    v0 = n->w[0];
-    v1 = n->w[1];
-    v2 = n->w[2];
-    v3 = n->w[3];
-    v4 = n->w[4];
-    v5 = (v4) >> 2;
-    v6 = (v4) & ((((BignumInt)1) << 2)-1);
-    v7 = 5 * v5;
-    BignumADC(v9, carry, v0, v7, 0);
-    BignumADC(v10, carry, v1, 0, carry);
-    BignumADC(v11, carry, v2, 0, carry);
-    BignumADC(v12, carry, v3, 0, carry);
-    v13 = v6 + 0 + carry;
-    BignumADC(v14, carry, v9, 5, 0);
-    (void)v14;
-    BignumADC(v15, carry, v10, 0, carry);
-    (void)v15;
-    BignumADC(v16, carry, v11, 0, carry);
-    (void)v16;
-    BignumADC(v17, carry, v12, 0, carry);
-    (void)v17;
-    v18 = v13 + 0 + carry;
-    v19 = (v18) >> 2;
-    v20 = 5 * v19;
-    BignumADC(v22, carry, v9, v20, 0);
-    BignumADC(v23, carry, v10, 0, carry);
-    BignumADC(v24, carry, v11, 0, carry);
-    BignumADC(v25, carry, v12, 0, carry);
-    v26 = v13 + 0 + carry;
-    v27 = (v26) & ((((BignumInt)1) << 2)-1);
-    n->w[0] = v22;
-    n->w[1] = v23;
-    n->w[2] = v24;
-    n->w[3] = v25;
-    n->w[4] = v27;
+        x0 = _mm256_add_epi32(x0, s[0]); x1 = _mm256_add_epi32(x1, s[1]);
+        x2 = _mm256_add_epi32(x2, s[2]); x3 = _mm256_add_epi32(x3, s[3]);
+        x4 = _mm256_add_epi32(x4, s[4]); x5 = _mm256_add_epi32(x5, s[5]);
+        x6 = _mm256_add_epi32(x6, s[6]); x7 = _mm256_add_epi32(x7, s[7]);
+        x8 = _mm256_add_epi32(x8, s[8]); x9 = _mm256_add_epi32(x9, s[9]);
+        x10 = _mm256_add_epi32(x10, s[10]); x11 = _mm256_add_epi32(x11, s[11]);
+        x12 = _mm256_add_epi32(x12, s[12]); x13 = _mm256_add_epi32(x13, s[13]);
+        x14 = _mm256_add_epi32(x14, s[14]); x15 = _mm256_add_epi32(x15, s[15]);
+
+        TRANSPOSE256(x0, x1, x2, x3);
+        TRANSPOSE256(x4, x5, x6, x7);
+        TRANSPOSE256(x8, x9, x10, x11);
+        TRANSPOSE256(x12, x13, x14, x15);
+
+        /* Block N (and N+4) is words 0-7 from xN/xN+4, 8-15 from xN+8/xN+12 */
+        OUT256(x0, x4, 0x20, 0 * 64);
+        OUT256(x8, x12, 0x20, 0 * 64 + 32);
+        OUT256(x1, x5, 0x20, 1 * 64);
+        OUT256(x9, x13, 0x20, 1 * 64 + 32);
+        OUT256(x2, x6, 0x20, 2 * 64);
+        OUT256(x10, x14, 0x20, 2 * 64 + 32);
+        OUT256(x3, x7, 0x20, 3 * 64);
+        OUT256(x11, x15, 0x20, 3 * 64 + 32);
+        OUT256(x0, x4, 0x31, 4 * 64);
+        OUT256(x8, x12, 0x31, 4 * 64 + 32);
+        OUT256(x1, x5, 0x31, 5 * 64);
+        OUT256(x9, x13, 0x31, 5 * 64 + 32);
+        OUT256(x2, x6, 0x31, 6 * 64);
+        OUT256(x10, x14, 0x31, 6 * 64 + 32);
+        OUT256(x3, x7, 0x31, 7 * 64);
+        OUT256(x11, x15, 0x31, 7 * 64 + 32);
+
+        ctx->state[12] += 8;
+    }
+
+    smemclr(s, sizeof(s));
+    _mm256_zeroupper();
 }
 
-#elif BIGNUM_INT_BITS == 64
+#undef ROTL256
+#undef QR256
+#undef TRANSPOSE256
+#undef OUT256
 
-static void bigval_add(bigval *r, const bigval *a, const bigval *b)
+static void chacha20_select_blocks(struct chacha20 *ctx)
 {
-    BignumInt v0, v1, v2, v3, v4, v5, v6, v7, v8;
-    BignumCarry carry;
-
-    v0 = a->w[0];
-    v1 = a->w[1];
-    v2 = a->w[2];
-    v3 = b->w[0];
-    v4 = b->w[1];
-    v5 = b->w[2];
-    BignumADC(v6, carry, v0, v3, 0);
-    BignumADC(v7, carry, v1, v4, carry);
-    v8 = v2 + v5 + carry;
-    r->w[0] = v6;
-    r->w[1] = v7;
-    r->w[2] = v8;
+    static int detected = FALSE, has_sse2, has_avx2;
+
+    /* Benign race: every thread computes the same answer */
+    if (!detected) {
+        has_sse2 = supports_sse2();
+        has_avx2 = supports_avx2();
+        detected = TRUE;
+    }
+
+    if (has_avx2) {
+        ctx->blocks = chacha20_blocks_avx2;
+        ctx->blocksBatch = 8;
+    } else if (has_sse2) {
+        ctx->blocks = chacha20_blocks_sse2;
+        ctx->blocksBatch = 4;
+    } else {
+        ctx->blocks = NULL;
+        ctx->blocksBatch = 0;
+    }
 }
 
-static void bigval_mul_mod_p(bigval *r, const bigval *a, const bigval *b)
+#else /* COMPILER_SUPPORTS_CHACHA_SIMD */
+
+static void chacha20_select_blocks(struct chacha20 *ctx)
 {
-    BignumInt v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14;
-    BignumInt v15, v16, v17, v18, v19, v20, v21, v22, v24, v25, v26, v27, v28;
-    BignumInt v29, v30, v31, v32, v33, v34, v36, v38, v39, v40, v41, v42, v43;
-    BignumCarry carry;
-
-    v0 = a->w[0];
-    v1 = a->w[1];
-    v2 = a->w[2];
-    v3 = b->w[0];
-    v4 = b->w[1];
-    v5 = b->w[2];
-    BignumMUL(v7, v6, v0, v3);
-    BignumMULADD(v9, v8, v0, v4, v7);
-    BignumMULADD(v11, v10, v0, v5, v9);
-    BignumMULADD(v13, v12, v1, v3, v8);
-    BignumMULADD2(v15, v14, v1, v4, v10, v13);
-    BignumMULADD2(v17, v16, v1, v5, v11, v15);
-    BignumMULADD(v19, v18, v2, v3, v14);
-    BignumMULADD2(v21, v20, v2, v4, v16, v19);
-    v22 = v2 * v5 + v17 + v21;
-    v24 = (v18) & ((((BignumInt)1) << 2)-1);
-    v25 = ((v18) >> 2) | ((v20) << 62);
-    v26 = ((v20) >> 2) | ((v22) << 62);
-    v27 = (v22) >> 2;
-    v28 = (v27) & ((((BignumInt)1) << 2)-1);
-    v29 = (v22) >> 4;
-    BignumMUL(v31, v30, 5, v25);
-    BignumMULADD(v33, v32, 5, v26, v31);
-    v34 = 5 * v28 + v33;
-    v36 = 25 * v29;
-    BignumADC(v38, carry, v6, v30, 0);
-    BignumADC(v39, carry, v12, v32, carry);
-    v40 = v24 + v34 + carry;
-    BignumADC(v41, carry, v38, v36, 0);
-    BignumADC(v42, carry, v39, 0, carry);
-    v43 = v40 + 0 + carry;
-    r->w[0] = v41;
-    r->w[1] = v42;
-    r->w[2] = v43;
+    ctx->blocks = NULL;
+    ctx->blocksBatch = 0;
 }
 
-static void bigval_final_reduce(bigval *n)
+#endif /* COMPILER_SUPPORTS_CHACHA_SIMD */
+
+/*
+ * Poly1305 implementation (no AES, nonce is not encrypted), after
+ * poly1305-donna. Where a 64x64->128-bit multiply is available, h
+ * and r are kept in three 44-bit limbs; otherwise in five 26-bit
+ * limbs using 32x32->64-bit multiplies.
+ */
+
+typedef unsigned long long poly_u64;
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#   include <intrin.h>
+#   define POLY1305_RADIX_44
+typedef struct { poly_u64 lo, hi; } poly_u128;
+#   define POLY_MUL(out, x, y) ((out).lo = _umul128((x), (y), &(out).hi))
+#   define POLY_ADD(out, in) do { poly_u64 t_ = (out).lo; (out).lo += (in).lo; \
+        (out).hi += ((out).lo < t_) + (in).hi; } while (0)
+#   define POLY_ADDLO(out, in) do { poly_u64 t_ = (out).lo; (out).lo += (in); \
+        (out).hi += ((out).lo < t_); } while (0)
+#   define POLY_SHR(in, shift) (__shiftright128((in).lo, (in).hi, (shift)))
+#   define POLY_LO(in) ((in).lo)
+#elif defined(__SIZEOF_INT128__)
+#   define POLY1305_RADIX_44
+typedef unsigned __int128 poly_u128;
+#   define POLY_MUL(out, x, y) ((out) = (poly_u128)(x) * (y))
+#   define POLY_ADD(out, in) ((out) += (in))
+#   define POLY_ADDLO(out, in) ((out) += (in))
+#   define POLY_SHR(in, shift) ((poly_u64)((in) >> (shift)))
+#   define POLY_LO(in) ((poly_u64)(in))
+#endif
+
+static INLINE poly_u64 poly_get64(const unsigned char *p)
 {
-    BignumInt v0, v1, v2, v3, v4, v5, v7, v8, v9, v10, v11, v12, v13, v14;
-    BignumInt v16, v17, v18, v19;
-    BignumCarry carry;
-
-    v0 = n->w[0];
-    v1 = n->w[1];
-    v2 = n->w[2];
-    v3 = (v2) >> 2;
-    v4 = (v2) & ((((BignumInt)1) << 2)-1);
-    v5 = 5 * v3;
-    BignumADC(v7, carry, v0, v5, 0);
-    BignumADC(v8, carry, v1, 0, carry);
-    v9 = v4 + 0 + carry;
-    BignumADC(v10, carry, v7, 5, 0);
-    (void)v10;
-    BignumADC(v11, carry, v8, 0, carry);
-    (void)v11;
-    v12 = v9 + 0 + carry;
-    v13 = (v12) >> 2;
-    v14 = 5 * v13;
-    BignumADC(v16, carry, v7, v14, 0);
-    BignumADC(v17, carry, v8, 0, carry);
-    v18 = v9 + 0 + carry;
-    v19 = (v18) & ((((BignumInt)1) << 2)-1);
-    n->w[0] = v16;
-    n->w[1] = v17;
-    n->w[2] = v19;
+    return (poly_u64)GET_32BIT_LSB_FIRST(p) |
+        ((poly_u64)GET_32BIT_LSB_FIRST(p + 4) << 32);
 }
 
+struct poly1305 {
+#ifdef POLY1305_RADIX_44
+    poly_u64 r[3];
+    poly_u64 h[3];
 #else
-#error Add another bit count to contrib/make1305.py and rerun it
+    uint32 r[5];
+    uint32 h[5];
 #endif
-
-struct poly1305 {
     unsigned char nonce[16];
-    bigval r;
-    bigval h;
+    /* Set while the last, padded chunk is processed */
+    int final;
 
     /* Buffer in case we get less that a multiple of 16 bytes */
     unsigned char buffer[16];
@@ -768,43 +598,121 @@ struct poly1305 {
 static void poly1305_init(struct poly1305 *ctx)
 {
     memset(ctx->nonce, 0, 16);
+    memset(ctx->h, 0, sizeof(ctx->h));
+    ctx->final = 0;
     ctx->bufferIndex = 0;
-    bigval_clear(&ctx->h);
 }
 
 /* Takes a 256 bit key */
 static void poly1305_key(struct poly1305 *ctx, const unsigned char *key)
 {
-    unsigned char key_copy[16];
-    memcpy(key_copy, key, 16);
-
-    /* Key the MAC itself
-     * bytes 4, 8, 12 and 16 are required to have their top four bits clear */
-    key_copy[3] &= 0x0f;
-    key_copy[7] &= 0x0f;
-    key_copy[11] &= 0x0f;
-    key_copy[15] &= 0x0f;
-    /* bytes 5, 9 and 13 are required to have their bottom two bits clear */
-    key_copy[4] &= 0xfc;
-    key_copy[8] &= 0xfc;
-    key_copy[12] &= 0xfc;
-    bigval_import_le(&ctx->r, key_copy, 16);
-    smemclr(key_copy, sizeof(key_copy));
+    /* Key the MAC itself; the masks clamp r as the spec requires
+     * (top four bits of bytes 3, 7, 11, 15 and bottom two bits of
+     * bytes 4, 8, 12 clear) */
+#ifdef POLY1305_RADIX_44
+    poly_u64 t0 = poly_get64(key), t1 = poly_get64(key + 8);
+    ctx->r[0] = (t0) & 0xffc0fffffffULL;
+    ctx->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+    ctx->r[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+#else
+    ctx->r[0] = (GET_32BIT_LSB_FIRST(key + 0)) & 0x3ffffff;
+    ctx->r[1] = (GET_32BIT_LSB_FIRST(key + 3) >> 2) & 0x3ffff03;
+    ctx->r[2] = (GET_32BIT_LSB_FIRST(key + 6) >> 4) & 0x3ffc0ff;
+    ctx->r[3] = (GET_32BIT_LSB_FIRST(key + 9) >> 6) & 0x3f03fff;
+    ctx->r[4] = (GET_32BIT_LSB_FIRST(key + 12) >> 8) & 0x00fffff;
+#endif
 
     /* Use second 128 bits are the nonce */
     memcpy(ctx->nonce, key+16, 16);
 }
 
-/* Feed up to 16 bytes (should only be less for the last chunk) */
-static void poly1305_feed_chunk(struct poly1305 *ctx,
-                                const unsigned char *chunk, int len)
+/* Process whole 16-byte chunks: h = (h + chunk) * r mod 2^130-5 */
+static void poly1305_blocks(struct poly1305 *ctx,
+                            const unsigned char *m, int len)
 {
-    bigval c;
-    bigval_import_le(&c, chunk, len);
-    c.w[len / BIGNUM_INT_BYTES] |=
-        (BignumInt)1 << (8 * (len % BIGNUM_INT_BYTES));
-    bigval_add(&c, &c, &ctx->h);
-    bigval_mul_mod_p(&ctx->h, &c, &ctx->r);
+#ifdef POLY1305_RADIX_44
+    const poly_u64 hibit = ctx->final ? 0 : ((poly_u64)1 << 40); /* 2^128 */
+    poly_u64 r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2];
+    poly_u64 s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+    poly_u64 h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+    poly_u64 c;
+    poly_u128 d0, d1, d2, d;
+
+    while (len >= 16) {
+        poly_u64 t0 = poly_get64(m), t1 = poly_get64(m + 8);
+
+        h0 += (t0) & 0xfffffffffffULL;
+        h1 += ((t0 >> 44) | (t1 << 20)) & 0xfffffffffffULL;
+        h2 += ((t1 >> 24) & 0x3ffffffffffULL) | hibit;
+
+        POLY_MUL(d0, h0, r0); POLY_MUL(d, h1, s2); POLY_ADD(d0, d);
+        POLY_MUL(d, h2, s1); POLY_ADD(d0, d);
+        POLY_MUL(d1, h0, r1); POLY_MUL(d, h1, r0); POLY_ADD(d1, d);
+        POLY_MUL(d, h2, s2); POLY_ADD(d1, d);
+        POLY_MUL(d2, h0, r2); POLY_MUL(d, h1, r1); POLY_ADD(d2, d);
+        POLY_MUL(d, h2, r0); POLY_ADD(d2, d);
+
+        c = POLY_SHR(d0, 44); h0 = POLY_LO(d0) & 0xfffffffffffULL;
+        POLY_ADDLO(d1, c);
+        c = POLY_SHR(d1, 44); h1 = POLY_LO(d1) & 0xfffffffffffULL;
+        POLY_ADDLO(d2, c);
+        c = POLY_SHR(d2, 42); h2 = POLY_LO(d2) & 0x3ffffffffffULL;
+        h0 += c * 5; c = h0 >> 44; h0 &= 0xfffffffffffULL;
+        h1 += c;
+
+        m += 16;
+        len -= 16;
+    }
+
+    ctx->h[0] = h0;
+    ctx->h[1] = h1;
+    ctx->h[2] = h2;
+#else
+    const uint32 hibit = ctx->final ? 0 : ((uint32)1 << 24); /* 2^128 */
+    uint32 r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2];
+    uint32 r3 = ctx->r[3], r4 = ctx->r[4];
+    uint32 s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32 h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+    uint32 h3 = ctx->h[3], h4 = ctx->h[4];
+    uint32 c;
+    poly_u64 d0, d1, d2, d3, d4;
+
+    while (len >= 16) {
+        h0 += (GET_32BIT_LSB_FIRST(m + 0)) & 0x3ffffff;
+        h1 += (GET_32BIT_LSB_FIRST(m + 3) >> 2) & 0x3ffffff;
+        h2 += (GET_32BIT_LSB_FIRST(m + 6) >> 4) & 0x3ffffff;
+        h3 += (GET_32BIT_LSB_FIRST(m + 9) >> 6) & 0x3ffffff;
+        h4 += (GET_32BIT_LSB_FIRST(m + 12) >> 8) | hibit;
+
+        d0 = ((poly_u64)h0 * r0) + ((poly_u64)h1 * s4) + ((poly_u64)h2 * s3) +
+             ((poly_u64)h3 * s2) + ((poly_u64)h4 * s1);
+        d1 = ((poly_u64)h0 * r1) + ((poly_u64)h1 * r0) + ((poly_u64)h2 * s4) +
+             ((poly_u64)h3 * s3) + ((poly_u64)h4 * s2);
+        d2 = ((poly_u64)h0 * r2) + ((poly_u64)h1 * r1) + ((poly_u64)h2 * r0) +
+             ((poly_u64)h3 * s4) + ((poly_u64)h4 * s3);
+        d3 = ((poly_u64)h0 * r3) + ((poly_u64)h1 * r2) + ((poly_u64)h2 * r1) +
+             ((poly_u64)h3 * r0) + ((poly_u64)h4 * s4);
+        d4 = ((poly_u64)h0 * r4) + ((poly_u64)h1 * r3) + ((poly_u64)h2 * r2) +
+             ((poly_u64)h3 * r1) + ((poly_u64)h4 * r0);
+
+        c = (uint32)(d0 >> 26); h0 = (uint32)d0 & 0x3ffffff;
+        d1 += c; c = (uint32)(d1 >> 26); h1 = (uint32)d1 & 0x3ffffff;
+        d2 += c; c = (uint32)(d2 >> 26); h2 = (uint32)d2 & 0x3ffffff;
+        d3 += c; c = (uint32)(d3 >> 26); h3 = (uint32)d3 & 0x3ffffff;
+        d4 += c; c = (uint32)(d4 >> 26); h4 = (uint32)d4 & 0x3ffffff;
+        h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+        h1 += c;
+
+        m += 16;
+        len -= 16;
+    }
+
+    ctx->h[0] = h0;
+    ctx->h[1] = h1;
+    ctx->h[2] = h2;
+    ctx->h[3] = h3;
+    ctx->h[4] = h4;
+#endif
 }
 
 static void poly1305_feed(struct poly1305 *ctx,
@@ -818,16 +726,17 @@ static void poly1305_feed(struct poly1305 *ctx,
             --len;
         }
         if (ctx->bufferIndex == 16) {
-            poly1305_feed_chunk(ctx, ctx->buffer, 16);
+            poly1305_blocks(ctx, ctx->buffer, 16);
             ctx->bufferIndex = 0;
         }
     }
 
     /* Process 16 byte whole chunks */
-    while (len >= 16) {
-        poly1305_feed_chunk(ctx, buf, 16);
-        len -= 16;
-        buf += 16;
+    if (len >= 16) {
+        int whole = len & ~15;
+        poly1305_blocks(ctx, buf, whole);
+        len -= whole;
+        buf += whole;
     }
 
     /* Cache stuff that's left over */
@@ -840,16 +749,105 @@ static void poly1305_feed(struct poly1305 *ctx,
 /* Finalise and populate buffer with 16 byte with MAC */
 static void poly1305_finalise(struct poly1305 *ctx, unsigned char *mac)
 {
-    bigval tmp;
-
+    /* A short last chunk is padded with a 1 byte instead of 2^128 */
     if (ctx->bufferIndex) {
-        poly1305_feed_chunk(ctx, ctx->buffer, ctx->bufferIndex);
+        int i = ctx->bufferIndex;
+        ctx->buffer[i++] = 1;
+        while (i < 16)
+            ctx->buffer[i++] = 0;
+        ctx->final = 1;
+        poly1305_blocks(ctx, ctx->buffer, 16);
     }
 
-    bigval_import_le(&tmp, ctx->nonce, 16);
-    bigval_final_reduce(&ctx->h);
-    bigval_add(&tmp, &tmp, &ctx->h);
-    bigval_export_le(&tmp, mac, 16);
+    {
+#ifdef POLY1305_RADIX_44
+        poly_u64 h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+        poly_u64 g0, g1, g2, c, t0, t1;
+
+        /* Fully carry h */
+        c = h1 >> 44; h1 &= 0xfffffffffffULL;
+        h2 += c; c = h2 >> 42; h2 &= 0x3ffffffffffULL;
+        h0 += c * 5; c = h0 >> 44; h0 &= 0xfffffffffffULL;
+        h1 += c; c = h1 >> 44; h1 &= 0xfffffffffffULL;
+        h2 += c; c = h2 >> 42; h2 &= 0x3ffffffffffULL;
+        h0 += c * 5; c = h0 >> 44; h0 &= 0xfffffffffffULL;
+        h1 += c;
+
+        /* Compute h - p, and select it if h >= p, in constant time */
+        g0 = h0 + 5; c = g0 >> 44; g0 &= 0xfffffffffffULL;
+        g1 = h1 + c; c = g1 >> 44; g1 &= 0xfffffffffffULL;
+        g2 = h2 + c - ((poly_u64)1 << 42);
+        c = (g2 >> 63) - 1;
+        g0 &= c; g1 &= c; g2 &= c;
+        c = ~c;
+        h0 = (h0 & c) | g0;
+        h1 = (h1 & c) | g1;
+        h2 = (h2 & c) | g2;
+
+        /* mac = (h + nonce) mod 2^128 */
+        t0 = poly_get64(ctx->nonce);
+        t1 = poly_get64(ctx->nonce + 8);
+        h0 += (t0) & 0xfffffffffffULL; c = h0 >> 44; h0 &= 0xfffffffffffULL;
+        h1 += (((t0 >> 44) | (t1 << 20)) & 0xfffffffffffULL) + c;
+        c = h1 >> 44; h1 &= 0xfffffffffffULL;
+        h2 += ((t1 >> 24) & 0x3ffffffffffULL) + c; h2 &= 0x3ffffffffffULL;
+
+        h0 = h0 | (h1 << 44);
+        h1 = (h1 >> 20) | (h2 << 24);
+        PUT_32BIT_LSB_FIRST(mac, (uint32)h0);
+        PUT_32BIT_LSB_FIRST(mac + 4, (uint32)(h0 >> 32));
+        PUT_32BIT_LSB_FIRST(mac + 8, (uint32)h1);
+        PUT_32BIT_LSB_FIRST(mac + 12, (uint32)(h1 >> 32));
+#else
+        uint32 h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+        uint32 h3 = ctx->h[3], h4 = ctx->h[4];
+        uint32 g0, g1, g2, g3, g4, c, mask;
+        poly_u64 f;
+
+        /* Fully carry h */
+        c = h1 >> 26; h1 &= 0x3ffffff;
+        h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+        h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+        h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+        h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+        h1 += c;
+
+        /* Compute h - p, and select it if h >= p, in constant time */
+        g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+        g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+        g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+        g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+        g4 = h4 + c - ((uint32)1 << 26);
+        mask = (g4 >> 31) - 1;
+        g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+        mask = ~mask;
+        h0 = (h0 & mask) | g0;
+        h1 = (h1 & mask) | g1;
+        h2 = (h2 & mask) | g2;
+        h3 = (h3 & mask) | g3;
+        h4 = (h4 & mask) | g4;
+
+        /* h = h mod 2^128 */
+        h0 = h0 | (h1 << 26);
+        h1 = (h1 >> 6) | (h2 << 20);
+        h2 = (h2 >> 12) | (h3 << 14);
+        h3 = (h3 >> 18) | (h4 << 8);
+
+        /* mac = (h + nonce) mod 2^128 */
+        f = (poly_u64)h0 + GET_32BIT_LSB_FIRST(ctx->nonce); h0 = (uint32)f;
+        f = (poly_u64)h1 + GET_32BIT_LSB_FIRST(ctx->nonce + 4) + (f >> 32);
+        h1 = (uint32)f;
+        f = (poly_u64)h2 + GET_32BIT_LSB_FIRST(ctx->nonce + 8) + (f >> 32);
+        h2 = (uint32)f;
+        f = (poly_u64)h3 + GET_32BIT_LSB_FIRST(ctx->nonce + 12) + (f >> 32);
+        h3 = (uint32)f;
+
+        PUT_32BIT_LSB_FIRST(mac, h0);
+        PUT_32BIT_LSB_FIRST(mac + 4, h1);
+        PUT_32BIT_LSB_FIRST(mac + 8, h2);
+        PUT_32BIT_LSB_FIRST(mac + 12, h3);
+#endif
+    }
 }
 
 /* SSH-2 wrapper */
@@ -0,0 +1,247 @@
+/*
+ * Zlib (RFC1950 / RFC1951) compression for PuTTY, using the zlib
+ * library bundled in libs/zlib instead of the compressor in
+ * sshzlib.c.
+ *
+ * sshzlib.c only ever emits static-Huffman blocks from a shallow
+ * match search, which makes it cheap to carry around but slow and
+ * weak on bulk transfers. This module drives the library's deflate at
+ * a configurable level and uses its table-driven inflate. As OpenSSH
+ * does, every packet is terminated with Z_PARTIAL_FLUSH, so the
+ * stream is the same format that sshzlib.c produces and accepts.
+ *
+ * It is selected instead of ssh_zlib (for both "zlib" and the
+ * delayed "zlib@openssh.com") when CONF_compression_level is set.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <zlib.h>
+
+#include "ssh.h"
+
+#ifndef FALSE
+#define FALSE 0
+#define TRUE (!FALSE)
+#endif
+
+struct zlibx_compress_ctx {
+    z_stream strm;
+    int level;			       /* level asked for by the user */
+    int curlevel;		       /* level deflate is running at */
+    int firstblock;		       /* zlib header not yet emitted */
+    int comp_disabled;		       /* store the next block verbatim */
+};
+
+static voidpf zlibx_alloc(voidpf opaque, uInt items, uInt size)
+{
+    return snmalloc(items, size);
+}
+
+static void zlibx_free(voidpf opaque, voidpf address)
+{
+    sfree(address);
+}
+
+/*
+ * Grow an output buffer that deflate or inflate has filled, and point
+ * the stream at the new free space.
+ */
+static unsigned char *zlibx_grow(z_stream *strm, unsigned char *outbuf,
+				 int *outsize)
+{
+    int done = *outsize;
+
+    *outsize = done + done / 2 + 256;
+    outbuf = sresize(outbuf, *outsize, unsigned char);
+    strm->next_out = outbuf + done;
+    strm->avail_out = *outsize - done;
+    return outbuf;
+}
+
+static void *zlibx_compress_init_level(int level)
+{
+    struct zlibx_compress_ctx *ctx = snew(struct zlibx_compress_ctx);
+    int ret;
+
+    if (level < 1 || level > 9)
+	level = Z_DEFAULT_COMPRESSION;
+
+    memset(&ctx->strm, 0, sizeof(ctx->strm));
+    ctx->strm.zalloc = zlibx_alloc;
+    ctx->strm.zfree = zlibx_free;
+    ret = deflateInit(&ctx->strm, level);
+    assert(ret == Z_OK);
+
+    ctx->level = ctx->curlevel = level;
+    ctx->firstblock = TRUE;
+    ctx->comp_disabled = FALSE;
+
+    return ctx;
+}
+
+static void *zlibx_compress_init(void)
+{
+    return zlibx_compress_init_level(Z_DEFAULT_COMPRESSION);
+}
+
+static void zlibx_compress_cleanup(void *handle)
+{
+    struct zlibx_compress_ctx *ctx = (struct zlibx_compress_ctx *)handle;
+
+    deflateEnd(&ctx->strm);
+    sfree(ctx);
+}
+
+/*
+ * Store the next block instead of compressing it, so that ssh.c can
+ * build an IGNORE packet of a precise length. Returns the number of
+ * bytes the block will grow by.
+ *
+ * Every block ends with a partial flush, so there are no pending
+ * input bytes and at most a few pending output bits. The stored block
+ * costs its 3-bit header padded to a byte boundary (together with
+ * those bits), then LEN and NLEN; the partial flush after it emits
+ * a 10-bit empty static block, of which one whole byte goes out. The
+ * very first block is also preceded by the two-byte zlib header.
+ */
+static int zlibx_disable_compression(void *handle)
+{
+    struct zlibx_compress_ctx *ctx = (struct zlibx_compress_ctx *)handle;
+    uint32_t pending;
+    int bits, n;
+
+    ctx->comp_disabled = TRUE;
+
+    if (deflatePending(&ctx->strm, &pending, &bits) != Z_OK)
+	bits = 0;
+
+    n = ctx->firstblock ? 2 : 0;
+    n += (bits + 3 + 7) / 8;
+    n += 4;
+    n += 1;
+
+    return n;
+}
+
+static int zlibx_compress_block(void *handle, unsigned char *block, int len,
+				unsigned char **outblock, int *outlen)
+{
+    struct zlibx_compress_ctx *ctx = (struct zlibx_compress_ctx *)handle;
+    int level = ctx->comp_disabled ? 0 : ctx->level;
+    unsigned char *outbuf;
+    int outsize, ret;
+
+    /* Enough for most packets, even incompressible ones */
+    outsize = len + len / 16 + 64;
+    outbuf = snewn(outsize, unsigned char);
+    ctx->strm.next_out = outbuf;
+    ctx->strm.avail_out = outsize;
+
+    /*
+     * Switch between storing and compressing. The previous block was
+     * flushed, so this produces no output of its own. (This relies on
+     * the deflate_stored window fix from zlib 1.2.12, which libs/zlib
+     * carries.)
+     */
+    if (level != ctx->curlevel) {
+	ret = deflateParams(&ctx->strm, level, Z_DEFAULT_STRATEGY);
+	assert(ret == Z_OK);
+	ctx->curlevel = level;
+    }
+
+    ctx->strm.next_in = block;
+    ctx->strm.avail_in = len;
+    while (1) {
+	ret = deflate(&ctx->strm, Z_PARTIAL_FLUSH);
+	assert(ret == Z_OK || ret == Z_BUF_ERROR);
+	/* deflate leaves output space only once it has flushed everything */
+	if (ctx->strm.avail_out != 0)
+	    break;
+	outbuf = zlibx_grow(&ctx->strm, outbuf, &outsize);
+    }
+
+    ctx->firstblock = FALSE;
+    ctx->comp_disabled = FALSE;
+
+    *outblock = outbuf;
+    *outlen = outsize - ctx->strm.avail_out;
+    return 1;
+}
+
+static void *zlibx_decompress_init(void)
+{
+    z_stream *strm = snew(z_stream);
+    int ret;
+
+    memset(strm, 0, sizeof(*strm));
+    strm->zalloc = zlibx_alloc;
+    strm->zfree = zlibx_free;
+    ret = inflateInit(strm);
+    assert(ret == Z_OK);
+
+    return strm;
+}
+
+static void zlibx_decompress_cleanup(void *handle)
+{
+    z_stream *strm = (z_stream *)handle;
+
+    inflateEnd(strm);
+    sfree(strm);
+}
+
+static int zlibx_decompress_block(void *handle, unsigned char *block, int len,
+				  unsigned char **outblock, int *outlen)
+{
+    z_stream *strm = (z_stream *)handle;
+    unsigned char *outbuf;
+    int outsize, ret;
+
+    outsize = len * 4 + 256;
+    outbuf = snewn(outsize, unsigned char);
+    strm->next_out = outbuf;
+    strm->avail_out = outsize;
+    strm->next_in = block;
+    strm->avail_in = len;
+
+    while (1) {
+	ret = inflate(strm, Z_SYNC_FLUSH);
+	if (ret != Z_OK && ret != Z_BUF_ERROR)
+	    goto decode_error;
+	/* Output space left over means all the input has been used */
+	if (strm->avail_out != 0)
+	    break;
+	outbuf = zlibx_grow(strm, outbuf, &outsize);
+    }
+    if (strm->avail_in != 0)
+	goto decode_error;
+
+    *outblock = outbuf;
+    *outlen = outsize - strm->avail_out;
+    return 1;
+
+  decode_error:
+    sfree(outbuf);
+    *outblock = NULL;
+    *outlen = 0;
+    return 0;
+}
+
+const struct ssh_compress ssh_zlibx = {
+    "zlib",
+    "zlib@openssh.com", /* delayed version */
+    zlibx_compress_init,
+    zlibx_compress_cleanup,
+    zlibx_compress_block,
+    zlibx_decompress_init,
+    zlibx_decompress_cleanup,
+    zlibx_decompress_block,
+    zlibx_disable_compression,
+    "zlib (RFC1950, bundled library)",
+#ifdef MPEXT
+    zlibx_compress_init_level
+#endif
+};
@@ -631,6 +631,19 @@ void *handle_get_privdata(struct handle *h);
 struct handle *handle_add_foreign_event(HANDLE event,
                                         void (*callback)(void *), void *ctx);
 
+#ifdef MPEXT
+/*
+ * Exports from winworker.c.
+ */
+typedef struct worker_tag *Worker;
+typedef void (*worker_fn_t)(void *ctx);
+Worker worker_new(void);
+void worker_free(Worker w);
+unsigned long worker_submit(Worker w, worker_fn_t fn, void *ctx);
+int worker_done(Worker w, unsigned long job);
+void worker_wait(Worker w, unsigned long job);
+#endif
+
 /*
  * winpgntc.c needs to schedule callbacks for asynchronous agent
  * requests. This has to be done differently in GUI and console, so
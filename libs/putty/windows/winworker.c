@@ -0,0 +1,175 @@
+/*
+ * winworker.c: a single background thread that runs jobs submitted
+ * by the main thread, strictly in submission order.
+ *
+ * Jobs are numbered from 1 as they are submitted, and the main
+ * thread finds out which have finished by comparing a job's number
+ * with the count of completed jobs. The worker never allocates or
+ * frees memory: job records are allocated by the main thread and
+ * recycled through a spare list.
+ */
+
+#include <assert.h>
+
+#include "putty.h"
+
+struct worker_job {
+    worker_fn_t fn;
+    void *ctx;
+    struct worker_job *next;
+};
+
+struct worker_tag {
+    CRITICAL_SECTION lock;	       /* guards the lists and `quit' */
+    HANDLE ev_work;		       /* signalled to the worker */
+    HANDLE ev_done;		       /* signalled to the main thread */
+    HANDLE thread;
+    struct worker_job *head, *tail;    /* jobs not yet started */
+    struct worker_job *spare;	       /* finished job records */
+    unsigned long submitted;	       /* main thread only */
+    volatile LONG completed;
+    int quit;
+};
+
+static DWORD WINAPI worker_threadfunc(void *param)
+{
+    Worker w = (Worker)param;
+
+    while (1) {
+	struct worker_job *job;
+
+	EnterCriticalSection(&w->lock);
+	job = w->head;
+	if (job) {
+	    w->head = job->next;
+	    if (!w->head)
+		w->tail = NULL;
+	}
+	LeaveCriticalSection(&w->lock);
+
+	if (!job) {
+	    if (w->quit)
+		break;
+	    WaitForSingleObject(w->ev_work, INFINITE);
+	    continue;
+	}
+
+	job->fn(job->ctx);
+
+	EnterCriticalSection(&w->lock);
+	job->next = w->spare;
+	w->spare = job;
+	LeaveCriticalSection(&w->lock);
+
+	/* full barrier: the job's results are visible before the count */
+	InterlockedIncrement(&w->completed);
+	SetEvent(w->ev_done);
+    }
+
+    return 0;
+}
+
+Worker worker_new(void)
+{
+    Worker w = snew(struct worker_tag);
+    DWORD threadid;
+
+    InitializeCriticalSection(&w->lock);
+    w->ev_work = CreateEvent(NULL, FALSE, FALSE, NULL);
+    w->ev_done = CreateEvent(NULL, FALSE, FALSE, NULL);
+    w->head = w->tail = w->spare = NULL;
+    w->submitted = 0;
+    w->completed = 0;
+    w->quit = FALSE;
+    w->thread = CreateThread(NULL, 0, worker_threadfunc, w, 0, &threadid);
+
+    if (!w->ev_work || !w->ev_done || !w->thread) {
+	if (w->thread)
+	    CloseHandle(w->thread);
+	if (w->ev_work)
+	    CloseHandle(w->ev_work);
+	if (w->ev_done)
+	    CloseHandle(w->ev_done);
+	DeleteCriticalSection(&w->lock);
+	sfree(w);
+	return NULL;
+    }
+
+    return w;
+}
+
+/*
+ * Finish every job already submitted, then stop the thread and free
+ * the worker.
+ */
+void worker_free(Worker w)
+{
+    struct worker_job *job;
+
+    EnterCriticalSection(&w->lock);
+    w->quit = TRUE;
+    LeaveCriticalSection(&w->lock);
+    SetEvent(w->ev_work);
+    WaitForSingleObject(w->thread, INFINITE);
+
+    assert(!w->head);
+    while ((job = w->spare) != NULL) {
+	w->spare = job->next;
+	sfree(job);
+    }
+    CloseHandle(w->thread);
+    CloseHandle(w->ev_work);
+    CloseHandle(w->ev_done);
+    DeleteCriticalSection(&w->lock);
+    sfree(w);
+}
+
+/*
+ * Queue fn(ctx) to run after every job submitted before it. Returns
+ * the job's number.
+ */
+unsigned long worker_submit(Worker w, worker_fn_t fn, void *ctx)
+{
+    struct worker_job *job;
+
+    EnterCriticalSection(&w->lock);
+    job = w->spare;
+    if (job)
+	w->spare = job->next;
+    LeaveCriticalSection(&w->lock);
+    if (!job)
+	job = snew(struct worker_job);
+
+    job->fn = fn;
+    job->ctx = ctx;
+    job->next = NULL;
+
+    EnterCriticalSection(&w->lock);
+    if (w->tail)
+	w->tail->next = job;
+    else
+	w->head = job;
+    w->tail = job;
+    LeaveCriticalSection(&w->lock);
+    SetEvent(w->ev_work);
+
+    return ++w->submitted;
+}
+
+/*
+ * Has the given job finished? If so, everything it wrote is visible
+ * to the caller.
+ */
+int worker_done(Worker w, unsigned long job)
+{
+    unsigned long completed =
+	(unsigned long)InterlockedCompareExchange(&w->completed, 0, 0);
+
+    return (long)(completed - job) >= 0;
+}
+
+void worker_wait(Worker w, unsigned long job)
+{
+    while (!worker_done(w, job))
+	WaitForSingleObject(w->ev_done, INFINITE);
+}
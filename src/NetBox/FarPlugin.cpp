@@ -1889,17 +1889,12 @@ intptr_t TCustomFarFileSystem::GetFindData(
   struct PluginPanelItem **PanelItem, int *ItemsNumber, int OpMode)
 {
   ResetCachedInfo();
-  std::unique_ptr<TObjectList> PanelItems(new TObjectList());
-  bool Result = !FClosed && GetFindDataEx(PanelItems.get(), OpMode);
-  if (Result && PanelItems->GetCount())
+  TFarPanelItems PanelItems;
+  bool Result = !FClosed && GetFindDataEx(&PanelItems, OpMode);
+  if (Result && PanelItems.GetCount())
   {
-    *PanelItem = nb::calloc<PluginPanelItem *>(PanelItems->GetCount(), sizeof(PluginPanelItem));
-    *ItemsNumber = ToInt(PanelItems->GetCount());
-    for (intptr_t Index = 0; Index < PanelItems->GetCount(); ++Index)
-    {
-      PanelItems->GetAs<TCustomFarPanelItem>(Index)->FillPanelItem(
-        &((*PanelItem)[Index]));
-    }
+    *ItemsNumber = ToInt(PanelItems.GetCount());
+    *PanelItem = PanelItems.Detach();
   }
   else
   {
@@ -1917,18 +1912,7 @@ void TCustomFarFileSystem::FreeFindData(
   if (PanelItem)
   {
     DebugAssert(ItemsNumber > 0);
-    for (intptr_t Index = 0; Index < ItemsNumber; ++Index)
-    {
-      nb_free(PanelItem[Index].FindData.lpwszFileName);
-      nb_free(PanelItem[Index].Description);
-      nb_free(PanelItem[Index].Owner);
-      for (intptr_t CustomIndex = 0; CustomIndex < PanelItem[Index].CustomColumnNumber; ++CustomIndex)
-      {
-        nb_free(PanelItem[Index].CustomColumnData[CustomIndex]);
-      }
-      nb_free(PanelItem[Index].CustomColumnData);
-    }
-    nb_free(PanelItem);
+    TFarPanelItems::Free(PanelItem);
   }
 }
 
@@ -2364,7 +2348,8 @@ UnicodeString TCustomFarPanelItem::GetCustomColumnData(size_t /*Column*/)
   return L"";
 }
 
-void TCustomFarPanelItem::FillPanelItem(struct PluginPanelItem *PanelItem)
+void TCustomFarPanelItem::FillPanelItem(struct PluginPanelItem *PanelItem,
+  TFarPanelItems *PanelItems)
 {
   DebugAssert(PanelItem);
 
@@ -2387,18 +2372,147 @@ void TCustomFarPanelItem::FillPanelItem(struct PluginPanelItem *PanelItem)
   PanelItem->FindData.ftLastWriteTime = FileTime;
   PanelItem->FindData.nFileSize = Size;
 
-  PanelItem->FindData.lpwszFileName = TCustomFarPlugin::DuplicateStr(FileName);
-  PanelItem->Description = TCustomFarPlugin::DuplicateStr(Description);
-  PanelItem->Owner = TCustomFarPlugin::DuplicateStr(Owner);
-  wchar_t **CustomColumnData = nb::calloc<wchar_t **>(1 + PanelItem->CustomColumnNumber, sizeof(wchar_t *));
+  PanelItem->FindData.lpwszFileName = PanelItems->DuplicateStr(FileName);
+  PanelItem->Description = PanelItems->DuplicateStr(Description);
+  PanelItem->Owner = PanelItems->DuplicateStr(Owner);
+  wchar_t **CustomColumnData = PanelItems->AllocateStrArray(1 + PanelItem->CustomColumnNumber);
   for (intptr_t Index = 0; Index < PanelItem->CustomColumnNumber; ++Index)
   {
     CustomColumnData[Index] =
-      TCustomFarPlugin::DuplicateStr(GetCustomColumnData(Index));
+      PanelItems->DuplicateStr(GetCustomColumnData(Index));
   }
   PanelItem->CustomColumnData = CustomColumnData;
 }
 
+// Placed in front of the item array handed over to Far,
+// so that the arena can be found from the array alone.
+struct TFarPanelItemsHeader
+{
+  uint8_t *Chunks;
+  int64_t Reserved; // keeps the items 8-byte aligned
+};
+
+static const size_t FarPanelItemsMinChunkSize = 64 * 1024;
+
+TFarPanelItems::TFarPanelItems() :
+  TObject(),
+  FBlock(nullptr),
+  FCount(0),
+  FCapacity(0),
+  FChunks(nullptr),
+  FChunkSize(0),
+  FChunkUsed(0)
+{
+}
+
+TFarPanelItems::~TFarPanelItems()
+{
+  FreeChunks(FChunks);
+  if (FBlock != nullptr)
+  {
+    nb_free(FBlock);
+  }
+}
+
+PluginPanelItem *TFarPanelItems::GetItems() const
+{
+  return reinterpret_cast<PluginPanelItem *>(FBlock + sizeof(TFarPanelItemsHeader));
+}
+
+void TFarPanelItems::Reserve(intptr_t Count)
+{
+  if (Count > FCapacity)
+  {
+    // strings live in the arena, so the items can move freely
+    FBlock = nb::realloc<uint8_t *>(FBlock,
+      sizeof(TFarPanelItemsHeader) + Count * sizeof(PluginPanelItem));
+    FCapacity = Count;
+  }
+}
+
+void TFarPanelItems::Add(TCustomFarPanelItem &Item)
+{
+  if (FCount == FCapacity)
+  {
+    Reserve(Max<intptr_t>(FCapacity * 2, 64));
+  }
+  PluginPanelItem *PanelItem = &GetItems()[FCount];
+  ClearStruct(*PanelItem);
+  Item.FillPanelItem(PanelItem, this);
+  ++FCount;
+}
+
+PluginPanelItem *TFarPanelItems::Detach()
+{
+  DebugAssert(FBlock != nullptr);
+  reinterpret_cast<TFarPanelItemsHeader *>(FBlock)->Chunks = FChunks;
+  PluginPanelItem *Result = GetItems();
+  FBlock = nullptr;
+  FCount = 0;
+  FCapacity = 0;
+  FChunks = nullptr;
+  FChunkSize = 0;
+  FChunkUsed = 0;
+  return Result;
+}
+
+void TFarPanelItems::Free(PluginPanelItem *PanelItems)
+{
+  uint8_t *Block = reinterpret_cast<uint8_t *>(PanelItems) - sizeof(TFarPanelItemsHeader);
+  FreeChunks(reinterpret_cast<TFarPanelItemsHeader *>(Block)->Chunks);
+  nb_free(Block);
+}
+
+void TFarPanelItems::FreeChunks(uint8_t *Chunks)
+{
+  while (Chunks != nullptr)
+  {
+    uint8_t *Next = *reinterpret_cast<uint8_t **>(Chunks);
+    nb_free(Chunks);
+    Chunks = Next;
+  }
+}
+
+// Chunks are linked through their first pointer and double in size,
+// so even a huge listing takes only a handful of them.
+void *TFarPanelItems::Allocate(size_t Size)
+{
+  Size = (Size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  if ((FChunks == nullptr) || (FChunkUsed + Size > FChunkSize))
+  {
+    size_t ChunkSize = Max(FChunkSize * 2, FarPanelItemsMinChunkSize);
+    ChunkSize = Max(ChunkSize, sizeof(void *) + Size);
+    uint8_t *Chunk = static_cast<uint8_t *>(nb_malloc(ChunkSize));
+    *reinterpret_cast<uint8_t **>(Chunk) = FChunks;
+    FChunks = Chunk;
+    FChunkSize = ChunkSize;
+    FChunkUsed = sizeof(void *);
+  }
+  void *Result = FChunks + FChunkUsed;
+  FChunkUsed += Size;
+  return Result;
+}
+
+wchar_t *TFarPanelItems::DuplicateStr(UnicodeString Str)
+{
+  if (Str.IsEmpty())
+  {
+    return nullptr;
+  }
+  const size_t Size = (Str.Length() + 1) * sizeof(wchar_t);
+  wchar_t *Result = static_cast<wchar_t *>(Allocate(Size));
+  memmove(Result, Str.c_str(), Size);
+  return Result;
+}
+
+wchar_t **TFarPanelItems::AllocateStrArray(intptr_t Count)
+{
+  const size_t Size = Count * sizeof(wchar_t *);
+  wchar_t **Result = static_cast<wchar_t **>(Allocate(Size));
+  memset(Result, 0, Size);
+  return Result;
+}
+
 TFarPanelItem::TFarPanelItem(PluginPanelItem *APanelItem, bool OwnsItem) :
   TCustomFarPanelItem(OBJECT_CLASS_TFarPanelItem),
   FPanelItem(APanelItem),
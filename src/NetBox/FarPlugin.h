@@ -18,6 +18,7 @@ class TFarDialogItem;
 class TFarMessageDialog;
 class TFarEditorInfo;
 class TFarPluginGuard;
+class TFarPanelItems;
 
 const int MaxMessageWidth = 64;
 
@@ -290,7 +291,7 @@ protected:
     UnicodeString &PanelTitle, TFarPanelModes *PanelModes, int &StartPanelMode,
     int &StartSortMode, bool &StartSortOrder, TFarKeyBarTitles *KeyBarTitles,
     UnicodeString &ShortcutData) = 0;
-  virtual bool GetFindDataEx(TObjectList *PanelItems, int OpMode) = 0;
+  virtual bool GetFindDataEx(TFarPanelItems *PanelItems, int OpMode) = 0;
   virtual bool ProcessHostFileEx(TObjectList *PanelItems, int OpMode);
   virtual bool ProcessKeyEx(intptr_t Key, uintptr_t ControlState);
   virtual bool ProcessEventEx(intptr_t Event, void *Param);
@@ -391,6 +392,7 @@ private:
 class TCustomFarPanelItem : public TObject
 {
   friend class TCustomFarFileSystem;
+  friend class TFarPanelItems;
 public:
   static inline bool classof(const TObject *Obj) { return Obj->is(OBJECT_CLASS_TCustomFarPanelItem); }
   virtual bool is(TObjectClassId Kind) const override { return (Kind == OBJECT_CLASS_TCustomFarPanelItem) || TObject::is(Kind); }
@@ -407,7 +409,7 @@ protected:
     UnicodeString &Owner, void *&UserData, int &CustomColumnNumber) = 0;
   virtual UnicodeString GetCustomColumnData(size_t Column);
 
-  void FillPanelItem(struct PluginPanelItem *PanelItem);
+  void FillPanelItem(struct PluginPanelItem *PanelItem, TFarPanelItems *PanelItems);
 };
 
 class TFarPanelItem : public TCustomFarPanelItem
@@ -460,6 +462,38 @@ private:
   UnicodeString FHint;
 };
 
+// PluginPanelItem array returned by TCustomFarFileSystem::GetFindData.
+// Strings of all items are allocated from a single arena, released
+// together with the array by Free.
+class TFarPanelItems : public TObject
+{
+  NB_DISABLE_COPY(TFarPanelItems)
+public:
+  TFarPanelItems();
+  virtual ~TFarPanelItems();
+
+  void Reserve(intptr_t Count);
+  void Add(TCustomFarPanelItem &Item);
+  intptr_t GetCount() const { return FCount; }
+  PluginPanelItem *Detach();
+  static void Free(PluginPanelItem *PanelItems);
+
+  wchar_t *DuplicateStr(UnicodeString Str);
+  wchar_t **AllocateStrArray(intptr_t Count);
+
+private:
+  uint8_t *FBlock;
+  intptr_t FCount;
+  intptr_t FCapacity;
+  uint8_t *FChunks;
+  size_t FChunkSize;
+  size_t FChunkUsed;
+
+  PluginPanelItem *GetItems() const;
+  void *Allocate(size_t Size);
+  static void FreeChunks(uint8_t *Chunks);
+};
+
 enum TFarPanelType
 {
   ptFile,
@@ -454,7 +454,7 @@ void TWinSCPFileSystem::GetOpenPluginInfoEx(DWORD &Flags,
   }
 }
 
-bool TWinSCPFileSystem::GetFindDataEx(TObjectList *PanelItems, int OpMode)
+bool TWinSCPFileSystem::GetFindDataEx(TFarPanelItems *PanelItems, int OpMode)
 {
   bool Result = false;
   if (Connected())
@@ -478,6 +478,7 @@ bool TWinSCPFileSystem::GetFindDataEx(TObjectList *PanelItems, int OpMode)
 
       TCustomFileSystem *FileSystem = GetTerminal()->GetFileSystem();
       bool ResolveSymlinks = GetSessionData()->GetResolveSymlinks();
+      PanelItems->Reserve(GetTerminal()->GetFiles()->GetCount());
       for (intptr_t Index = 0; Index < GetTerminal()->GetFiles()->GetCount(); ++Index)
       {
         TRemoteFile *File = GetTerminal()->GetFiles()->GetFile(Index);
@@ -486,11 +487,13 @@ bool TWinSCPFileSystem::GetFindDataEx(TObjectList *PanelItems, int OpMode)
         {
           if (FarPlugin->CheckForEsc())
             break;
-          // Check what kind of symlink this is
+          // Check what kind of symlink this is.
+          // The target is kept in the listing as the linked file, either
+          // resolved already while reading the directory or read here once.
+          TRemoteFile *LinkFile = File->GetLinkedFile();
           const UnicodeString LinkFileName = File->GetLinkTo();
-          if (!LinkFileName.IsEmpty())
+          if ((LinkFile == nullptr) && !LinkFileName.IsEmpty())
           {
-            TRemoteFile *LinkFile = nullptr;
             try
             {
               FileSystem->ReadFile(LinkFileName, LinkFile);
@@ -499,14 +502,15 @@ bool TWinSCPFileSystem::GetFindDataEx(TObjectList *PanelItems, int OpMode)
             {
               LinkFile = nullptr;
             }
-            if ((LinkFile != nullptr) && LinkFile->GetIsDirectory())
-            {
-              File->SetType(FILETYPE_DIRECTORY);
-            }
-            SAFE_DESTROY(LinkFile);
+            File->SetLinkedFile(LinkFile);
+          }
+          if ((LinkFile != nullptr) && LinkFile->GetIsDirectory())
+          {
+            File->SetType(FILETYPE_DIRECTORY);
           }
         }
-        PanelItems->Add(new TRemoteFilePanelItem(File));
+        TRemoteFilePanelItem PanelItem(File);
+        PanelItems->Add(PanelItem);
       }
     }
     Result = true;
@@ -538,24 +542,28 @@ bool TWinSCPFileSystem::GetFindDataEx(TObjectList *PanelItems, int OpMode)
           Name.SetLength(Slash - 1);
           if (ChildPaths->IndexOf(Name) < 0)
           {
-            PanelItems->Add(new TSessionFolderPanelItem(Name));
+            TSessionFolderPanelItem PanelItem(Name);
+            PanelItems->Add(PanelItem);
             ChildPaths->Add(Name);
           }
         }
         else
         {
-          PanelItems->Add(new TSessionPanelItem(Data));
+          TSessionPanelItem PanelItem(Data);
+          PanelItems->Add(PanelItem);
         }
       }
     }
 
     if (!FNewSessionsFolder.IsEmpty())
     {
-      PanelItems->Add(new TSessionFolderPanelItem(FNewSessionsFolder));
+      TSessionFolderPanelItem PanelItem(FNewSessionsFolder);
+      PanelItems->Add(PanelItem);
     }
     if (PanelItems->GetCount() == 0)
     {
-      PanelItems->Add(new THintPanelItem(GetMsg(NB_NEW_SESSION_HINT)));
+      THintPanelItem PanelItem(GetMsg(NB_NEW_SESSION_HINT));
+      PanelItems->Add(PanelItem);
     }
 
     TWinSCPFileSystem *OppositeFileSystem =
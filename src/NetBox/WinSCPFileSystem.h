@@ -105,7 +105,7 @@ protected:
     UnicodeString &PanelTitle, TFarPanelModes *PanelModes, int &StartPanelMode,
     int &StartSortMode, bool &StartSortOrder, TFarKeyBarTitles *KeyBarTitles,
     UnicodeString &ShortcutData) override;
-  virtual bool GetFindDataEx(TObjectList *PanelItems, int OpMode) override;
+  virtual bool GetFindDataEx(TFarPanelItems *PanelItems, int OpMode) override;
   virtual bool ProcessKeyEx(intptr_t Key, uintptr_t ControlState) override;
   virtual bool SetDirectoryEx(UnicodeString Dir, int OpMode) override;
   virtual intptr_t MakeDirectoryEx(UnicodeString &Name, int OpMode) override;
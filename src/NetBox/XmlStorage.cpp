@@ -1,6 +1,7 @@
 
 #include <Classes.hpp>
 #include <Common.h>
+#include <rdestl/hash_map.h>
 #include "XmlStorage.h"
 #include "FarUtils.h"
 
@@ -10,11 +11,118 @@ static const char *CONST_SESSION_NODE = "Session";
 static const char *CONST_VERSION_ATTR = "version";
 static const char *CONST_NAME_ATTR = "name";
 
+//--- TXmlElementIndex ------------------------------------------------------
+struct TXmlNameEqual
+{
+  bool operator()(const char *Key1, const char *Key2) const
+  {
+    return strcmp(Key1, Key2) == 0;
+  }
+};
+
+// Child elements of one element, by the element name and, for session
+// nodes, by the name attribute. Keys point into the elements themselves
+// and are compared as the raw (UTF-8) bytes. Only the first element
+// of each name is indexed, as that is what a sibling walk finds.
+class TXmlElementIndex
+{
+  NB_DISABLE_COPY(TXmlElementIndex)
+public:
+  typedef rde::hash_map<const char *, tinyxml2::XMLElement *, TNameHash, 6, TXmlNameEqual> TElements;
+
+  explicit TXmlElementIndex(tinyxml2::XMLElement *Parent) :
+    Duplicates(0)
+  {
+    for (tinyxml2::XMLElement *Element = Parent->FirstChildElement();
+      Element != nullptr; Element = Element->NextSiblingElement())
+    {
+      Add(Element);
+    }
+  }
+
+  void Add(tinyxml2::XMLElement *Element)
+  {
+    Add(Names, Element->Name(), Element);
+    const char *SessionName = GetSessionName(Element);
+    if (SessionName != nullptr)
+    {
+      Add(Sessions, SessionName, Element);
+    }
+  }
+
+  // To be called before the element is deleted
+  void Remove(tinyxml2::XMLElement *Element)
+  {
+    Remove(Names, Element->Name(), Element, false);
+    const char *SessionName = GetSessionName(Element);
+    if (SessionName != nullptr)
+    {
+      Remove(Sessions, SessionName, Element, true);
+    }
+  }
+
+  static tinyxml2::XMLElement *Find(const TElements &Elements, const char *Key)
+  {
+    TElements::const_iterator It = Elements.find(Key);
+    return (It != Elements.end()) ? It->second : nullptr;
+  }
+
+  TElements Names;
+  TElements Sessions;
+
+private:
+  static const char *GetSessionName(const tinyxml2::XMLElement *Element)
+  {
+    return (strcmp(Element->Name(), CONST_SESSION_NODE) == 0) ? Element->Attribute(CONST_NAME_ATTR) : nullptr;
+  }
+
+  void Add(TElements &Elements, const char *Key, tinyxml2::XMLElement *Element)
+  {
+    TElements::iterator It = Elements.find(Key);
+    if (It == Elements.end())
+    {
+      Elements.insert(TElements::value_type(Key, Element));
+    }
+    else if (It->second != Element)
+    {
+      Duplicates++;
+    }
+  }
+
+  void Remove(TElements &Elements, const char *Key, tinyxml2::XMLElement *Element, bool Session)
+  {
+    TElements::iterator It = Elements.find(Key);
+    if ((It != Elements.end()) && (It->second == Element))
+    {
+      Elements.erase(It);
+      // the element was the first of its name,
+      // a following one of the same name takes the place
+      for (tinyxml2::XMLElement *Next = (Duplicates > 0) ? Element->NextSiblingElement() : nullptr;
+        Next != nullptr; Next = Next->NextSiblingElement())
+      {
+        const char *NextKey = Session ? GetSessionName(Next) : Next->Name();
+        if ((NextKey != nullptr) && (strcmp(NextKey, Key) == 0))
+        {
+          Elements.insert(TElements::value_type(NextKey, Next));
+          break;
+        }
+      }
+    }
+  }
+
+  // elements not indexed, because the name was taken already
+  // (not decremented, only tells whether to look for them)
+  intptr_t Duplicates;
+};
+
+//--- TXmlStorage -----------------------------------------------------------
+
 TXmlStorage::TXmlStorage(UnicodeString AStorage,
   UnicodeString StoredSessionsSubKey) :
   THierarchicalStorage(::ExcludeTrailingBackslash(AStorage)),
   FXmlDoc(nullptr),
   FCurrentElement(nullptr),
+  FCurrentIndex(nullptr),
   FStoredSessionsSubKey(StoredSessionsSubKey),
   FFailed(0),
   FStoredSessionsOpened(false)
@@ -33,9 +141,20 @@ TXmlStorage::~TXmlStorage()
   {
     WriteXml();
   }
+  DestroyIndexes();
   SAFE_DESTROY_EX(tinyxml2::XMLDocument, FXmlDoc);
 }
 
+void TXmlStorage::DestroyIndexes()
+{
+  SAFE_DESTROY_EX(TXmlElementIndex, FCurrentIndex);
+  for (size_t Index = 0; Index < FSubIndexes.size(); ++Index)
+  {
+    delete FSubIndexes[Index];
+  }
+  FSubIndexes.clear();
+}
+
 bool TXmlStorage::ReadXml()
 {
   CNBFile xmlFile;
@@ -78,6 +197,7 @@ bool TXmlStorage::ReadXml()
   tinyxml2::XMLElement *Element = xmlRoot->FirstChildElement(AnsiString(FStoredSessionsSubKey).c_str());
   if (Element != nullptr)
   {
+    DestroyIndexes();
     FCurrentElement = FXmlDoc->RootElement();
     return true;
   }
@@ -151,6 +271,7 @@ bool TXmlStorage::DoOpenSubKey(UnicodeString MungedSubKey, bool CanCreate)
       Element = FXmlDoc->NewElement(SubKey.c_str());
     }
     FCurrentElement->LinkEndChild(Element);
+    IndexChild(Element);
   }
   else
   {
@@ -160,7 +281,9 @@ bool TXmlStorage::DoOpenSubKey(UnicodeString MungedSubKey, bool CanCreate)
   if (Result)
   {
     FSubElements.push_back(OldCurrentElement);
+    FSubIndexes.push_back(FCurrentIndex);
     FCurrentElement = Element;
+    FCurrentIndex = nullptr;
     FStoredSessionsOpened = (MungedSubKey == FStoredSessionsSubKey);
   }
   return Result;
@@ -169,10 +292,13 @@ bool TXmlStorage::DoOpenSubKey(UnicodeString MungedSubKey, bool CanCreate)
 void TXmlStorage::CloseSubKey()
 {
   THierarchicalStorage::CloseSubKey();
+  SAFE_DESTROY_EX(TXmlElementIndex, FCurrentIndex);
   if (FKeyHistory->GetCount() && !FSubElements.empty())
   {
     FCurrentElement = FSubElements.back();
     FSubElements.pop_back();
+    FCurrentIndex = FSubIndexes.back();
+    FSubIndexes.pop_back();
   }
   else
   {
@@ -186,7 +312,7 @@ bool TXmlStorage::DeleteSubKey(UnicodeString SubKey)
   tinyxml2::XMLElement *Element = FindElement(SubKey);
   if (Element != nullptr)
   {
-    FCurrentElement->DeleteChild(Element);
+    DeleteChild(Element);
     Result = true;
   }
   return Result;
@@ -214,7 +340,7 @@ bool TXmlStorage::DeleteValue(UnicodeString Name)
   tinyxml2::XMLElement *Element = FindElement(Name);
   if (Element != nullptr)
   {
-    FCurrentElement->DeleteChild(Element);
+    DeleteChild(Element);
     Result = true;
   }
   return Result;
@@ -225,7 +351,7 @@ void TXmlStorage::RemoveIfExists(UnicodeString Name)
   tinyxml2::XMLElement *Element = FindElement(Name);
   if (Element != nullptr)
   {
-    FCurrentElement->DeleteChild(Element);
+    DeleteChild(Element);
   }
 }
 
@@ -236,6 +362,7 @@ void TXmlStorage::AddNewElement(UnicodeString Name, UnicodeString Value)
   tinyxml2::XMLElement *Element = FXmlDoc->NewElement(StrName.c_str());
   Element->LinkEndChild(FXmlDoc->NewText(StrValue.c_str()));
   FCurrentElement->LinkEndChild(Element);
+  IndexChild(Element);
 }
 
 UnicodeString TXmlStorage::GetSubKeyText(UnicodeString Name) const
@@ -245,42 +372,53 @@ UnicodeString TXmlStorage::GetSubKeyText(UnicodeString Name) const
   {
     return UnicodeString();
   }
-  if (ToUnicodeString(CONST_SESSION_NODE) == Name)
+  if (strcmp(Element->Name(), CONST_SESSION_NODE) == 0)
   {
     return ToUnicodeString(Element->Attribute(CONST_NAME_ATTR));
   }
   return ToUnicodeString(Element->GetText());
 }
 
-tinyxml2::XMLElement *TXmlStorage::FindElement(UnicodeString Name) const
+TXmlElementIndex *TXmlStorage::GetCurrentIndex() const
 {
-  for (const tinyxml2::XMLElement *Element = FCurrentElement->FirstChildElement();
-    Element != nullptr; Element = Element->NextSiblingElement())
+  if (FCurrentIndex == nullptr)
   {
-    UnicodeString ElementName = ToUnicodeString(Element->Name());
-    if (ElementName == Name)
-    {
-      return const_cast<tinyxml2::XMLElement *>(Element);
-    }
+    FCurrentIndex = new TXmlElementIndex(FCurrentElement);
+  }
+  return FCurrentIndex;
+}
+
+void TXmlStorage::IndexChild(tinyxml2::XMLElement *Element)
+{
+  if (FCurrentIndex != nullptr)
+  {
+    FCurrentIndex->Add(Element);
+  }
+}
+
+void TXmlStorage::DeleteChild(tinyxml2::XMLElement *Element)
+{
+  if (FCurrentIndex != nullptr)
+  {
+    FCurrentIndex->Remove(Element);
   }
-  return nullptr;
+  FCurrentElement->DeleteChild(Element);
+}
+
+tinyxml2::XMLElement *TXmlStorage::FindElement(UnicodeString Name) const
+{
+  AnsiString Key(Name);
+  return TXmlElementIndex::Find(GetCurrentIndex()->Names, Key.c_str());
 }
 
 tinyxml2::XMLElement *TXmlStorage::FindChildElement(AnsiString SubKey) const
 {
   tinyxml2::XMLElement *Result = nullptr;
   // DebugAssert(FCurrentElement);
-  if (FStoredSessionsOpened)
-  {
-    tinyxml2::XMLElement *Element = FCurrentElement->FirstChildElement(CONST_SESSION_NODE);
-    if (Element && !strcmp(Element->Attribute(CONST_NAME_ATTR), SubKey.c_str()))
-    {
-      Result = Element;
-    }
-  }
-  else if (FCurrentElement)
+  if (FCurrentElement)
   {
-    Result = FCurrentElement->FirstChildElement(SubKey.c_str());
+    const TXmlElementIndex *Index = GetCurrentIndex();
+    Result = TXmlElementIndex::Find(FStoredSessionsOpened ? Index->Sessions : Index->Names, SubKey.c_str());
   }
   return Result;
 }
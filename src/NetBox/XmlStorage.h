@@ -4,6 +4,8 @@
 #include "HierarchicalStorage.h"
 #include "tinyxml2.h"
 
+class TXmlElementIndex;
+
 class TXmlStorage : public THierarchicalStorage
 {
 public:
@@ -56,6 +58,10 @@ private:
   void RemoveIfExists(UnicodeString Name);
   void AddNewElement(UnicodeString Name, UnicodeString Value);
   tinyxml2::XMLElement *FindChildElement(AnsiString SubKey) const;
+  TXmlElementIndex *GetCurrentIndex() const;
+  void IndexChild(tinyxml2::XMLElement *Element);
+  void DeleteChild(tinyxml2::XMLElement *Element);
+  void DestroyIndexes();
   UnicodeString GetValue(tinyxml2::XMLElement *Element) const;
 
   bool ReadXml();
@@ -65,6 +71,9 @@ private:
   tinyxml2::XMLDocument *FXmlDoc;
   rde::vector<tinyxml2::XMLElement *> FSubElements;
   tinyxml2::XMLElement *FCurrentElement;
+  // children of FCurrentElement and of FSubElements by name, built lazily
+  mutable TXmlElementIndex *FCurrentIndex;
+  rde::vector<TXmlElementIndex *> FSubIndexes;
   UnicodeString FStoredSessionsSubKey;
   intptr_t FFailed;
   bool FStoredSessionsOpened;
@@ -2,6 +2,7 @@
 #pragma once
 
 #include <rdestl/map.h>
+#include <rdestl/hash.h>
 
 #include <Global.h>
 #include <Exceptions.h>
@@ -369,6 +370,31 @@ private:
 
 typedef rde::vector<UnicodeString> TUnicodeStringVector;
 
+// FNV-1a hash of strings, for rde::hash_map keyed by names
+struct TNameHash
+{
+  rde::hash_value_t operator()(const UnicodeString &Key) const
+  {
+    uint32_t Result = 2166136261U;
+    const wchar_t *Data = Key.c_str();
+    for (intptr_t Index = 0; Index < Key.Length(); ++Index)
+    {
+      Result = (Result ^ static_cast<uint32_t>(Data[Index])) * 16777619U;
+    }
+    return static_cast<rde::hash_value_t>(Result);
+  }
+
+  rde::hash_value_t operator()(const char *Key) const
+  {
+    uint32_t Result = 2166136261U;
+    for (const unsigned char *Ptr = reinterpret_cast<const unsigned char *>(Key); *Ptr != 0; ++Ptr)
+    {
+      Result = (Result ^ *Ptr) * 16777619U;
+    }
+    return static_cast<rde::hash_value_t>(Result);
+  }
+};
+
 
 namespace base {
 //TODO: move to Sysutils.hpp
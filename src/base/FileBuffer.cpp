@@ -5,6 +5,11 @@
 #include <Common.h>
 #include <FileBuffer.h>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FILEBUFFER_SSE2
+#endif
+
 const wchar_t * EOLTypeNames = L"LF;CRLF;CR";
 
 char * EOLToStr(TEOLType EOLType)
@@ -99,30 +104,78 @@ int64_t TFileBuffer::LoadStream(TStream * Stream, const int64_t Len, bool ForceL
   return ReadStream(Stream, Len, ForceLen);
 }
 
+// Returns the first occurrence of C1 or C2 in [Ptr, End), or End.
+// Ordinary text has long runs without any EOL char, so these are
+// skipped 16 bytes at a time where SSE2 is available.
+static const char * FindEOLChar(const char * Ptr, const char * End, char C1, char C2)
+{
+#if defined(FILEBUFFER_SSE2)
+  const __m128i Mask1 = _mm_set1_epi8(C1);
+  const __m128i Mask2 = _mm_set1_epi8(C2);
+  while (End - Ptr >= 16)
+  {
+    const __m128i Chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Ptr));
+    const __m128i Found = _mm_or_si128(_mm_cmpeq_epi8(Chunk, Mask1), _mm_cmpeq_epi8(Chunk, Mask2));
+    if (_mm_movemask_epi8(Found) != 0)
+    {
+      break;
+    }
+    Ptr += 16;
+  }
+#endif
+  while ((Ptr < End) && (*Ptr != C1) && (*Ptr != C2))
+  {
+    ++Ptr;
+  }
+  return Ptr;
+}
+
+// Converts in a single pass. Runs between EOL chars are copied as a whole,
+// and the converted data goes to a separate buffer when it can grow
+// (one char source EOL to two char destination EOL), otherwise it is
+// compacted in place. The BOM and the trailing ^Z are skipped rather
+// than deleted upfront.
 void TFileBuffer::Convert(char * Source, char * Dest, intptr_t Params,
   bool & Token)
 {
   DebugAssert(NBChTraitsCRT<char>::SafeStringLen(Source) <= 2);
   DebugAssert(NBChTraitsCRT<char>::SafeStringLen(Dest) <= 2);
 
+  char * Data = GetData();
+  const char * Ptr = Data;
+  const char * End = Data + GetSize();
+
   const std::string Bom(CONST_BOM);
-  if (FLAGSET(Params, cpRemoveBOM) && (GetSize() >= 3) &&
-      (memcmp(GetData(), Bom.c_str(), Bom.size()) == 0))
+  if (FLAGSET(Params, cpRemoveBOM) && (End - Ptr >= 3) &&
+      (memcmp(Ptr, Bom.c_str(), Bom.size()) == 0))
   {
-    Delete(0, 3);
+    Ptr += 3;
   }
 
-  if (FLAGSET(Params, cpRemoveCtrlZ) && (GetSize() > 0) && ((*(GetData() + GetSize() - 1)) == '\x1A'))
+  if (FLAGSET(Params, cpRemoveCtrlZ) && (End > Ptr) && (*(End - 1) == '\x1A'))
   {
-    Delete(GetSize() - 1, 1);
+    End--;
   }
 
   if (strcmp(Source, Dest) == 0)
   {
+    if (Ptr > Data)
+    {
+      memmove(Data, Ptr, static_cast<size_t>(End - Ptr));
+    }
+    SetSize(End - Ptr);
     return;
   }
 
-  char * Ptr = GetData();
+  std::unique_ptr<TMemoryStream> Converted;
+  char * Out = Data;
+  if (!Source[1] && Dest[1])
+  {
+    Converted.reset(new TMemoryStream());
+    Converted->SetSize((End - Ptr) * 2);
+    Out = static_cast<char *>(Converted->GetMemory());
+  }
+  char * const OutStart = Out;
 
   // one character source EOL
   if (!Source[1])
@@ -130,71 +183,106 @@ void TFileBuffer::Convert(char * Source, char * Dest, intptr_t Params,
     bool PrevToken = Token;
     Token = false;
 
-    for (intptr_t Index = 0; Index < GetSize(); ++Index)
+    // last buffer ended with the first char of destination 2-char EOL format,
+    // which got expanded to full destination format.
+    // now we got the second char, so get rid of it.
+    if (PrevToken && (Ptr < End) && (*Ptr == Dest[1]))
     {
-      // EOL already in destination format, make sure to pass it unmodified
-      if ((Index < GetSize() - 1) && (*Ptr == Dest[0]) && (*(Ptr + 1) == Dest[1]))
+      ++Ptr;
+    }
+
+    while (Ptr < End)
+    {
+      const char * Next = FindEOLChar(Ptr, End, Source[0], Dest[0]);
+      if (Out != Ptr)
       {
-        ++Index;
-        Ptr++;
+        memmove(Out, Ptr, static_cast<size_t>(Next - Ptr));
       }
-      // last buffer ended with the first char of destination 2-char EOL format,
-      // which got expanded to full destination format.
-      // now we got the second char, so get rid of it.
-      else if ((Index == 0) && PrevToken && (*Ptr == Dest[1]))
+      Out += Next - Ptr;
+      Ptr = Next;
+      if (Ptr == End)
+      {
+        break;
+      }
+
+      // EOL already in destination format, make sure to pass it unmodified
+      if ((End - Ptr >= 2) && (*Ptr == Dest[0]) && (*(Ptr + 1) == Dest[1]))
       {
-        Delete(Index, 1);
+        *Out++ = *Ptr++;
+        *Out++ = *Ptr++;
       }
       // we are ending with the first char of destination 2-char EOL format,
       // append the second char and make sure we strip it from the next buffer, if any
-      else if ((*Ptr == Dest[0]) && (Index == GetSize() - 1) && Dest[1])
+      else if ((*Ptr == Dest[0]) && (Ptr == End - 1) && Dest[1])
       {
         Token = true;
-        Insert(Index + 1, Dest + 1, 1);
-        ++Index;
-        Ptr = GetData() + Index;
+        *Out++ = *Ptr++;
+        *Out++ = Dest[1];
       }
       else if (*Ptr == Source[0])
       {
-        *Ptr = Dest[0];
+        *Out++ = Dest[0];
         if (Dest[1])
         {
-          Insert(Index + 1, Dest + 1, 1);
-          ++Index;
-          Ptr = GetData() + Index;
+          *Out++ = Dest[1];
         }
+        ++Ptr;
+      }
+      else
+      {
+        *Out++ = *Ptr++;
       }
-      Ptr++;
     }
   }
   // two character source EOL
   else
   {
-    intptr_t Index;
-    for (Index = 0; Index < GetSize() - 1; ++Index)
+    while (Ptr < End)
     {
-      if ((*Ptr == Source[0]) && (*(Ptr + 1) == Source[1]))
+      const char * Next = FindEOLChar(Ptr, End, Source[0], Source[0]);
+      if (Out != Ptr)
       {
-        *Ptr = Dest[0];
+        memmove(Out, Ptr, static_cast<size_t>(Next - Ptr));
+      }
+      Out += Next - Ptr;
+      Ptr = Next;
+      if (Ptr == End)
+      {
+        break;
+      }
+
+      if ((End - Ptr >= 2) && (*(Ptr + 1) == Source[1]))
+      {
+        *Out++ = Dest[0];
         if (Dest[1])
         {
-          *(Ptr + 1) = Dest[1];
-          ++Index;
-          ++Ptr;
-        }
-        else
-        {
-          Delete(Index + 1, 1);
-          Ptr = GetData() + Index;
+          *Out++ = Dest[1];
         }
+        Ptr += 2;
+      }
+      // incomplete EOL at the very end is dropped
+      else if (Ptr == End - 1)
+      {
+        ++Ptr;
+      }
+      else
+      {
+        *Out++ = *Ptr++;
       }
-      Ptr++;
-    }
-    if ((Index < GetSize()) && (*Ptr == Source[0]))
-    {
-      Delete(Index, 1);
     }
   }
+
+  const int64_t NewSize = Out - OutStart;
+  if (Converted.get() != nullptr)
+  {
+    Converted->SetSize(NewSize);
+    Converted->SetPosition(Min(GetPosition(), NewSize));
+    SetMemory(Converted.release());
+  }
+  else
+  {
+    SetSize(NewSize);
+  }
 }
 
 void TFileBuffer::Convert(TEOLType Source, TEOLType Dest, intptr_t Params,
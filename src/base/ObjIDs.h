@@ -85,6 +85,7 @@ enum TObjectClassId
   OBJECT_CLASS_TTunnelThread,
   OBJECT_CLASS_TSignalThread,
   OBJECT_CLASS_TTerminalThread,
+  OBJECT_CLASS_TLocalDirectoryScanThread,
   OBJECT_CLASS_TTerminalQueue,
   OBJECT_CLASS_TTerminalItem,
   OBJECT_CLASS_TQueueItem,
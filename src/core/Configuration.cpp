@@ -65,9 +65,12 @@ TConfiguration::TConfiguration(TObjectClassId Kind) :
   FTunnelLocalPortNumberLow(0),
   FTunnelLocalPortNumberHigh(0),
   FCacheDirectoryChangesMaxSize(0),
+  FCacheDirectoriesMaxSize(0),
   FShowFtpWelcomeMessage(false),
   FTryFtpWhenSshFails(false),
   FParallelDurationThreshold(0),
+  FParallelTransferThreshold(0),
+  FScpTransferBlockSize(0),
   FScripting(false),
   FSessionReopenAutoMaximumNumberOfRetries(0),
   FDisablePasswordStoring(false),
@@ -140,10 +143,14 @@ void TConfiguration::Default()
   FTunnelLocalPortNumberLow = 50000;
   FTunnelLocalPortNumberHigh = 50099;
   FCacheDirectoryChangesMaxSize = 100;
+  FCacheDirectoriesMaxSize = 128;
   FShowFtpWelcomeMessage = false;
   FExternalIpAddress.Clear();
   FTryFtpWhenSshFails = true;
   FParallelDurationThreshold = 10;
+  // files at least this large are downloaded in segments over all parallel connections, 0 = never
+  FParallelTransferThreshold = 100 * 1024 * 1024;
+  FScpTransferBlockSize = 256 * 1024;
   SetCollectUsage(FDefaultCollectUsage);
   FSessionReopenAutoMaximumNumberOfRetries = CONST_DEFAULT_NUMBER_OF_RETRIES;
 
@@ -281,10 +288,13 @@ UnicodeString TConfiguration::PropertyToKey(UnicodeString Property)
     KEY(Integer,  TunnelLocalPortNumberLow); \
     KEY(Integer,  TunnelLocalPortNumberHigh); \
     KEY(Integer,  CacheDirectoryChangesMaxSize); \
+    KEY(Integer,  CacheDirectoriesMaxSize); \
     KEY(Bool,     ShowFtpWelcomeMessage); \
     KEY(String,   ExternalIpAddress); \
     KEY(Bool,     TryFtpWhenSshFails); \
     KEY(Integer,  ParallelDurationThreshold); \
+    KEY(Int64,    ParallelTransferThreshold); \
+    KEY(Integer,  ScpTransferBlockSize); \
     KEY(Bool,     CollectUsage); \
     KEY(Integer,  SessionReopenAutoMaximumNumberOfRetries); \
   ); \
@@ -1580,6 +1590,16 @@ void TConfiguration::SetParallelDurationThreshold(intptr_t Value)
   SET_CONFIG_PROPERTY(ParallelDurationThreshold);
 }
 
+void TConfiguration::SetParallelTransferThreshold(int64_t Value)
+{
+  SET_CONFIG_PROPERTY(ParallelTransferThreshold);
+}
+
+void TConfiguration::SetScpTransferBlockSize(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(ScpTransferBlockSize);
+}
+
 void TConfiguration::SetPuttyRegistryStorageKey(UnicodeString Value)
 {
   SET_CONFIG_PROPERTY(PuttyRegistryStorageKey);
@@ -1883,6 +1903,11 @@ void TConfiguration::SetCacheDirectoryChangesMaxSize(intptr_t Value)
   SET_CONFIG_PROPERTY(CacheDirectoryChangesMaxSize);
 }
 
+void TConfiguration::SetCacheDirectoriesMaxSize(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(CacheDirectoriesMaxSize);
+}
+
 void TConfiguration::SetShowFtpWelcomeMessage(bool Value)
 {
   SET_CONFIG_PROPERTY(ShowFtpWelcomeMessage);
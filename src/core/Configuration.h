@@ -75,6 +75,7 @@ private:
   intptr_t FTunnelLocalPortNumberLow;
   intptr_t FTunnelLocalPortNumberHigh;
   intptr_t FCacheDirectoryChangesMaxSize;
+  intptr_t FCacheDirectoriesMaxSize;
   bool FShowFtpWelcomeMessage;
   UnicodeString FDefaultRandomSeedFile;
   UnicodeString FRandomSeedFile;
@@ -82,6 +83,8 @@ private:
   UnicodeString FExternalIpAddress;
   bool FTryFtpWhenSshFails;
   intptr_t FParallelDurationThreshold;
+  int64_t FParallelTransferThreshold;
+  intptr_t FScpTransferBlockSize;
   bool FScripting;
   intptr_t FSessionReopenAutoMaximumNumberOfRetries;
 
@@ -145,12 +148,15 @@ public:
   void SetTunnelLocalPortNumberLow(intptr_t Value);
   void SetTunnelLocalPortNumberHigh(intptr_t Value);
   void SetCacheDirectoryChangesMaxSize(intptr_t Value);
+  void SetCacheDirectoriesMaxSize(intptr_t Value);
   void SetShowFtpWelcomeMessage(bool Value);
   intptr_t GetCompoundVersion() const;
   void UpdateActualLogProtocol();
   void SetExternalIpAddress(UnicodeString Value);
   void SetTryFtpWhenSshFails(bool Value);
   void SetParallelDurationThreshold(intptr_t Value);
+  void SetParallelTransferThreshold(int64_t Value);
+  void SetScpTransferBlockSize(intptr_t Value);
   bool GetCollectUsage() const;
   void SetCollectUsage(bool Value);
   bool GetIsUnofficial() const;
@@ -313,10 +319,13 @@ public:
   __property intptr_t TunnelLocalPortNumberLow = { read = FTunnelLocalPortNumberLow, write = SetTunnelLocalPortNumberLow };
   __property intptr_t TunnelLocalPortNumberHigh = { read = FTunnelLocalPortNumberHigh, write = SetTunnelLocalPortNumberHigh };
   __property intptr_t CacheDirectoryChangesMaxSize = { read = FCacheDirectoryChangesMaxSize, write = SetCacheDirectoryChangesMaxSize };
+  __property intptr_t CacheDirectoriesMaxSize = { read = FCacheDirectoriesMaxSize, write = SetCacheDirectoriesMaxSize };
   __property bool ShowFtpWelcomeMessage = { read = FShowFtpWelcomeMessage, write = SetShowFtpWelcomeMessage };
   __property UnicodeString ExternalIpAddress = { read = FExternalIpAddress, write = SetExternalIpAddress };
   __property bool TryFtpWhenSshFails = { read = FTryFtpWhenSshFails, write = SetTryFtpWhenSshFails };
   __property intptr_t ParallelDurationThreshold = { read = FParallelDurationThreshold, write = SetParallelDurationThreshold };
+  __property int64_t ParallelTransferThreshold = { read = FParallelTransferThreshold, write = SetParallelTransferThreshold };
+  __property intptr_t ScpTransferBlockSize = { read = FScpTransferBlockSize, write = SetScpTransferBlockSize };
 
   __property UnicodeString TimeFormat = { read = GetTimeFormat };
   __property TStorage Storage  = { read=GetStorage };
@@ -353,10 +362,14 @@ public:
   intptr_t GetTunnelLocalPortNumberLow() const { return FTunnelLocalPortNumberLow; }
   intptr_t GetTunnelLocalPortNumberHigh() const { return FTunnelLocalPortNumberHigh; }
   intptr_t GetCacheDirectoryChangesMaxSize() const { return FCacheDirectoryChangesMaxSize; }
+  // in MB, 0 = unlimited
+  intptr_t GetCacheDirectoriesMaxSize() const { return FCacheDirectoriesMaxSize; }
   bool GetShowFtpWelcomeMessage() const { return FShowFtpWelcomeMessage; }
   UnicodeString GetExternalIpAddress() const { return FExternalIpAddress; }
   bool GetTryFtpWhenSshFails() const { return FTryFtpWhenSshFails; }
   intptr_t GetParallelDurationThreshold() const { return FParallelDurationThreshold; }
+  int64_t GetParallelTransferThreshold() const { return FParallelTransferThreshold; }
+  intptr_t GetScpTransferBlockSize() const { return FScpTransferBlockSize; }
   bool GetDisablePasswordStoring() const { return FDisablePasswordStoring; }
   bool GetForceBanners() const { return FForceBanners; }
   bool GetDisableAcceptingHostKeys() const { return FDisableAcceptingHostKeys; }
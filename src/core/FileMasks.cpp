@@ -3,6 +3,8 @@
 
 #include <Common.h>
 #include <StrUtils.hpp>
+#include <nbutils.h>
+#include <rdestl/hash_map.h>
 
 #include "FileMasks.h"
 
@@ -258,6 +260,7 @@ void TFileMasks::Init()
   for (intptr_t Index = 0; Index < 4; ++Index)
   {
     FMasksStr[Index] = nullptr;
+    FMasksLookup[Index] = nullptr;
   }
 
   DoInit(false);
@@ -282,6 +285,7 @@ void TFileMasks::Clear()
   for (intptr_t Index = 0; Index < 4; ++Index)
   {
     Clear(FMasks[Index]);
+    SAFE_DESTROY(FMasksLookup[Index]);
   }
 }
 
@@ -297,96 +301,232 @@ void TFileMasks::Clear(TMasks &Masks)
   Masks.clear();
 }
 
-bool TFileMasks::MatchesMasks(const UnicodeString AFileName, bool Directory,
-  const UnicodeString APath, const TParams *Params, const TMasks &Masks, bool Recurse)
+// Masks indexed by their lookup keys. Lookup only preselects masks,
+// each of them is still fully matched, so that the result is always the same
+// as when trying all masks one by one.
+struct TFileMasks::TMasksLookup : public TObject
 {
-  bool Result = false;
+  CUSTOM_MEM_ALLOCATION_IMPL
+public:
+  typedef rde::vector<size_t> TIndexes;
+  typedef rde::hash_map<UnicodeString, TIndexes, TNameHash> TIndex;
+
+  TIndex Names;
+  TIndex Exts;
+  // all extension masks, for extensions that are not plain ASCII
+  TIndexes ExtMasks;
+  // masks that cannot be looked up
+  TIndexes Others;
+};
+
+// The same upper-casing as used by Masks::CmpName
+static UnicodeString UpperMaskKey(const wchar_t *Str, intptr_t Length)
+{
+  UnicodeString Result(Str, Length);
+  for (intptr_t Index = 1; Index <= Length; ++Index)
+  {
+    Result[Index] = nb::Upper(Result[Index]);
+  }
+  return Result;
+}
+
+static bool IsAsciiMaskKey(const wchar_t *Str)
+{
+  for (; *Str != L'\0'; ++Str)
+  {
+    if (*Str >= 0x80)
+    {
+      return false;
+    }
+  }
+  return true;
+}
 
-  TMasks::const_iterator it = Masks.begin();
-  while (!Result && (it != Masks.end()))
+void TFileMasks::Compile()
+{
+  for (intptr_t Index = 0; Index < 4; ++Index)
   {
-    const TMask &Mask = *it;
-    Result =
-      MatchesMaskMask(Mask.DirectoryMask, APath) &&
-      MatchesMaskMask(Mask.FileNameMask, AFileName);
+    DebugAssert(FMasksLookup[Index] == nullptr);
+    TMasksLookup *Lookup = new TMasksLookup();
+    FMasksLookup[Index] = Lookup;
+    const TMasks &Masks = FMasks[Index];
+    for (size_t MaskIndex = 0; MaskIndex < Masks.size(); ++MaskIndex)
+    {
+      const TMaskMask &FileNameMask = Masks[MaskIndex].FileNameMask;
+      switch (FileNameMask.Lookup)
+      {
+      case TMaskMask::NameLookup:
+        {
+          const UnicodeString &Key = FileNameMask.LookupKey;
+          Lookup->Names[Key].push_back(MaskIndex);
+          if ((Key.Length() > 1) && (Key[Key.Length()] == L'.'))
+          {
+            Lookup->Names[Key.SubString(1, Key.Length() - 1)].push_back(MaskIndex);
+          }
+        }
+        break;
+
+      case TMaskMask::ExtLookup:
+        Lookup->Exts[FileNameMask.LookupKey].push_back(MaskIndex);
+        Lookup->ExtMasks.push_back(MaskIndex);
+        break;
+
+      default:
+        Lookup->Others.push_back(MaskIndex);
+        break;
+      }
+    }
+  }
+}
+
+bool TFileMasks::MatchesMask(const TMask &Mask, const UnicodeString AFileName,
+  const UnicodeString APath, const TParams *Params)
+{
+  bool Result =
+    MatchesMaskMask(Mask.DirectoryMask, APath) &&
+    MatchesMaskMask(Mask.FileNameMask, AFileName);
+
+  if (Result)
+  {
+    bool HasSize = (Params != nullptr);
+
+    switch (Mask.HighSizeMask)
+    {
+    case TMask::None:
+      Result = true;
+      break;
+
+    case TMask::Open:
+      Result = HasSize && (Params->Size < Mask.HighSize);
+      break;
+
+    case TMask::Close:
+      Result = HasSize && (Params->Size <= Mask.HighSize);
+      break;
+    }
 
     if (Result)
     {
-      bool HasSize = (Params != nullptr);
+      switch (Mask.LowSizeMask)
+      {
+      case TMask::None:
+        Result = true;
+        break;
+
+      case TMask::Open:
+        Result = HasSize && (Params->Size > Mask.LowSize);
+        break;
 
-      switch (Mask.HighSizeMask)
+      case TMask::Close:
+        Result = HasSize && (Params->Size >= Mask.LowSize); //-V595
+        break;
+      }
+    }
+
+    bool HasModification = (Params != nullptr);
+
+    if (Result)
+    {
+      switch (Mask.HighModificationMask)
       {
       case TMask::None:
         Result = true;
         break;
 
       case TMask::Open:
-        Result = HasSize && (Params->Size < Mask.HighSize);
+        Result = HasModification && (Params->Modification < Mask.HighModification);
         break;
 
       case TMask::Close:
-        Result = HasSize && (Params->Size <= Mask.HighSize);
+        Result = HasModification && (Params->Modification <= Mask.HighModification);
         break;
       }
+    }
 
-      if (Result)
+    if (Result)
+    {
+      switch (Mask.LowModificationMask)
       {
-        switch (Mask.LowSizeMask)
-        {
-        case TMask::None:
-          Result = true;
-          break;
+      case TMask::None:
+        Result = true;
+        break;
 
-        case TMask::Open:
-          Result = HasSize && (Params->Size > Mask.LowSize);
-          break;
+      case TMask::Open:
+        Result = HasModification && (Params->Modification > Mask.LowModification);
+        break;
 
-        case TMask::Close:
-          Result = HasSize && (Params->Size >= Mask.LowSize); //-V595
-          break;
-        }
+      case TMask::Close:
+        Result = HasModification && (Params->Modification >= Mask.LowModification);
+        break;
       }
+    }
+  }
 
-      bool HasModification = (Params != nullptr);
+  return Result;
+}
 
-      if (Result)
-      {
-        switch (Mask.HighModificationMask)
-        {
-        case TMask::None:
-          Result = true;
-          break;
+bool TFileMasks::MatchesMasks(const UnicodeString AFileName, bool Directory,
+  const UnicodeString APath, const TParams *Params, const TMasks &Masks,
+  const TMasksLookup *Lookup, bool Recurse)
+{
+  bool Result = false;
 
-        case TMask::Open:
-          Result = HasModification && (Params->Modification < Mask.HighModification);
-          break;
+  if (Lookup == nullptr)
+  {
+    TMasks::const_iterator it = Masks.begin();
+    while (!Result && (it != Masks.end()))
+    {
+      Result = MatchesMask(*it, AFileName, APath, Params);
+      ++it;
+    }
+  }
+  else if (!Masks.empty())
+  {
+    UnicodeString Key = UpperMaskKey(AFileName.c_str(), AFileName.Length());
 
-        case TMask::Close:
-          Result = HasModification && (Params->Modification <= Mask.HighModification);
-          break;
-        }
+    TMasksLookup::TIndex::const_iterator Name = Lookup->Names.find(Key);
+    if (Name != Lookup->Names.end())
+    {
+      const TMasksLookup::TIndexes &Indexes = Name->second;
+      for (size_t Index = 0; !Result && (Index < Indexes.size()); ++Index)
+      {
+        Result = MatchesMask(Masks[Indexes[Index]], AFileName, APath, Params);
       }
+    }
 
-      if (Result)
+    if (!Result && !Lookup->ExtMasks.empty())
+    {
+      const wchar_t *Dot = wcsrchr(AFileName.c_str(), L'.');
+      if (Dot != nullptr)
       {
-        switch (Mask.LowModificationMask)
+        const TMasksLookup::TIndexes *Indexes = nullptr;
+        if (IsAsciiMaskKey(Dot + 1))
         {
-        case TMask::None:
-          Result = true;
-          break;
-
-        case TMask::Open:
-          Result = HasModification && (Params->Modification > Mask.LowModification);
-          break;
+          intptr_t ExtStart = Dot - AFileName.c_str() + 1;
+          UnicodeString ExtKey(Key.c_str() + ExtStart, Key.Length() - ExtStart);
+          TMasksLookup::TIndex::const_iterator Ext = Lookup->Exts.find(ExtKey);
+          if (Ext != Lookup->Exts.end())
+          {
+            Indexes = &Ext->second;
+          }
+        }
+        else
+        {
+          Indexes = &Lookup->ExtMasks;
+        }
 
-        case TMask::Close:
-          Result = HasModification && (Params->Modification >= Mask.LowModification);
-          break;
+        for (size_t Index = 0; !Result && (Indexes != nullptr) && (Index < Indexes->size()); ++Index)
+        {
+          Result = MatchesMask(Masks[(*Indexes)[Index]], AFileName, APath, Params);
         }
       }
     }
 
-    ++it;
+    const TMasksLookup::TIndexes &Others = Lookup->Others;
+    for (size_t Index = 0; !Result && (Index < Others.size()); ++Index)
+    {
+      Result = MatchesMask(Masks[Others[Index]], AFileName, APath, Params);
+    }
   }
 
   if (!Result && Directory && !base::IsUnixRootPath(APath) && Recurse)
@@ -397,7 +537,7 @@ bool TFileMasks::MatchesMasks(const UnicodeString AFileName, bool Directory,
     // Currently it includes Size/Time only, what is not used for directories.
     // So it depends on future use. Possibly we should make a copy
     // and pass on only relevant fields.
-    Result = MatchesMasks(ParentFileName, true, ParentPath, Params, Masks, Recurse);
+    Result = MatchesMasks(ParentFileName, true, ParentPath, Params, Masks, Lookup, Recurse);
   }
 
   return Result;
@@ -415,10 +555,13 @@ bool TFileMasks::Matches(const UnicodeString AFileName, bool Directory,
   bool RecurseInclude, bool &ImplicitMatch) const
 {
   bool ImplicitIncludeMatch = FMasks[MASK_INDEX(Directory, true)].empty();
-  bool ExplicitIncludeMatch = MatchesMasks(AFileName, Directory, APath, Params, FMasks[MASK_INDEX(Directory, true)], RecurseInclude);
+  bool ExplicitIncludeMatch =
+    MatchesMasks(AFileName, Directory, APath, Params, FMasks[MASK_INDEX(Directory, true)],
+      FMasksLookup[MASK_INDEX(Directory, true)], RecurseInclude);
   bool Result =
     (ImplicitIncludeMatch || ExplicitIncludeMatch) &&
-    !MatchesMasks(AFileName, Directory, APath, Params, FMasks[MASK_INDEX(Directory, false)], false);
+    !MatchesMasks(AFileName, Directory, APath, Params, FMasks[MASK_INDEX(Directory, false)],
+      FMasksLookup[MASK_INDEX(Directory, false)], false);
   ImplicitMatch =
     Result && ImplicitIncludeMatch && !ExplicitIncludeMatch &&
     FMasks[MASK_INDEX(Directory, false)].empty();
@@ -500,6 +643,27 @@ void TFileMasks::CreateMaskMask(UnicodeString Mask, intptr_t Start, intptr_t End
     {
       MaskMask.Kind = (Ex && (Mask == L"*.")) ? TMaskMask::NoExt : TMaskMask::Regular;
       MaskMask.Mask = new Masks::TMask(Mask);
+      if (Ex && (MaskMask.Kind == TMaskMask::Regular))
+      {
+        const wchar_t *Wildcards = L"*?[";
+        // Masks::CmpName matches plain name case-insensitively,
+        // "name." matches also "name" without the dot
+        if (wcspbrk(Mask.c_str(), Wildcards) == nullptr)
+        {
+          MaskMask.Lookup = TMaskMask::NameLookup;
+          MaskMask.LookupKey = UpperMaskKey(Mask.c_str(), Mask.Length());
+        }
+        // "*.ext" matches extension after the last dot, compared by CompareString,
+        // what is the same as upper-casing for ASCII only
+        else if ((Mask.Length() > 2) && (Mask[1] == L'*') && (Mask[2] == L'.') &&
+          (wcspbrk(Mask.c_str() + 2, Wildcards) == nullptr) &&
+          (wcschr(Mask.c_str() + 2, L'.') == nullptr) &&
+          IsAsciiMaskKey(Mask.c_str() + 2))
+        {
+          MaskMask.Lookup = TMaskMask::ExtLookup;
+          MaskMask.LookupKey = UpperMaskKey(Mask.c_str() + 2, Mask.Length() - 2);
+        }
+      }
     }
   }
   catch (...)
@@ -766,6 +930,8 @@ void TFileMasks::SetStr(const UnicodeString Str, bool SingleMask)
         }
       }
     }
+
+    Compile();
   }
   catch (...)
   {
@@ -83,7 +83,8 @@ private:
   {
     TMaskMask() :
       Kind(Any),
-      Mask(nullptr)
+      Mask(nullptr),
+      Lookup(NoLookup)
     {
     }
     enum
@@ -93,6 +94,15 @@ private:
       Regular,
     } Kind;
     Masks::TMask *Mask;
+    // Plain file name and "*.ext" masks can be looked up by upper-cased
+    // name or extension, instead of being tried one by one
+    enum
+    {
+      NoLookup,
+      NameLookup,
+      ExtLookup,
+    } Lookup;
+    UnicodeString LookupKey;
   };
 
   struct TMask : public TObject
@@ -133,6 +143,8 @@ private:
   typedef rde::vector<TMask> TMasks;
   TMasks FMasks[4];
   mutable TStrings *FMasksStr[4];
+  struct TMasksLookup;
+  TMasksLookup *FMasksLookup[4];
 
 private:
   void SetStr(const UnicodeString Str, bool SingleMask);
@@ -148,9 +160,13 @@ private:
   void DoInit(bool Delete);
   void Clear();
   static void Clear(TMasks &Masks);
+  void Compile();
   static void TrimEx(UnicodeString &Str, intptr_t &Start, intptr_t &End);
   static bool MatchesMasks(const UnicodeString AFileName, bool Directory,
-    const UnicodeString APath, const TParams *Params, const TMasks &Masks, bool Recurse);
+    const UnicodeString APath, const TParams *Params, const TMasks &Masks,
+    const TMasksLookup *Lookup, bool Recurse);
+  static bool MatchesMask(const TMask &Mask, const UnicodeString AFileName,
+    const UnicodeString APath, const TParams *Params);
   static inline bool MatchesMaskMask(const TMaskMask &MaskMask, UnicodeString Str);
   void ThrowError(intptr_t Start, intptr_t End) const;
 };
@@ -87,10 +87,9 @@ void TFileOperationProgressType::Clear()
   FFileStartTime = 0.0;
   FFilesFinished = 0;
   FReset = false;
-  FLastSecond = 0;
+  FLastRefill = 0;
   FRemainingCPS = 0;
-  FTicks.clear();
-  FTotalTransferredThen.clear();
+  ClearCPSSamples();
   FCounterSet = false;
   FOperation = foNone;
   FSide = osLocal;
@@ -106,8 +105,7 @@ void TFileOperationProgressType::Clear()
   // to bypass check in ClearTransfer()
   FTransferSize = 0;
   FCPSLimit = 0;
-  FTicks.clear();
-  FTotalTransferredThen.clear();
+  ClearCPSSamples();
   FCounterSet = false;
   ClearTransfer();
   FTransferredSize = 0;
@@ -134,7 +132,7 @@ void TFileOperationProgressType::ClearTransfer()
   FSkippedSize = 0;
   FTransferredSize = 0;
   FTransferringFile = false;
-  FLastSecond = 0;
+  FLastRefill = 0;
 }
 
 void TFileOperationProgressType::Start(TFileOperation AOperation,
@@ -215,11 +213,9 @@ void TFileOperationProgressType::Resume()
     // shift timestamps for CPS calculation in advance
     // by the time the progress was suspended
     intptr_t Stopped = static_cast<intptr_t>(::GetTickCount() - FSuspendTime);
-    size_t Index = 0;
-    while (Index < FTicks.size())
+    for (intptr_t Index = 0; Index < FTicksCount; ++Index)
     {
-      FTicks[Index] += Stopped;
-      ++Index;
+      FTicks[(FTicksStart + Index) % CPSWindow] += Stopped;
     }
   }
 
@@ -365,6 +361,27 @@ void TFileOperationProgressType::ThrottleToCPSLimit(
   }
 }
 
+void TFileOperationProgressType::RefillCPSTokens()
+{
+  uintptr_t Ticks = ::GetTickCount();
+  if ((FLastRefill == 0) || (Ticks < FLastRefill)) // ticks wrap after 49.7 days
+  {
+    FRemainingCPS = FCPSLimit;
+    FLastRefill = Ticks;
+  }
+  else
+  {
+    int64_t Tokens = static_cast<int64_t>(Ticks - FLastRefill) * FCPSLimit / MSecsPerSec;
+    // keep the time, until at least one token is added, not to lose it
+    if (Tokens > 0)
+    {
+      // the bucket holds one second worth of data at most
+      FRemainingCPS = static_cast<intptr_t>(Min(FRemainingCPS + Tokens, static_cast<int64_t>(FCPSLimit)));
+      FLastRefill = Ticks;
+    }
+  }
+}
+
 intptr_t TFileOperationProgressType::AdjustToCPSLimit(
   intptr_t Size)
 {
@@ -373,25 +390,22 @@ intptr_t TFileOperationProgressType::AdjustToCPSLimit(
   // CPSLimit reader is guarded, we cannot block whole method as it can last long.
   if (FCPSLimit > 0)
   {
-    // we must not return 0, hence, if we reach zero,
-    // we wait until the next second
-    do
+    // we must not return 0, hence, if the bucket is (nearly) empty,
+    // we wait just until it refills enough, so that we do not send tiny blocks
+    RefillCPSTokens();
+    intptr_t Needed = Min(Size, Max(FCPSLimit / 10, static_cast<intptr_t>(1)));
+    while ((FCPSLimit > 0) && (FRemainingCPS < Needed))
     {
-      uintptr_t Second = (::GetTickCount() / MSecsPerSec);
-
-      if (Second != FLastSecond)
-      {
-        FRemainingCPS = FCPSLimit;
-        FLastSecond = Second;
-      }
-
-      if (FRemainingCPS == 0)
+      int64_t Wait = static_cast<int64_t>(Needed - FRemainingCPS) * MSecsPerSec / FCPSLimit;
+      // still wake up regularly to keep progress updated and to notice changed limit
+      SleepEx(static_cast<DWORD>(Max(Min(Wait, static_cast<int64_t>(100)), static_cast<int64_t>(1))), true);
+      DoProgress();
+      if (FCPSLimit > 0)
       {
-        SleepEx(100, true);
-        DoProgress();
+        RefillCPSTokens();
+        Needed = Min(Size, Max(FCPSLimit / 10, static_cast<intptr_t>(1)));
       }
     }
-    while ((FCPSLimit > 0) && (FRemainingCPS == 0));
 
     // CPSLimit may have been dropped in DoProgress
     if (FCPSLimit > 0)
@@ -408,9 +422,9 @@ intptr_t TFileOperationProgressType::AdjustToCPSLimit(
 }
 
 // Use in SCP protocol only
-uintptr_t TFileOperationProgressType::LocalBlockSize()
+uintptr_t TFileOperationProgressType::LocalBlockSize(uintptr_t BlockSize)
 {
-  uintptr_t Result = TRANSFER_BUF_SIZE;
+  uintptr_t Result = BlockSize;
   if (FLocallyUsed + static_cast<int64_t>(Result) > FLocalSize)
   {
     Result = static_cast<uintptr_t>(FLocalSize - FLocallyUsed);
@@ -621,9 +635,8 @@ void TFileOperationProgressType::RollbackTransferFromTotals(int64_t ATransferred
 
   DebugAssert(ATransferredSize <= FTotalTransferred);
   DebugAssert(ASkippedSize <= FTotalSkipped);
-  FTotalTransferred -= ATransferredSize;
-  FTicks.clear();
-  FTotalTransferredThen.clear();
+  ::InterlockedExchangeAdd64(&FTotalTransferred, -ATransferredSize);
+  ClearCPSSamples();
   FTotalSkipped -= ASkippedSize;
 
   if (FParent != nullptr)
@@ -642,24 +655,41 @@ void TFileOperationProgressType::RollbackTransfer()
   FLocallyUsed = 0;
 }
 
-void TFileOperationProgressType::AddTransferredToTotals(int64_t ASize)
+void TFileOperationProgressType::ClearCPSSamples()
 {
-  TGuard Guard(*FSection);
+  FTicksStart = 0;
+  FTicksCount = 0;
+}
 
-  FTotalTransferred += ASize;
+void TFileOperationProgressType::AddTransferredToTotals(int64_t ASize)
+{
+  // This is called for every block, possibly from several parallel transfers
+  // sharing the same parent, so the total is added without locking.
+  // Only taking a new CPS sample (once a second) needs the lock.
+  int64_t TotalTransferred = ::InterlockedExchangeAdd64(&FTotalTransferred, ASize) + ASize;
   intptr_t Ticks = static_cast<intptr_t>(::GetTickCount());
-  if (FTicks.empty() ||
-    (FTicks.back() > Ticks) || // ticks wrap after 49.7 days
-    ((Ticks - FTicks.back()) >= MSecsPerSec))
-  {
-    FTicks.push_back(Ticks);
-    FTotalTransferredThen.push_back(FTotalTransferred);
-  }
-
-  if (FTicks.size() > 10)
+  intptr_t LastTicks = (FTicksCount > 0) ? FTicks[(FTicksStart + FTicksCount - 1) % CPSWindow] : 0;
+  if ((FTicksCount == 0) ||
+      (LastTicks > Ticks) || // ticks wrap after 49.7 days
+      ((Ticks - LastTicks) >= MSecsPerSec))
   {
-    FTicks.erase(FTicks.begin());
-    FTotalTransferredThen.erase(FTotalTransferredThen.begin());
+    TGuard Guard(*FSection);
+    // other thread may have taken the sample meanwhile
+    intptr_t Last = (FTicksStart + FTicksCount - 1) % CPSWindow;
+    if ((FTicksCount == 0) ||
+      (FTicks[Last] > Ticks) ||
+      ((Ticks - FTicks[Last]) >= MSecsPerSec))
+    {
+      if (FTicksCount == CPSWindow)
+      {
+        FTicksStart = (FTicksStart + 1) % CPSWindow;
+        FTicksCount--;
+      }
+      intptr_t Index = (FTicksStart + FTicksCount) % CPSWindow;
+      FTicks[Index] = Ticks;
+      FTotalTransferredThen[Index] = TotalTransferred;
+      FTicksCount++;
+    }
   }
 
   if (FParent != nullptr)
@@ -731,9 +761,9 @@ void TFileOperationProgressType::AddSkippedFileSize(int64_t ASize)
 }
 
 // Use in SCP protocol only
-uintptr_t TFileOperationProgressType::TransferBlockSize()
+uintptr_t TFileOperationProgressType::TransferBlockSize(uintptr_t BlockSize)
 {
-  uintptr_t Result = TRANSFER_BUF_SIZE;
+  uintptr_t Result = BlockSize;
   if (FTransferredSize + static_cast<int64_t>(Result) > FTransferSize)
   {
     Result = static_cast<uintptr_t>(FTransferSize - FTransferredSize);
@@ -774,7 +804,7 @@ uintptr_t TFileOperationProgressType::CPS() const
 uintptr_t TFileOperationProgressType::GetCPS() const
 {
   uintptr_t Result;
-  if (FTicks.empty())
+  if (FTicksCount == 0)
   {
     Result = 0;
   }
@@ -782,14 +812,14 @@ uintptr_t TFileOperationProgressType::GetCPS() const
   {
     intptr_t Ticks = (GetSuspended() ? FSuspendTime : ::GetTickCount());
     intptr_t TimeSpan;
-    if (Ticks < FTicks.front())
+    if (Ticks < FTicks[FTicksStart])
     {
       // clocks has wrapped, guess 10 seconds difference
       TimeSpan = 10000;
     }
     else
     {
-      TimeSpan = (Ticks - FTicks.front());
+      TimeSpan = (Ticks - FTicks[FTicksStart]);
     }
 
     if (TimeSpan == 0)
@@ -798,7 +828,7 @@ uintptr_t TFileOperationProgressType::GetCPS() const
     }
     else
     {
-      int64_t Transferred = (GetTotalTransferred() - FTotalTransferredThen.front());
+      int64_t Transferred = (GetTotalTransferred() - FTotalTransferredThen[FTicksStart]);
       Result = static_cast<uintptr_t>(Transferred * MSecsPerSec / TimeSpan);
     }
   }
@@ -831,8 +861,8 @@ TDateTime TFileOperationProgressType::TotalTimeLeft() const
 
 int64_t TFileOperationProgressType::GetTotalTransferred() const
 {
-  TGuard Guard(*FSection);
-  return FTotalTransferred;
+  // updated without locking, see AddTransferredToTotals
+  return ::InterlockedCompareExchange64(const_cast<int64_t *>(&FTotalTransferred), 0, 0);
 }
 
 int64_t TFileOperationProgressType::GetTotalSize() const
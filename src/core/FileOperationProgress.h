@@ -100,11 +100,16 @@ private:
   TFileOperationProgressEvent FOnProgress;
   TFileOperationFinishedEvent FOnFinished;
   bool FReset;
-  uintptr_t FLastSecond;
+  // CPS limit token bucket, tokens (bytes) and when it was last refilled
+  uintptr_t FLastRefill;
   intptr_t FRemainingCPS;
   bool FCounterSet;
-  rde::vector<intptr_t> FTicks;
-  rde::vector<int64_t> FTotalTransferredThen;
+  // CPS samples (one per second at most) in a fixed-size sliding window
+  static const intptr_t CPSWindow = 10;
+  intptr_t FTicks[CPSWindow];
+  int64_t FTotalTransferredThen[CPSWindow];
+  intptr_t FTicksStart;
+  intptr_t FTicksCount;
   TCriticalSection *FSection;
   TCriticalSection *FUserSelectionsSection;
 
@@ -124,6 +129,8 @@ protected:
   void AddTotalSize(int64_t ASize);
   void RollbackTransferFromTotals(int64_t ATransferredSize, int64_t ASkippedSize);
   uintptr_t GetCPS() const;
+  void ClearCPSSamples();
+  void RefillCPSTokens();
   void Init();
   static bool PassCancelToParent(TCancelStatus ACancel);
 
@@ -213,12 +220,12 @@ public:
   void Finish(UnicodeString AFileName, bool Success,
     TOnceDoneOperation &OnceDoneOperation);
   void Progress();
-  uintptr_t LocalBlockSize();
+  uintptr_t LocalBlockSize(uintptr_t BlockSize);
   bool IsLocallyDone() const;
   bool IsTransferDone() const;
   void SetFile(UnicodeString AFileName, bool AFileInProgress = true);
   void SetFileInProgress();
-  uintptr_t TransferBlockSize();
+  uintptr_t TransferBlockSize(uintptr_t BlockSize);
   intptr_t AdjustToCPSLimit(intptr_t Size);
   void ThrottleToCPSLimit(intptr_t Size);
   static uintptr_t StaticBlockSize();
@@ -33,6 +33,13 @@ UnicodeString TCustomFileSystem::CreateTargetDirectory(
   return Result;
 }
 
+void TCustomFileSystem::CopyToLocalSegment(const TParallelSegment & /*Segment*/,
+  TParallelOperation * /*ParallelOperation*/, TFileOperationProgressType * /*OperationProgress*/)
+{
+  DebugFail();
+  ThrowNotImplemented(3030);
+}
+
 TCustomFileSystem::~TCustomFileSystem()
 {
 #ifdef USE_DLMALLOC
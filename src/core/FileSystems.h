@@ -14,6 +14,8 @@ class TCopyParamType;
 struct TSpaceAvailable;
 class TFileOperationProgressType;
 class TRemoteProperties;
+class TParallelOperation;
+struct TParallelSegment;
 
 enum TFSCommand
 {
@@ -187,6 +189,9 @@ public:
     UnicodeString TargetDir, const TCopyParamType *CopyParam,
     intptr_t Params, TFileOperationProgressType *OperationProgress,
     TOnceDoneOperation &OnceDoneOperation) = 0;
+  // only file systems capable of fsParallelSegments override this
+  virtual void CopyToLocalSegment(const TParallelSegment &Segment,
+    TParallelOperation *ParallelOperation, TFileOperationProgressType *OperationProgress);
   virtual void CopyToRemote(const TStrings *AFilesToCopy,
     UnicodeString TargetDir, const TCopyParamType *CopyParam,
     intptr_t Params, TFileOperationProgressType *OperationProgress,
@@ -2582,6 +2582,7 @@ bool TFTPFileSystem::IsCapable(intptr_t Capability) const
   case fcPreservingTimestampDirs:
   case fcResumeSupport:
   case fcChangePassword:
+  case fsParallelSegments: // the engine cannot stop a download at the end of a range
     return false;
 
   default:
@@ -3525,6 +3526,7 @@ void TFTPFileSystem::DiscardMessages()
 
 void TFTPFileSystem::WaitForMessages()
 {
+  TTransferStatisticsTimer Timer(&FTerminal->GetStatistics()->NetworkWaitTime);
   DWORD Result;
   do
   {
@@ -3644,6 +3646,10 @@ uintptr_t TFTPFileSystem::WaitForReply(bool Command, bool WantLastCode)
 
   ResetReply();
   FWaitingForReply = true;
+  if (Command)
+  {
+    FTerminal->GetStatistics()->RoundTrips++;
+  }
 
   uintptr_t Reply;
 
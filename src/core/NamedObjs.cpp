@@ -4,6 +4,8 @@
 #include <Common.h>
 #include <Sysutils.hpp>
 
+#include <rdestl/hash_map.h>
+
 #include "NamedObjs.h"
 
 static intptr_t NamedObjectSortProc(const void *Item1, const void *Item2)
@@ -11,10 +13,47 @@ static intptr_t NamedObjectSortProc(const void *Item1, const void *Item2)
   return get_as<TNamedObject>(Item1)->Compare(get_as<TNamedObject>(Item2));
 }
 
+//--- TNamedObjectIndex -----------------------------------------------------
+// Objects of TNamedObjectList by lower-cased name, built on the first
+// FindByName and then kept up to date as objects are added, removed
+// and renamed. Names are expected to be unique, only one object
+// of each name is indexed.
+// Lower-casing matches IsSameName for printable ASCII names only, so the
+// index is authoritative only while all names involved are such.
+class TNamedObjectIndex
+{
+public:
+  typedef rde::hash_map<UnicodeString, TNamedObject *, TNameHash> TObjects;
+
+  TNamedObjectIndex() : Duplicates(0), NonAscii(0) {}
+
+  static UnicodeString Key(UnicodeString Name) { return ::LowerCase(Name); }
+
+  static bool IsPlainAscii(UnicodeString Name)
+  {
+    const wchar_t *Data = Name.c_str();
+    for (intptr_t Index = 0; Index < Name.Length(); ++Index)
+    {
+      if ((Data[Index] < 0x20) || (Data[Index] >= 0x7F))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  TObjects Objects;
+  // objects not indexed, because the name was taken already
+  intptr_t Duplicates;
+  // objects in the list with other than plain ASCII name
+  intptr_t NonAscii;
+};
+
 //--- TNamedObject ----------------------------------------------------------
 TNamedObject::TNamedObject(TObjectClassId Kind, UnicodeString AName) :
   TPersistent(Kind),
-  FHidden(false)
+  FHidden(false),
+  FOwnerList(nullptr)
 {
   SetName(AName);
 }
@@ -22,7 +61,12 @@ TNamedObject::TNamedObject(TObjectClassId Kind, UnicodeString AName) :
 void TNamedObject::SetName(UnicodeString Value)
 {
   FHidden = (Value.SubString(1, TNamedObjectList::HiddenPrefix.Length()) == TNamedObjectList::HiddenPrefix);
+  UnicodeString OldName = FName;
   FName = Value;
+  if ((FOwnerList != nullptr) && (OldName != Value))
+  {
+    FOwnerList->ObjectRenamed(this, OldName);
+  }
 }
 
 intptr_t TNamedObject::Compare(const TNamedObject *Other) const
@@ -84,10 +128,82 @@ TNamedObjectList::TNamedObjectList(TObjectClassId Kind) :
   TObjectList(Kind),
   FHiddenCount(0),
   FAutoSort(true),
-  FControlledAdd(false)
+  FControlledAdd(false),
+  FIndex(nullptr)
 {
 }
 
+TNamedObjectList::~TNamedObjectList()
+{
+  // objects that survive the list must not report renames to it
+  for (intptr_t Index = 0; Index < TObjectList::GetCount(); ++Index)
+  {
+    TNamedObject *NamedObject = static_cast<TNamedObject *>(GetItem(Index));
+    if ((NamedObject != nullptr) && (NamedObject->FOwnerList == this))
+    {
+      NamedObject->FOwnerList = nullptr;
+    }
+  }
+  SAFE_DESTROY_EX(TNamedObjectIndex, FIndex);
+}
+
+void TNamedObjectList::IndexObject(TNamedObject *Object)
+{
+  Object->FOwnerList = this;
+  if (FIndex != nullptr)
+  {
+    UnicodeString Key = TNamedObjectIndex::Key(Object->GetName());
+    TNamedObjectIndex::TObjects::iterator It = FIndex->Objects.find(Key);
+    // not indexed yet (otherwise it was counted already)
+    if ((It == FIndex->Objects.end()) || (It->second != Object))
+    {
+      if (!TNamedObjectIndex::IsPlainAscii(Object->GetName()))
+      {
+        FIndex->NonAscii++;
+      }
+      if (It == FIndex->Objects.end())
+      {
+        FIndex->Objects[Key] = Object;
+      }
+      else
+      {
+        FIndex->Duplicates++;
+      }
+    }
+  }
+}
+
+void TNamedObjectList::UnindexObject(TNamedObject *Object, UnicodeString Name)
+{
+  if (FIndex != nullptr)
+  {
+    if (!TNamedObjectIndex::IsPlainAscii(Name) && DebugAlwaysTrue(FIndex->NonAscii > 0))
+    {
+      FIndex->NonAscii--;
+    }
+    TNamedObjectIndex::TObjects::iterator It = FIndex->Objects.find(TNamedObjectIndex::Key(Name));
+    if ((It != FIndex->Objects.end()) && (It->second == Object))
+    {
+      if (FIndex->Duplicates > 0)
+      {
+        // an object of the same name may need to take the place,
+        // let the next FindByName build the index anew
+        SAFE_DESTROY_EX(TNamedObjectIndex, FIndex);
+      }
+      else
+      {
+        FIndex->Objects.erase(It);
+      }
+    }
+  }
+}
+
+void TNamedObjectList::ObjectRenamed(TNamedObject *Object, UnicodeString OldName)
+{
+  UnindexObject(Object, OldName);
+  IndexObject(Object);
+}
+
 const TNamedObject *TNamedObjectList::AtObject(intptr_t Index) const
 {
   return const_cast<TNamedObjectList *>(this)->AtObject(Index);
@@ -130,6 +246,8 @@ intptr_t TNamedObjectList::Add(TObject *AObject)
   else
   {
     Result = TObjectList::Add(AObject);
+    // TList::Add does not notify
+    IndexObject(NamedObject);
   }
   return Result;
 }
@@ -143,10 +261,13 @@ void TNamedObjectList::Notify(void *Ptr, TListNotification Action)
     {
       FHiddenCount--;
     }
+    UnindexObject(NamedObject, NamedObject->GetName());
+    NamedObject->FOwnerList = nullptr;
   }
   TObjectList::Notify(Ptr, Action);
   if (Action == lnAdded)
   {
+    IndexObject(static_cast<TNamedObject *>(Ptr));
     if (!FControlledAdd)
     {
       FHiddenCount = -1;
@@ -165,14 +286,33 @@ const TNamedObject *TNamedObjectList::FindByName(UnicodeString Name) const
 
 TNamedObject *TNamedObjectList::FindByName(UnicodeString Name)
 {
-  // This should/can be optimized when list is sorted
-  for (Integer Index = 0; Index < GetCountIncludingHidden(); ++Index)
+  if (FIndex == nullptr)
   {
-    // Not using AtObject as we iterate even hidden objects here
-    TNamedObject *NamedObject = static_cast<TNamedObject *>(GetObj(Index));
-    if (NamedObject->IsSameName(Name))
+    FIndex = new TNamedObjectIndex();
+    for (Integer Index = 0; Index < GetCountIncludingHidden(); ++Index)
     {
-      return NamedObject;
+      // Not using AtObject as we index even hidden objects here
+      IndexObject(static_cast<TNamedObject *>(GetObj(Index)));
+    }
+  }
+
+  TNamedObjectIndex::TObjects::iterator It = FIndex->Objects.find(TNamedObjectIndex::Key(Name));
+  if ((It != FIndex->Objects.end()) && It->second->IsSameName(Name))
+  {
+    return It->second;
+  }
+
+  if ((FIndex->NonAscii > 0) || !TNamedObjectIndex::IsPlainAscii(Name))
+  {
+    // the lower-cased key may not match what IsSameName considers the same name
+    for (Integer Index = 0; Index < GetCountIncludingHidden(); ++Index)
+    {
+      // Not using AtObject as we iterate even hidden objects here
+      TNamedObject *NamedObject = static_cast<TNamedObject *>(GetObj(Index));
+      if (NamedObject->IsSameName(Name))
+      {
+        return NamedObject;
+      }
     }
   }
   return nullptr;
@@ -7,8 +7,10 @@
 #define CONST_HIDDEN_PREFIX L"_!_"
 
 class TNamedObjectList;
+class TNamedObjectIndex;
 class NB_CORE_EXPORT TNamedObject : public TPersistent
 {
+  friend class TNamedObjectList;
 public:
   static inline bool classof(const TObject *Obj) { return Obj->is(OBJECT_CLASS_TNamedObject); }
   virtual bool is(TObjectClassId Kind) const override { return (Kind == OBJECT_CLASS_TNamedObject) || TPersistent::is(Kind); }
@@ -21,8 +23,8 @@ public:
   void SetName(UnicodeString Value);
   bool GetHidden() const { return FHidden; }
 
-  explicit TNamedObject() : TPersistent(OBJECT_CLASS_TNamedObject), FHidden(false) {}
-  explicit TNamedObject(TObjectClassId Kind) : TPersistent(Kind), FHidden(false) {}
+  explicit TNamedObject() : TPersistent(OBJECT_CLASS_TNamedObject), FHidden(false), FOwnerList(nullptr) {}
+  explicit TNamedObject(TObjectClassId Kind) : TPersistent(Kind), FHidden(false), FOwnerList(nullptr) {}
   explicit TNamedObject(TObjectClassId Kind, UnicodeString AName);
   virtual ~TNamedObject() {}
 
@@ -32,6 +34,7 @@ public:
 private:
   UnicodeString FName;
   bool FHidden;
+  TNamedObjectList *FOwnerList;
 };
 
 class NB_CORE_EXPORT TNamedObjectList : public TObjectList
@@ -49,6 +52,11 @@ protected:
   bool FAutoSort;
   bool FControlledAdd;
   void Recount();
+private:
+  TNamedObjectIndex *FIndex;
+  void IndexObject(TNamedObject *Object);
+  void UnindexObject(TNamedObject *Object, UnicodeString Name);
+  void ObjectRenamed(TNamedObject *Object, UnicodeString OldName);
 public:
   static const UnicodeString HiddenPrefix;
 
@@ -56,6 +64,7 @@ public:
   void SetAutoSort(bool Value) { FAutoSort = Value; }
 
   explicit TNamedObjectList(TObjectClassId Kind = OBJECT_CLASS_TNamedObjectList);
+  virtual ~TNamedObjectList();
   void AlphaSort();
   intptr_t Add(TObject *AObject);
   virtual const TNamedObject *AtObject(intptr_t Index) const;
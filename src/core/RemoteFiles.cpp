@@ -7,6 +7,8 @@
 #include <Sysutils.hpp>
 #include <StrUtils.hpp>
 
+#include <rdestl/hash_map.h>
+
 #include "RemoteFiles.h"
 #include "Terminal.h"
 #include "TextsCore.h"
@@ -1878,56 +1880,438 @@ void TRemoteDirectory::SetIncludeThisDirectory(Boolean Value)
   }
 }
 
-TRemoteDirectoryCache::TRemoteDirectoryCache() : TStringList()
+enum
+{
+  cfSymLink = 0x01,
+  cfCyclicLink = 0x02,
+};
+
+TCompactRemoteFileList::TCompactRemoteFileList() :
+  TObject(),
+  FTerminal(nullptr)
+{
+}
+
+TCompactRemoteFileList::~TCompactRemoteFileList()
+{
+  Clear();
+}
+
+void TCompactRemoteFileList::Clear()
+{
+  for (size_t Index = 0; Index < FRights.size(); ++Index)
+  {
+    SAFE_DESTROY(FRights[Index]);
+  }
+  for (rde::map<size_t, TRemoteFile *>::iterator it = FLinkedFiles.begin(); it != FLinkedFiles.end(); ++it)
+  {
+    SAFE_DESTROY(it->second);
+  }
+  FDirectory.Clear();
+  FTerminal = nullptr;
+  FStringPool.clear();
+  FTokens.clear();
+  FRights.clear();
+  FTokenIndex.clear();
+  FRightsIndex.clear();
+  FLinkedFiles.clear();
+  FFileNames.clear();
+  FDisplayNames.clear();
+  FLinkTos.clear();
+  FHumanRights.clear();
+  FTypeNames.clear();
+  FSizes.clear();
+  FINodeBlocks.clear();
+  FModifications.clear();
+  FLastAccesses.clear();
+  FOwnerIndexes.clear();
+  FGroupIndexes.clear();
+  FRightsIndexes.clear();
+  FIconIndexes.clear();
+  FTypes.clear();
+  FFlags.clear();
+}
+
+void TCompactRemoteFileList::Assign(const TRemoteFileList *FileList)
+{
+  Clear();
+  FDirectory = FileList->GetDirectory();
+  FTimestamp = FileList->GetTimestamp();
+  for (intptr_t Index = 0; Index < FileList->GetCount(); ++Index)
+  {
+    AddFile(FileList->GetFile(Index));
+  }
+  // the same as TRemoteDirectory::DuplicateTo
+  const TRemoteDirectory *Directory = dyn_cast<TRemoteDirectory>(FileList);
+  if (Directory != nullptr)
+  {
+    if (Directory->GetThisDirectory() && !Directory->GetIncludeThisDirectory())
+    {
+      AddFile(Directory->GetThisDirectory());
+    }
+    if (Directory->GetParentDirectory() && !Directory->GetIncludeParentDirectory())
+    {
+      AddFile(Directory->GetParentDirectory());
+    }
+  }
+}
+
+void TCompactRemoteFileList::AddFile(const TRemoteFile *File)
+{
+  // all files of a listing belong to the same terminal
+  DebugAssert((FSizes.empty()) || (FTerminal == File->FTerminal));
+  FTerminal = File->FTerminal;
+  if (File->FLinkedFile != nullptr)
+  {
+    FLinkedFiles[FSizes.size()] = File->FLinkedFile->Duplicate(true);
+  }
+  FFileNames.push_back(AddString(File->FFileName));
+  FDisplayNames.push_back(AddString(File->FDisplayName));
+  FLinkTos.push_back(AddString(File->FLinkTo));
+  FHumanRights.push_back(AddString(File->FHumanRights));
+  FTypeNames.push_back(AddString(File->FTypeName));
+  FSizes.push_back(File->FSize);
+  FINodeBlocks.push_back(File->FINodeBlocks);
+  FModifications.push_back(File->FModification.GetValue());
+  FLastAccesses.push_back(File->FLastAccess.GetValue());
+  FOwnerIndexes.push_back(InternToken(File->FOwner));
+  FGroupIndexes.push_back(InternToken(File->FGroup));
+  FRightsIndexes.push_back(InternRights(File->FRights));
+  FIconIndexes.push_back(File->FIconIndex);
+  FTypes.push_back(File->FType);
+  FFlags.push_back(static_cast<uint8_t>(
+    (File->FModificationFmt << 4) |
+    FLAGMASK(File->FIsSymLink, cfSymLink) |
+    FLAGMASK(File->FCyclicLink, cfCyclicLink)));
+}
+
+TCompactRemoteFileList::TPooledString TCompactRemoteFileList::AddString(UnicodeString Value)
+{
+  TPooledString Result;
+  Result.Start = static_cast<uint32_t>(FStringPool.size());
+  Result.Length = static_cast<uint32_t>(Value.Length());
+  if (Result.Length > 0)
+  {
+    FStringPool.resize(Result.Start + Result.Length);
+    memmove(&FStringPool[Result.Start], Value.c_str(), Result.Length * sizeof(wchar_t));
+  }
+  return Result;
+}
+
+UnicodeString TCompactRemoteFileList::GetString(const TPooledString &Value) const
+{
+  return (Value.Length == 0) ? UnicodeString() : UnicodeString(&FStringPool[Value.Start], Value.Length);
+}
+
+uint32_t TCompactRemoteFileList::InternToken(const TRemoteToken &Token)
+{
+  // consecutive files mostly share owner and group
+  if (!FTokens.empty() && (FTokens.back() == Token))
+  {
+    return static_cast<uint32_t>(FTokens.size() - 1);
+  }
+  rde::map<UnicodeString, size_t>::iterator it = FTokenIndex.find(Token.GetName());
+  if ((it != FTokenIndex.end()) && (FTokens[it->second] == Token))
+  {
+    return static_cast<uint32_t>(it->second);
+  }
+  FTokens.push_back(Token);
+  FTokenIndex[Token.GetName()] = FTokens.size() - 1;
+  return static_cast<uint32_t>(FTokens.size() - 1);
+}
+
+static bool SameRights(const TRights *Rights1, const TRights *Rights2)
+{
+  return
+    (Rights1->GetNumberSet() == Rights2->GetNumberSet()) &&
+    (Rights1->GetNumberUnset() == Rights2->GetNumberUnset()) &&
+    (Rights1->GetAllowUndef() == Rights2->GetAllowUndef()) &&
+    (Rights1->GetUnknown() == Rights2->GetUnknown()) &&
+    (Rights1->GetText() == Rights2->GetText());
+}
+
+uint32_t TCompactRemoteFileList::InternRights(const TRights *Rights)
+{
+  if (!FRights.empty() && SameRights(FRights.back(), Rights))
+  {
+    return static_cast<uint32_t>(FRights.size() - 1);
+  }
+  UnicodeString Key = Rights->GetText();
+  rde::map<UnicodeString, size_t>::iterator it = FRightsIndex.find(Key);
+  if ((it != FRightsIndex.end()) && SameRights(FRights[it->second], Rights))
+  {
+    return static_cast<uint32_t>(it->second);
+  }
+  TRights *Copy = new TRights();
+  Copy->Assign(Rights);
+  FRights.push_back(Copy);
+  FRightsIndex[Key] = FRights.size() - 1;
+  return static_cast<uint32_t>(FRights.size() - 1);
+}
+
+UnicodeString TCompactRemoteFileList::GetFileName(intptr_t Index) const
+{
+  return GetString(FFileNames[Index]);
+}
+
+TRemoteFile *TCompactRemoteFileList::CreateFile(intptr_t Index) const
+{
+  // the same as TRemoteFile::Duplicate(false)
+  std::unique_ptr<TRemoteFile> Result(new TRemoteFile());
+  rde::map<size_t, TRemoteFile *> &LinkedFiles = const_cast<TCompactRemoteFileList *>(this)->FLinkedFiles;
+  rde::map<size_t, TRemoteFile *>::iterator Linked = LinkedFiles.find(static_cast<size_t>(Index));
+  if (Linked != LinkedFiles.end())
+  {
+    Result->FLinkedFile = Linked->second->Duplicate(true);
+    Result->FLinkedFile->FLinkedByFile = Result.get();
+  }
+  Result->SetRights(FRights[FRightsIndexes[Index]]);
+  Result->FTerminal = FTerminal;
+  Result->FOwner = FTokens[FOwnerIndexes[Index]];
+  Result->FModificationFmt = static_cast<TModificationFmt>(FFlags[Index] >> 4);
+  Result->FSize = FSizes[Index];
+  Result->FFileName = GetString(FFileNames[Index]);
+  Result->FDisplayName = GetString(FDisplayNames[Index]);
+  Result->FINodeBlocks = FINodeBlocks[Index];
+  Result->FModification = TDateTime(FModifications[Index]);
+  Result->FLastAccess = TDateTime(FLastAccesses[Index]);
+  Result->FGroup = FTokens[FGroupIndexes[Index]];
+  Result->FIconIndex = FIconIndexes[Index];
+  Result->FTypeName = GetString(FTypeNames[Index]);
+  Result->FIsSymLink = FLAGSET(FFlags[Index], cfSymLink);
+  Result->FLinkTo = GetString(FLinkTos[Index]);
+  Result->FType = FTypes[Index];
+  Result->FCyclicLink = FLAGSET(FFlags[Index], cfCyclicLink);
+  Result->FHumanRights = GetString(FHumanRights[Index]);
+  return Result.release();
+}
+
+void TCompactRemoteFileList::DuplicateTo(TRemoteFileList *Copy) const
+{
+  Copy->Reset();
+  for (intptr_t Index = 0; Index < GetCount(); ++Index)
+  {
+    Copy->AddFile(CreateFile(Index));
+  }
+  Copy->FDirectory = FDirectory;
+  Copy->FTimestamp = FTimestamp;
+}
+
+int64_t TCompactRemoteFileList::GetMemorySize() const
+{
+  int64_t Result =
+    sizeof(*this) +
+    FStringPool.capacity() * sizeof(wchar_t) +
+    FTokens.capacity() * sizeof(TRemoteToken) +
+    FRights.size() * sizeof(TRights) +
+    (FFileNames.capacity() + FDisplayNames.capacity() + FLinkTos.capacity() +
+     FHumanRights.capacity() + FTypeNames.capacity()) * sizeof(TPooledString) +
+    (FSizes.capacity() + FINodeBlocks.capacity()) * sizeof(int64_t) +
+    (FModifications.capacity() + FLastAccesses.capacity()) * sizeof(double) +
+    (FOwnerIndexes.capacity() + FGroupIndexes.capacity() + FRightsIndexes.capacity()) * sizeof(uint32_t) +
+    FIconIndexes.capacity() * sizeof(intptr_t) +
+    FTypes.capacity() * sizeof(wchar_t) +
+    FFlags.capacity() * sizeof(uint8_t) +
+    FLinkedFiles.size() * sizeof(TRemoteFile);
+  for (size_t Index = 0; Index < FTokens.size(); ++Index)
+  {
+    Result += FTokens[Index].GetName().Length() * sizeof(wchar_t);
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+struct TRemoteDirectoryCache::TNode
+{
+  CUSTOM_MEM_ALLOCATION_IMPL
+  NB_DISABLE_COPY(TNode)
+public:
+  // path components are hashed exactly (case sensitive, binary)
+  typedef rde::hash_map<UnicodeString, TNode *, TNameHash> TChildren;
+
+  TNode() :
+    Parent(nullptr),
+    FileList(nullptr),
+    Size(0),
+    Newer(nullptr),
+    Older(nullptr)
+  {
+  }
+
+  UnicodeString Name;
+  TNode *Parent;
+  TChildren Children;
+  TCompactRemoteFileList *FileList;
+  int64_t Size;
+  TNode *Newer;
+  TNode *Older;
+};
+
+TRemoteDirectoryCache::TRemoteDirectoryCache(int64_t MaxSize) :
+  TObject(),
+  FRoot(new TNode()),
+  FNewest(nullptr),
+  FOldest(nullptr),
+  FMaxSize(MaxSize),
+  FSize(0),
+  FCount(0),
+  FHits(0),
+  FMisses(0),
+  FEvictions(0)
 {
-  TStringList::SetSorted(true);
-  SetDuplicates(dupError);
-  TStringList::SetCaseSensitive(true);
 }
 
 TRemoteDirectoryCache::~TRemoteDirectoryCache()
 {
   TRemoteDirectoryCache::Clear();
+  SAFE_DESTROY(FRoot);
 }
 
 void TRemoteDirectoryCache::Clear()
 {
   TGuard Guard(FSection);
 
-  try__finally
+  DeleteSubTree(FRoot);
+  DebugAssert((FCount == 0) && (FNewest == nullptr) && (FOldest == nullptr));
+}
+
+bool TRemoteDirectoryCache::GetIsEmptyPrivate() const
+{
+  TGuard Guard(FSection);
+
+  return (FCount == 0);
+}
+
+TRemoteDirectoryCache::TNode *TRemoteDirectoryCache::FindNode(
+  UnicodeString Directory, bool Create) const
+{
+  UnicodeString Path = base::UnixExcludeTrailingBackslash(Directory);
+  // Split at every slash, keeping empty components,
+  // so that each path maps to exactly one node ("/" and "" differ).
+  // Subdirectories of a path are then the descendants of its node.
+  TNode *Node = FRoot;
+  const wchar_t *Start = Path.c_str();
+  const wchar_t *End = Start + Path.Length();
+  while (Node != nullptr)
   {
-    SCOPE_EXIT
+    const wchar_t *Delimiter = Start;
+    while ((Delimiter < End) && (*Delimiter != L'/'))
     {
-      TStringList::Clear();
-    };
-    for (intptr_t Index = 0; Index < GetCount(); ++Index)
+      ++Delimiter;
+    }
+    UnicodeString Name(Start, Delimiter - Start);
+    TNode::TChildren::iterator Child = Node->Children.find(Name);
+    if (Child != Node->Children.end())
     {
-      TRemoteFileList *List = GetAs<TRemoteFileList>(Index);
-      SAFE_DESTROY(List);
-      SetObj(Index, nullptr);
+      Node = Child->second;
     }
+    else if (Create)
+    {
+      TNode *NewNode = new TNode();
+      NewNode->Name = Name;
+      NewNode->Parent = Node;
+      Node->Children[Name] = NewNode;
+      Node = NewNode;
+    }
+    else
+    {
+      Node = nullptr;
+    }
+
+    if (Delimiter >= End)
+    {
+      break;
+    }
+    Start = Delimiter + 1;
   }
-  __finally
+  return Node;
+}
+
+void TRemoteDirectoryCache::Link(TNode *Node) const
+{
+  DebugAssert((Node->Newer == nullptr) && (Node->Older == nullptr));
+  Node->Older = FNewest;
+  if (FNewest != nullptr)
   {
-#if 0
-    TStringList::Clear();
-#endif // #if 0
-  };
+    FNewest->Newer = Node;
+  }
+  FNewest = Node;
+  if (FOldest == nullptr)
+  {
+    FOldest = Node;
+  }
 }
 
-bool TRemoteDirectoryCache::GetIsEmptyPrivate() const
+void TRemoteDirectoryCache::Unlink(TNode *Node) const
 {
-  TGuard Guard(FSection);
+  if (Node->Newer != nullptr)
+  {
+    Node->Newer->Older = Node->Older;
+  }
+  else
+  {
+    DebugAssert(FNewest == Node);
+    FNewest = Node->Older;
+  }
+  if (Node->Older != nullptr)
+  {
+    Node->Older->Newer = Node->Newer;
+  }
+  else
+  {
+    DebugAssert(FOldest == Node);
+    FOldest = Node->Newer;
+  }
+  Node->Newer = nullptr;
+  Node->Older = nullptr;
+}
 
-  return (const_cast<TRemoteDirectoryCache *>(this)->GetCount() == 0);
+void TRemoteDirectoryCache::DeleteFileList(TNode *Node)
+{
+  if (Node->FileList != nullptr)
+  {
+    Unlink(Node);
+    SAFE_DESTROY(Node->FileList);
+    FSize -= Node->Size;
+    Node->Size = 0;
+    FCount--;
+  }
+}
+
+void TRemoteDirectoryCache::DeleteSubTree(TNode *Node)
+{
+  for (TNode::TChildren::iterator Child = Node->Children.begin(); Child != Node->Children.end(); ++Child)
+  {
+    TNode *ChildNode = Child->second;
+    DeleteSubTree(ChildNode);
+    DeleteFileList(ChildNode);
+    SAFE_DESTROY(ChildNode);
+  }
+  Node->Children.clear();
+}
+
+void TRemoteDirectoryCache::Prune(TNode *Node)
+{
+  // remove nodes that no longer lead to any cached file list
+  while ((Node != FRoot) && (Node->FileList == nullptr) && Node->Children.empty())
+  {
+    TNode *Parent = Node->Parent;
+    Parent->Children.erase(Node->Name);
+    SAFE_DESTROY(Node);
+    Node = Parent;
+  }
 }
 
 bool TRemoteDirectoryCache::HasFileList(UnicodeString Directory) const
 {
   TGuard Guard(FSection);
 
-  intptr_t Index = IndexOf(base::UnixExcludeTrailingBackslash(Directory));
-  return (Index >= 0);
+  TNode *Node = FindNode(Directory, false);
+  bool Result = (Node != nullptr) && (Node->FileList != nullptr);
+  if (!Result)
+  {
+    FMisses++;
+  }
+  return Result;
 }
 
 bool TRemoteDirectoryCache::HasNewerFileList(UnicodeString Directory,
@@ -1935,16 +2319,10 @@ bool TRemoteDirectoryCache::HasNewerFileList(UnicodeString Directory,
 {
   TGuard Guard(FSection);
 
-  intptr_t Index = IndexOf(base::UnixExcludeTrailingBackslash(Directory));
-  if (Index >= 0)
-  {
-    TRemoteFileList *FileList = GetAs<TRemoteFileList>(Index);
-    if (FileList->GetTimestamp() <= Timestamp)
-    {
-      Index = -1;
-    }
-  }
-  return (Index >= 0);
+  TNode *Node = FindNode(Directory, false);
+  return
+    (Node != nullptr) && (Node->FileList != nullptr) &&
+    (Node->FileList->GetTimestamp() > Timestamp);
 }
 
 bool TRemoteDirectoryCache::GetFileList(UnicodeString Directory,
@@ -1952,12 +2330,14 @@ bool TRemoteDirectoryCache::GetFileList(UnicodeString Directory,
 {
   TGuard Guard(FSection);
 
-  intptr_t Index = IndexOf(base::UnixExcludeTrailingBackslash(Directory));
-  bool Result = (Index >= 0);
+  TNode *Node = FindNode(Directory, false);
+  bool Result = (Node != nullptr) && (Node->FileList != nullptr);
   if (Result)
   {
-    DebugAssert(GetObj(Index) != nullptr);
-    GetAs<TRemoteFileList>(Index)->DuplicateTo(FileList);
+    Node->FileList->DuplicateTo(FileList);
+    Unlink(Node);
+    Link(Node);
+    FHits++;
   }
   return Result;
 }
@@ -1967,15 +2347,31 @@ void TRemoteDirectoryCache::AddFileList(TRemoteFileList *FileList)
   DebugAssert(FileList);
   if (FileList)
   {
-    TRemoteFileList *Copy = new TRemoteFileList();
-    FileList->DuplicateTo(Copy);
+    TCompactRemoteFileList *Copy = new TCompactRemoteFileList();
+    Copy->Assign(FileList);
+    int64_t Size = Copy->GetMemorySize();
 
     TGuard Guard(FSection);
 
     // file list cannot be cached already with only one thread, but it can be
     // when directory is loaded by secondary terminal
     DoClearFileList(FileList->GetDirectory(), false);
-    AddObject(Copy->GetDirectory(), Copy);
+
+    TNode *Node = FindNode(Copy->GetDirectory(), true);
+    Node->FileList = Copy;
+    Node->Size = Size;
+    Link(Node);
+    FSize += Size;
+    FCount++;
+
+    // the list just added is kept, even if it alone exceeds the limit
+    while ((FMaxSize > 0) && (FSize > FMaxSize) && (FOldest != Node))
+    {
+      TNode *Oldest = FOldest;
+      DeleteFileList(Oldest);
+      Prune(Oldest);
+      FEvictions++;
+    }
   }
 }
 
@@ -1988,33 +2384,26 @@ void TRemoteDirectoryCache::ClearFileList(UnicodeString Directory, bool SubDirs)
 void TRemoteDirectoryCache::DoClearFileList(UnicodeString Directory, bool SubDirs)
 {
   UnicodeString Directory2 = base::UnixExcludeTrailingBackslash(Directory);
-  intptr_t Index = IndexOf(Directory2);
-  if (Index >= 0)
+  TNode *Node = FindNode(Directory2, false);
+  if (Node != nullptr)
   {
-    Delete(Index);
+    DeleteFileList(Node);
+    Prune(Node);
   }
   if (SubDirs)
   {
+    // subdirectories are paths starting with the directory and a slash,
+    // i.e. descendants of the node of the path without the slash
     Directory2 = base::UnixIncludeTrailingBackslash(Directory2);
-    Index = GetCount() - 1;
-    while (Index >= 0)
+    TNode *Parent = FindNode(Directory2.SubString(1, Directory2.Length() - 1), false);
+    if (Parent != nullptr)
     {
-      if (GetString(Index).SubString(1, Directory2.Length()) == Directory2)
-      {
-        Delete(Index);
-      }
-      Index--;
+      DeleteSubTree(Parent);
+      Prune(Parent);
     }
   }
 }
 
-void TRemoteDirectoryCache::Delete(intptr_t Index)
-{
-  TRemoteFileList *List = GetAs<TRemoteFileList>(Index);
-  SAFE_DESTROY(List);
-  TStringList::Delete(Index);
-}
-
 TRemoteDirectoryChangesCache::TRemoteDirectoryChangesCache(intptr_t MaxSize) :
   TStringList(),
   FMaxSize(MaxSize)
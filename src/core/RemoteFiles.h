@@ -101,6 +101,7 @@ private:
 
 class NB_CORE_EXPORT TRemoteFile : public TPersistent
 {
+  friend class TCompactRemoteFileList;
   NB_DISABLE_COPY(TRemoteFile)
 public:
   static inline bool classof(const TObject *Obj) { return Obj->is(OBJECT_CLASS_TRemoteFile); }
@@ -270,6 +271,7 @@ class NB_CORE_EXPORT TRemoteFileList : public TObjectList
   friend class TSFTPFileSystem;
   friend class TFTPFileSystem;
   friend class TWebDAVFileSystem;
+  friend class TCompactRemoteFileList;
 public:
   static inline bool classof(const TObject *Obj) { return Obj->is(OBJECT_CLASS_TRemoteFileList); }
   virtual bool is(TObjectClassId Kind) const override { return (Kind == OBJECT_CLASS_TRemoteFileList) || TObjectList::is(Kind); }
@@ -356,12 +358,76 @@ public:
   TStrings *GetSelectedFiles() const;
 };
 
-class TRemoteDirectoryCache : private TStringList
+// Read-only listing packed into flat arrays with pooled strings and
+// interned owner/group tokens and rights.
+// Used only for listings kept in TRemoteDirectoryCache, TRemoteFile objects
+// are created when a cached listing is unpacked.
+// The current directory listing (and the panel filled from it) still holds
+// a TRemoteFile per entry.
+class NB_CORE_EXPORT TCompactRemoteFileList : public TObject
+{
+  NB_DISABLE_COPY(TCompactRemoteFileList)
+public:
+  TCompactRemoteFileList();
+  virtual ~TCompactRemoteFileList();
+
+  void Assign(const TRemoteFileList *FileList);
+  void DuplicateTo(TRemoteFileList *Copy) const;
+  TRemoteFile *CreateFile(intptr_t Index) const;
+  void Clear();
+
+  intptr_t GetCount() const { return static_cast<intptr_t>(FSizes.size()); }
+  UnicodeString GetDirectory() const { return FDirectory; }
+  TDateTime GetTimestamp() const { return FTimestamp; }
+  UnicodeString GetFileName(intptr_t Index) const;
+  int64_t GetMemorySize() const;
+
+private:
+  struct TPooledString
+  {
+    uint32_t Start;
+    uint32_t Length;
+  };
+
+  UnicodeString FDirectory;
+  TDateTime FTimestamp;
+  TTerminal *FTerminal;
+  rde::vector<wchar_t> FStringPool;
+  rde::vector<TRemoteToken> FTokens;
+  rde::vector<TRights *> FRights;
+  rde::map<UnicodeString, size_t> FTokenIndex;
+  rde::map<UnicodeString, size_t> FRightsIndex;
+  rde::map<size_t, TRemoteFile *> FLinkedFiles;
+  // one item per file
+  rde::vector<TPooledString> FFileNames;
+  rde::vector<TPooledString> FDisplayNames;
+  rde::vector<TPooledString> FLinkTos;
+  rde::vector<TPooledString> FHumanRights;
+  rde::vector<TPooledString> FTypeNames;
+  rde::vector<int64_t> FSizes;
+  rde::vector<int64_t> FINodeBlocks;
+  rde::vector<double> FModifications;
+  rde::vector<double> FLastAccesses;
+  rde::vector<uint32_t> FOwnerIndexes;
+  rde::vector<uint32_t> FGroupIndexes;
+  rde::vector<uint32_t> FRightsIndexes;
+  rde::vector<intptr_t> FIconIndexes;
+  rde::vector<wchar_t> FTypes;
+  rde::vector<uint8_t> FFlags;
+
+  void AddFile(const TRemoteFile *File);
+  TPooledString AddString(UnicodeString Value);
+  UnicodeString GetString(const TPooledString &Value) const;
+  uint32_t InternToken(const TRemoteToken &Token);
+  uint32_t InternRights(const TRights *Rights);
+};
+
+class TRemoteDirectoryCache : public TObject
 {
   CUSTOM_MEM_ALLOCATION_IMPL
   NB_DISABLE_COPY(TRemoteDirectoryCache)
 public:
-  TRemoteDirectoryCache();
+  explicit TRemoteDirectoryCache(int64_t MaxSize = 0);
   virtual ~TRemoteDirectoryCache();
   bool HasFileList(UnicodeString Directory) const;
   bool HasNewerFileList(UnicodeString Directory, const TDateTime &Timestamp) const;
@@ -375,14 +441,36 @@ public:
   __property bool IsEmpty = { read = GetIsEmpty };
 #endif // #if 0
   bool GetIsEmpty() const { return GetIsEmptyPrivate(); }
-
-protected:
-  virtual void Delete(intptr_t Index);
+  int64_t GetSize() const { return FSize; }
+  intptr_t GetCount() const { return FCount; }
+  intptr_t GetHits() const { return FHits; }
+  intptr_t GetMisses() const { return FMisses; }
+  intptr_t GetEvictions() const { return FEvictions; }
 
 private:
+  struct TNode;
+
   TCriticalSection FSection;
+  // path trie, one node per path component
+  TNode *FRoot;
+  // least recently used list of nodes with cached file list
+  mutable TNode *FNewest;
+  mutable TNode *FOldest;
+  int64_t FMaxSize;
+  int64_t FSize;
+  intptr_t FCount;
+  mutable intptr_t FHits;
+  mutable intptr_t FMisses;
+  intptr_t FEvictions;
+
   bool GetIsEmptyPrivate() const;
   void DoClearFileList(UnicodeString Directory, bool SubDirs);
+  TNode *FindNode(UnicodeString Directory, bool Create) const;
+  void Link(TNode *Node) const;
+  void Unlink(TNode *Node) const;
+  void DeleteFileList(TNode *Node);
+  void DeleteSubTree(TNode *Node);
+  void Prune(TNode *Node);
 };
 
 class TRemoteDirectoryChangesCache : private TStringList
@@ -26,6 +26,10 @@ const int ecIgnoreWarnings = 2;
 const int ecReadProgress = 4;
 const int ecDefault = ecRaiseExcept;
 
+// SCP does not limit the block size, larger blocks just update the progress less often
+const uintptr_t MinBlockSize = 32 * 1024;
+const uintptr_t MaxBlockSize = 8 * 1024 * 1024;
+
 inline void ThrowFileSkipped(Exception *Exception, UnicodeString Message)
 {
   throw EFileSkipped(Exception, Message);
@@ -520,6 +524,7 @@ bool TSCPFileSystem::IsCapable(intptr_t Capability) const
   case fcResumeSupport:
   case fsSkipTransfer:
   case fsParallelTransfers: // does not implement cpNoRecurse
+  case fsParallelSegments:
     return false;
 
   case fcChangePassword:
@@ -1852,6 +1857,21 @@ void TSCPFileSystem::CopyToRemote(const TStrings *AFilesToCopy,
   };
 }
 
+uintptr_t TSCPFileSystem::GetBlockSize() const
+{
+  intptr_t BlockSize = FTerminal->GetConfiguration()->GetScpTransferBlockSize();
+  return Min(Max(static_cast<uintptr_t>(Max(BlockSize, static_cast<intptr_t>(0))), MinBlockSize), MaxBlockSize);
+}
+
+uint8_t *TSCPFileSystem::GetBlockBuffer(uintptr_t Size)
+{
+  if (FBlockBuffer.size() < Size)
+  {
+    FBlockBuffer.resize(Size);
+  }
+  return FBlockBuffer.data();
+}
+
 void TSCPFileSystem::SCPSource(UnicodeString AFileName,
   const TRemoteFile *AFile,
   const UnicodeString TargetDir, const TCopyParamType *CopyParam, intptr_t Params,
@@ -1937,20 +1957,39 @@ void TSCPFileSystem::SCPSource(UnicodeString AFileName,
         // we can't know its size
         TFileBuffer AsciiBuf;
         bool ConvertToken = false;
+        uintptr_t BlockSizeLimit = GetBlockSize();
+        // BINARY: blocks are read directly to the buffer and sent from it
+        uint8_t *Buffer = GetBlockBuffer(BlockSizeLimit);
         do
         {
-          // Buffer for one block of data
+          // Buffer for one block of data in ASCII mode
           TFileBuffer BlockBuf;
+          uintptr_t BlockSize = 0;
 
           // This is crucial, if it fails during file transfer, it's fatal error
           FileOperationLoopCustom(FTerminal, OperationProgress, !OperationProgress->GetTransferringFile(),
             FMTLOAD(READ_ERROR, AFileName), "",
           [&]()
           {
-            BlockBuf.LoadStream(Stream.get(), OperationProgress->LocalBlockSize(), true);
+            BlockSize = OperationProgress->LocalBlockSize(BlockSizeLimit);
+            if (OperationProgress->GetAsciiTransfer())
+            {
+              BlockBuf.LoadStream(Stream.get(), BlockSize, true);
+            }
+            else
+            {
+              try
+              {
+                Stream->ReadBuffer(Buffer, BlockSize);
+              }
+              catch (EReadError &)
+              {
+                ::RaiseLastOSError();
+              }
+            }
           });
 
-          OperationProgress->AddLocallyUsed(BlockBuf.GetSize());
+          OperationProgress->AddLocallyUsed(BlockSize);
 
           // We do ASCII transfer: convert EOL of current block
           // (we don't convert whole buffer, cause it would produce
@@ -2030,11 +2069,11 @@ void TSCPFileSystem::SCPSource(UnicodeString AFileName,
               OperationProgress->ChangeTransferSize(AsciiBuf.GetSize());
               while (!OperationProgress->IsTransferDone())
               {
-                uintptr_t BlockSize = OperationProgress->TransferBlockSize();
+                uintptr_t AsciiBlockSize = OperationProgress->TransferBlockSize(BlockSizeLimit);
                 FSecureShell->Send(
                   reinterpret_cast<uint8_t *>(AsciiBuf.GetData() + static_cast<intptr_t>(OperationProgress->GetTransferredSize())),
-                  BlockSize);
-                OperationProgress->AddTransferred(BlockSize);
+                  AsciiBlockSize);
+                OperationProgress->AddTransferred(AsciiBlockSize);
                 if (OperationProgress->GetCancel() == csCancelTransfer)
                 {
                   throw Exception(MainInstructions(LoadStr(USER_TERMINATED)));
@@ -2049,15 +2088,15 @@ void TSCPFileSystem::SCPSource(UnicodeString AFileName,
             if (!OperationProgress->GetTransferredSize())
             {
               FTerminal->LogEvent(FORMAT("Sending BINARY data (first block, %u bytes)",
-                  BlockBuf.GetSize()));
+                  BlockSize));
             }
             else if (FTerminal->GetConfiguration()->GetActualLogProtocol() >= 1)
             {
               FTerminal->LogEvent(FORMAT("Sending BINARY data (%u bytes)",
-                  BlockBuf.GetSize()));
+                  BlockSize));
             }
-            FSecureShell->Send(reinterpret_cast<const uint8_t *>(BlockBuf.GetData()), ToInt(BlockBuf.GetSize()));
-            OperationProgress->AddTransferred(BlockBuf.GetSize());
+            FSecureShell->Send(Buffer, static_cast<intptr_t>(BlockSize));
+            OperationProgress->AddTransferred(BlockSize);
           }
 
           if ((OperationProgress->GetCancel() == csCancelTransfer) ||
@@ -2808,25 +2847,32 @@ void TSCPFileSystem::SCPSink(const UnicodeString TargetDir,
 
               try
               {
-                // Buffer for one block of data
+                // Buffer for EOL conversion of one block of data in ASCII mode
                 TFileBuffer BlockBuf;
                 bool ConvertToken = false;
+                uintptr_t BlockSizeLimit = GetBlockSize();
+                // blocks are received directly to the buffer
+                uint8_t *Buffer = GetBlockBuffer(BlockSizeLimit);
 
                 do
                 {
-                  BlockBuf.SetSize(OperationProgress->TransferBlockSize());
-                  BlockBuf.SetPosition(0);
+                  uintptr_t BlockSize = OperationProgress->TransferBlockSize(BlockSizeLimit);
 
-                  FSecureShell->Receive(reinterpret_cast<uint8_t *>(BlockBuf.GetData()), static_cast<intptr_t>(BlockBuf.GetSize()));
-                  OperationProgress->AddTransferred(BlockBuf.GetSize());
+                  FSecureShell->Receive(Buffer, static_cast<intptr_t>(BlockSize));
+                  OperationProgress->AddTransferred(BlockSize);
 
+                  const uint8_t *Data = Buffer;
+                  uintptr_t DataSize = BlockSize;
                   if (OperationProgress->GetAsciiTransfer())
                   {
-                    int64_t PrevBlockSize = BlockBuf.GetSize();
+                    BlockBuf.SetSize(0);
+                    BlockBuf.Insert(0, reinterpret_cast<const char *>(Buffer), BlockSize);
                     BlockBuf.Convert(FTerminal->GetSessionData()->GetEOLType(),
                       FTerminal->GetConfiguration()->GetLocalEOLType(), 0, ConvertToken);
                     OperationProgress->SetLocalSize(
-                      OperationProgress->GetLocalSize() - PrevBlockSize + BlockBuf.GetSize());
+                      OperationProgress->GetLocalSize() - static_cast<int64_t>(BlockSize) + BlockBuf.GetSize());
+                    Data = reinterpret_cast<const uint8_t *>(BlockBuf.GetData());
+                    DataSize = static_cast<uintptr_t>(BlockBuf.GetSize());
                   }
 
                   // This is crucial, if it fails during file transfer, it's fatal error
@@ -2834,10 +2880,17 @@ void TSCPFileSystem::SCPSink(const UnicodeString TargetDir,
                     FMTLOAD(WRITE_ERROR, DestFileName), "",
                   [&]()
                   {
-                    BlockBuf.WriteToStream(FileStream.get(), static_cast<uint32_t>(BlockBuf.GetSize()));
+                    try
+                    {
+                      FileStream->WriteBuffer(Data, DataSize);
+                    }
+                    catch (EWriteError &)
+                    {
+                      ::RaiseLastOSError();
+                    }
                   });
 
-                  OperationProgress->AddLocallyUsed(BlockBuf.GetSize());
+                  OperationProgress->AddLocallyUsed(DataSize);
 
                   if (OperationProgress->GetCancel() == csCancelTransfer)
                   {
@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include <rdestl/vector.h>
 #include <FileSystems.h>
 #include <CopyParam.h>
 
@@ -102,6 +103,8 @@ private:
   int FLsFullTime;
   TCaptureOutputEvent FOnCaptureOutput;
   bool FScpFatalError;
+  // block buffer reused by all transfers of the session
+  rde::vector<uint8_t> FBlockBuffer;
 
   void DetectUtf();
   void ClearAliases();
@@ -153,6 +156,9 @@ private:
     const TOverwriteFileParams *FileParams, const TCopyParamType *CopyParam,
     intptr_t Params, TFileOperationProgressType *OperationProgress);
 
+  uintptr_t GetBlockSize() const;
+  uint8_t *GetBlockBuffer(uintptr_t Size);
+
   static bool RemoveLastLine(UnicodeString &Line,
     intptr_t &ReturnCode, UnicodeString ALastLine = L"");
   UnicodeString InitOptionsStr(const TCopyParamType *CopyParam) const;
@@ -27,6 +27,150 @@
 
 const wchar_t HostKeyDelimiter = L';';
 
+// Large enough to hold a typical SFTP data packet without crossing
+// a segment boundary
+static const intptr_t PendingSegmentSize = 64 * 1024;
+// High-water mark of drained segments kept for reuse,
+// excess segments are returned to the heap
+static const intptr_t PendingSpareSegments = 16;
+
+TSegmentedBuffer::TSegmentedBuffer() :
+  FSize(0),
+  FCoalesced(0),
+  FAllocations(0)
+{
+}
+
+TSegmentedBuffer::~TSegmentedBuffer()
+{
+  Clear();
+  for (intptr_t Index = 0; Index < ToIntPtr(FSpare.size()); ++Index)
+  {
+    sfree(FSpare[Index]);
+  }
+  FSpare.clear();
+}
+
+TSegmentedBuffer::TSegment TSegmentedBuffer::NewSegment(intptr_t Capacity)
+{
+  TSegment Result;
+  if ((Capacity <= PendingSegmentSize) && !FSpare.empty())
+  {
+    Result.Data = FSpare.back();
+    Result.Capacity = PendingSegmentSize;
+    FSpare.pop_back();
+  }
+  else
+  {
+    Result.Capacity = Max(Capacity, PendingSegmentSize);
+    Result.Data = static_cast<uint8_t *>(smalloc(Result.Capacity));
+    ++FAllocations;
+  }
+  Result.Start = 0;
+  Result.End = 0;
+  return Result;
+}
+
+void TSegmentedBuffer::ReleaseSegment(const TSegment &Segment)
+{
+  if ((Segment.Capacity == PendingSegmentSize) &&
+      (ToIntPtr(FSpare.size()) < PendingSpareSegments))
+  {
+    FSpare.push_back(Segment.Data);
+  }
+  else
+  {
+    sfree(Segment.Data);
+  }
+}
+
+void TSegmentedBuffer::Append(const uint8_t *Data, intptr_t Length)
+{
+  while (Length > 0)
+  {
+    if (FSegments.empty() || (FSegments.back().End == FSegments.back().Capacity))
+    {
+      FSegments.push_back(NewSegment(PendingSegmentSize));
+    }
+    TSegment &Tail = FSegments.back();
+    intptr_t Used = Min(Length, Tail.Capacity - Tail.End);
+    memmove(Tail.Data + Tail.End, Data, Used);
+    Tail.End += Used;
+    FSize += Used;
+    Data += Used;
+    Length -= Used;
+  }
+}
+
+intptr_t TSegmentedBuffer::Read(uint8_t *Buf, intptr_t Length)
+{
+  intptr_t Result = Min(Length, FSize);
+  intptr_t Left = Result;
+  intptr_t Drained = 0;
+  while (Left > 0)
+  {
+    TSegment &Head = FSegments[Drained];
+    intptr_t Used = Min(Left, Head.End - Head.Start);
+    memmove(Buf, Head.Data + Head.Start, Used);
+    Head.Start += Used;
+    Buf += Used;
+    Left -= Used;
+    if (Head.Start == Head.End)
+    {
+      ReleaseSegment(Head);
+      ++Drained;
+    }
+  }
+  if (Drained > 0)
+  {
+    FSegments.erase(FSegments.begin(), FSegments.begin() + Drained);
+  }
+  FSize -= Result;
+  return Result;
+}
+
+bool TSegmentedBuffer::Peek(uint8_t *&Buf, intptr_t Length)
+{
+  bool Result = (FSize >= Length);
+  if (Result && (FSize > 0))
+  {
+    if (FSegments.front().End - FSegments.front().Start < Length)
+    {
+      // Requested span crosses a segment boundary,
+      // gather just the span into a segment of its own in front of the chain
+      TSegment Segment = NewSegment(Length);
+      Segment.End = Read(Segment.Data, Length);
+      FSegments.insert(FSegments.begin(), Segment);
+      FSize += Segment.End;
+      FCoalesced += Segment.End;
+    }
+    Buf = FSegments.front().Data + FSegments.front().Start;
+  }
+  return Result;
+}
+
+intptr_t TSegmentedBuffer::Front(const uint8_t *&Buf) const
+{
+  intptr_t Result = 0;
+  if (!FSegments.empty())
+  {
+    const TSegment &Head = FSegments.front();
+    Buf = Head.Data + Head.Start;
+    Result = Head.End - Head.Start;
+  }
+  return Result;
+}
+
+void TSegmentedBuffer::Clear()
+{
+  for (intptr_t Index = 0; Index < ToIntPtr(FSegments.size()); ++Index)
+  {
+    ReleaseSegment(FSegments[Index]);
+  }
+  FSegments.clear();
+  FSize = 0;
+}
+
 struct TPuttyTranslation
 {
   const wchar_t *Original;
@@ -41,6 +185,7 @@ TSecureShell::TSecureShell(TSessionUI *UI,
   FUI = UI;
   FSessionData = SessionData;
   FLog = Log;
+  FStatistics = nullptr;
   FConfiguration = Configuration;
   FAuthenticating = false;
   FAuthenticated = false;
@@ -51,11 +196,8 @@ TSecureShell::TSecureShell(TSessionUI *UI,
   FSessionInfoValid = false;
   FBackend = nullptr;
   FSshImplementation = sshiUnknown;
-  PendLen = 0;
-  PendSize = 0;
   OutLen = 0;
   OutPtr = nullptr;
-  Pending = nullptr;
   FBackendHandle = nullptr;
   ResetConnection();
   FOnCaptureOutput = nullptr;
@@ -85,10 +227,7 @@ void TSecureShell::ResetConnection()
 {
   FreeBackend();
   ClearStdError();
-  PendLen = 0;
-  PendSize = 0;
-  sfree(Pending);
-  Pending = nullptr;
+  FPending.Clear();
   FCWriteTemp.Clear();
   ResetSessionInfo();
   FAuthenticating = false;
@@ -190,6 +329,8 @@ Conf *TSecureShell::StoreToConfig(TSessionData *Data, bool Simple)
   // multi-threaded issues in putty timer list
   conf_set_int(conf, CONF_ping_interval, 0);
   conf_set_int(conf, CONF_compression, Data->GetCompression());
+  conf_set_int(conf, CONF_compression_level, ToInt(Data->GetCompressionLevel()));
+  conf_set_int(conf, CONF_ssh_crypto_thread, Data->GetSshCryptoThread());
   conf_set_int(conf, CONF_tryagent, Data->GetTryAgent());
   conf_set_int(conf, CONF_agentfwd, Data->GetAgentFwd());
   conf_set_int(conf, CONF_addressfamily, Data->GetAddressFamily());
@@ -414,6 +555,7 @@ Conf *TSecureShell::StoreToConfig(TSessionData *Data, bool Simple)
 
   conf_set_int(conf, CONF_connect_timeout, ToInt(Data->GetTimeout() * MSecsPerSec));
   conf_set_int(conf, CONF_sndbuf, ToInt(Data->GetSendBuf()));
+  conf_set_int(conf, CONF_ssh2_maxpkt, ToInt(Data->GetSshMaxPacketSize()));
 
   // permanent settings
   conf_set_int(conf, CONF_nopty, TRUE);
@@ -1089,21 +1231,7 @@ void TSecureShell::FromBackend(bool IsStdErr, const uint8_t *Data, intptr_t Leng
 
     if (Len > 0)
     {
-      if (PendSize < PendLen + Len)
-      {
-        PendSize = PendLen + Len + 4096;
-        Pending = static_cast<uint8_t *>
-          (Pending ? srealloc(Pending, PendSize) : smalloc(PendSize));
-        if (!Pending)
-        {
-          FatalError(L"Out of memory");
-        }
-      }
-      if (Pending)
-      {
-        memmove(Pending + PendLen, p, Len);
-        PendLen += Len;
-      }
+      FPending.Append(p, Len);
     }
 
     if (FOnReceive != nullptr)
@@ -1141,14 +1269,7 @@ void TSecureShell::FromBackend(bool IsStdErr, const uint8_t *Data, intptr_t Leng
 
 bool TSecureShell::Peek(uint8_t *&Buf, intptr_t Length) const
 {
-  bool Result = (PendLen >= Length);
-
-  if (Result)
-  {
-    Buf = Pending;
-  }
-
-  return Result;
+  return FPending.Peek(Buf, Length);
 }
 
 intptr_t TSecureShell::Receive(uint8_t *Buf, intptr_t Length)
@@ -1172,24 +1293,11 @@ intptr_t TSecureShell::Receive(uint8_t *Buf, intptr_t Length)
        * See if the pending-input block contains some of what we
        * need.
        */
-      if (PendLen > 0)
+      if (FPending.GetSize() > 0)
       {
-        intptr_t PendUsed = PendLen;
-        if (PendUsed > OutLen)
-        {
-          PendUsed = OutLen;
-        }
-        memmove(OutPtr, Pending, PendUsed); //-V575
-        memmove(Pending, Pending + PendUsed, PendLen - PendUsed);
+        intptr_t PendUsed = FPending.Read(OutPtr, OutLen);
         OutPtr += PendUsed;
         OutLen -= PendUsed;
-        PendLen -= PendUsed;
-        if (PendLen == 0)
-        {
-          PendSize = 0;
-          sfree(Pending);
-          Pending = nullptr;
-        }
       }
 
       while (OutLen > 0)
@@ -1198,6 +1306,7 @@ intptr_t TSecureShell::Receive(uint8_t *Buf, intptr_t Length)
         {
           LogEvent(FORMAT("Waiting for another %u bytes", ToInt(OutLen)));
         }
+        TTransferStatisticsTimer Timer((FStatistics != nullptr) ? &FStatistics->NetworkWaitTime : nullptr);
         WaitForData();
       }
 
@@ -1219,7 +1328,7 @@ intptr_t TSecureShell::Receive(uint8_t *Buf, intptr_t Length)
   if (GetConfiguration()->GetActualLogProtocol() >= 1)
   {
     LogEvent(FORMAT("Read %d bytes (%d pending)",
-        ToInt(Length), ToInt(PendLen)));
+        ToInt(Length), ToInt(FPending.GetSize())));
   }
   return Length;
 }
@@ -1232,10 +1341,13 @@ UnicodeString TSecureShell::ReceiveLine()
   do
   {
     // If there is any buffer of received chars
-    if (PendLen > 0)
+    // (walk the pending segments one by one)
+    const uint8_t *Pending = nullptr;
+    intptr_t PendLen;
+    while (!EOL && ((PendLen = FPending.Front(Pending)) > 0))
     {
       intptr_t Index = 0;
-      // Repeat until we walk thru whole buffer or reach end-of-line
+      // Repeat until we walk thru whole segment or reach end-of-line
       while ((Index < PendLen) && (!Index || (Pending[Index - 1] != '\n')))
       {
         ++Index;
@@ -1760,6 +1872,17 @@ void TSecureShell::Close()
   LogEvent("Closing connection.");
   DebugAssert(FActive);
 
+  if (GetConfiguration()->GetActualLogProtocol() >= 1)
+  {
+    LogEvent(FORMAT("Receive buffer: %d segment allocations, %s bytes coalesced",
+      ToInt(FPending.GetAllocations()), Int64ToStr(FPending.GetCoalesced())));
+  }
+
+  if (FStatistics != nullptr)
+  {
+    FStatistics->PacketAllocations += get_ssh_packet_allocations(FBackendHandle);
+  }
+
   // this is particularly necessary when using local proxy command
   // (e.g. plink), otherwise it hangs in sk_localproxy_close
   SendEOF();
@@ -2026,6 +2149,11 @@ bool TSecureShell::EventSelectLoop(uintptr_t MSec, bool ReadEventRequired,
       size_t n = static_cast<size_t>(HandleCount + 1);
       Handles = sresize(Handles, n, HANDLE);
       Handles[HandleCount] = FSocketEvent;
+      // packets still being encrypted must not wait for the next send
+      if (FBackendHandle != nullptr)
+      {
+        ssh_crypto_flush(FBackendHandle, (MSec > 0));
+      }
       intptr_t Timeout = static_cast<intptr_t>(MSec);
       if (toplevel_callback_pending())
       {
@@ -2225,7 +2353,8 @@ UnicodeString TSecureShell::FuncToCompression(
   {
     return get_ssh1_compressing(FBackendHandle) ? L"ZLib" : L"";
   }
-  return reinterpret_cast<ssh_compress *>(const_cast<void *>(Compress)) == &ssh_zlib ? L"ZLib" : L"";
+  const ssh_compress *CompressFuncs = reinterpret_cast<const ssh_compress *>(Compress);
+  return (CompressFuncs == &ssh_zlib) || (CompressFuncs == &ssh_zlibx) ? L"ZLib" : L"";
 }
 
 TCipher TSecureShell::FuncToSsh1Cipher(const void *Cipher)
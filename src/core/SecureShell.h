@@ -18,6 +18,46 @@ typedef UINT_PTR SOCKET;
 typedef rde::vector<SOCKET> TSockets;
 struct TPuttyTranslation;
 
+// Received, not yet consumed data, kept in a chain of fixed-size segments,
+// so that neither appending nor consuming moves already buffered bytes
+class TSegmentedBuffer
+{
+NB_DISABLE_COPY(TSegmentedBuffer)
+public:
+  TSegmentedBuffer();
+  ~TSegmentedBuffer();
+
+  void Append(const uint8_t *Data, intptr_t Length);
+  intptr_t Read(uint8_t *Buf, intptr_t Length);
+  bool Peek(uint8_t *&Buf, intptr_t Length);
+  intptr_t Front(const uint8_t *&Buf) const;
+  void Clear();
+
+  intptr_t GetSize() const { return FSize; }
+  int64_t GetCoalesced() const { return FCoalesced; }
+  intptr_t GetAllocations() const { return FAllocations; }
+
+private:
+  struct TSegment
+  {
+    uint8_t *Data;
+    intptr_t Capacity;
+    intptr_t Start;
+    intptr_t End;
+  };
+  typedef rde::vector<TSegment> TSegments;
+  typedef rde::vector<uint8_t *> TSpareSegments;
+
+  TSegments FSegments;
+  TSpareSegments FSpare;
+  intptr_t FSize;
+  int64_t FCoalesced;
+  intptr_t FAllocations;
+
+  TSegment NewSegment(intptr_t Capacity);
+  void ReleaseSegment(const TSegment &Segment);
+};
+
 enum TSshImplementation
 {
   sshiUnknown,
@@ -65,12 +105,11 @@ private:
   intptr_t FWaitingForData;
   TSshImplementation FSshImplementation;
 
-  intptr_t PendLen;
-  intptr_t PendSize;
   intptr_t OutLen;
   uint8_t *OutPtr;
-  uint8_t *Pending;
+  mutable TSegmentedBuffer FPending;
   TSessionLog *FLog;
+  TTransferStatistics *FStatistics;
   TConfiguration *FConfiguration;
   bool FAuthenticating;
   bool FAuthenticated;
@@ -139,6 +178,7 @@ public:
   void KeepAlive();
   intptr_t Receive(uint8_t *Buf, intptr_t Length);
   bool Peek(uint8_t *&Buf, intptr_t Length) const;
+  intptr_t GetPendLen() const { return FPending.GetSize(); }
   UnicodeString ReceiveLine();
   void Send(const uint8_t *Buf, intptr_t Length);
   void SendSpecial(intptr_t Code);
@@ -204,5 +244,6 @@ public:
   TSshImplementation GetSshImplementation() const { return FSshImplementation; }
   bool GetUtfStrings() const { return FUtfStrings; }
   void SetUtfStrings(bool Value) { FUtfStrings = Value; }
+  void SetStatistics(TTransferStatistics *Value) { FStatistics = Value; }
 };
 
@@ -1,6 +1,7 @@
 #include <vcl.h>
 #pragma hdrstop
 
+#include <rdestl/map.h>
 #include <rdestl/vector.h>
 #include <Winhttp.h>
 
@@ -135,6 +136,8 @@ void TSessionData::Default()
   SetLogicalHostName(L"");
   SetChangeUsername(false);
   SetCompression(false);
+  SetCompressionLevel(0);
+  SetSshCryptoThread(false);
   SetSshProt(ssh2only);
   SetSsh2DES(false);
   SetSshNoUserAuth(false);
@@ -228,11 +231,14 @@ void TSessionData::Default()
   // SFTP
   SetSftpServer(L"");
   SetSFTPDownloadQueue(32);
+  SetSFTPDownloadQueueAuto(false);
+  SetSFTPBatchTransfer(false);
   SetSFTPUploadQueue(32);
   SetSFTPListingQueue(2);
   SetSFTPMaxVersion(::SFTPMaxVersion);
   SetSFTPMaxPacketSize(0);
   SetSFTPMinPacketSize(0);
+  SetSshMaxPacketSize(0);
 
   for (intptr_t Index = 0; Index < static_cast<intptr_t>(_countof(FSFTPBugs)); ++Index)
   {
@@ -324,6 +330,8 @@ void TSessionData::NonPersistant()
   PROPERTY(LogicalHostName); \
   PROPERTY(ChangeUsername); \
   PROPERTY(Compression); \
+  PROPERTY(CompressionLevel); \
+  PROPERTY(SshCryptoThread); \
   PROPERTY(SshProt); \
   PROPERTY(Ssh2DES); \
   PROPERTY(SshNoUserAuth); \
@@ -387,10 +395,13 @@ void TSessionData::NonPersistant()
   \
   PROPERTY(SftpServer); \
   PROPERTY(SFTPDownloadQueue); \
+  PROPERTY(SFTPDownloadQueueAuto); \
+  PROPERTY(SFTPBatchTransfer); \
   PROPERTY(SFTPUploadQueue); \
   PROPERTY(SFTPListingQueue); \
   PROPERTY(SFTPMaxVersion); \
   PROPERTY(SFTPMaxPacketSize); \
+  PROPERTY(SshMaxPacketSize); \
   \
   PROPERTY(Tunnel); \
   PROPERTY(TunnelHostName); \
@@ -622,6 +633,8 @@ void TSessionData::DoLoad(THierarchicalStorage *Storage, bool PuttyImport, bool
   SetGSSAPIFwdTGT(Storage->ReadBool("GSSAPIFwdTGT", Storage->ReadBool("GssapiFwd", Storage->ReadBool("SSPIFwdTGT", GetGSSAPIFwdTGT()))));
   SetChangeUsername(Storage->ReadBool("ChangeUsername", GetChangeUsername()));
   SetCompression(Storage->ReadBool("Compression", GetCompression()));
+  SetCompressionLevel(Storage->ReadInteger("CompressionLevel", GetCompressionLevel()));
+  SetSshCryptoThread(Storage->ReadBool("SshCryptoThread", GetSshCryptoThread()));
   TSshProt ASshProt = static_cast<TSshProt>(Storage->ReadInteger(L"SshProt", GetSshProt()));
   // Old sessions may contain the values correponding to the fallbacks we used to allow; migrate them
   if (ASshProt == ssh2deprecated)
@@ -755,7 +768,10 @@ void TSessionData::DoLoad(THierarchicalStorage *Storage, bool PuttyImport, bool
   SetSFTPMaxVersion(Storage->ReadInteger("SFTPMaxVersion", GetSFTPMaxVersion()));
   SetSFTPMinPacketSize(Storage->ReadInteger("SFTPMinPacketSize", GetSFTPMinPacketSize()));
   SetSFTPMaxPacketSize(Storage->ReadInteger("SFTPMaxPacketSize", GetSFTPMaxPacketSize()));
+  SetSshMaxPacketSize(Storage->ReadInteger("SshMaxPacketSize", GetSshMaxPacketSize()));
   SetSFTPDownloadQueue(Storage->ReadInteger("SFTPDownloadQueue", GetSFTPDownloadQueue()));
+  SetSFTPDownloadQueueAuto(Storage->ReadBool("SFTPDownloadQueueAuto", GetSFTPDownloadQueueAuto()));
+  SetSFTPBatchTransfer(Storage->ReadBool("SFTPBatchTransfer", GetSFTPBatchTransfer()));
   SetSFTPUploadQueue(Storage->ReadInteger("SFTPUploadQueue", GetSFTPUploadQueue()));
   SetSFTPListingQueue(Storage->ReadInteger("SFTPListingQueue", GetSFTPListingQueue()));
 
@@ -976,6 +992,8 @@ void TSessionData::DoSave(THierarchicalStorage *Storage,
 
   WRITE_DATA(Bool, ChangeUsername);
   WRITE_DATA(Bool, Compression);
+  WRITE_DATA(Integer, CompressionLevel);
+  WRITE_DATA(Bool, SshCryptoThread);
   WRITE_DATA(Integer, SshProt);
   WRITE_DATA(Bool, Ssh2DES);
   WRITE_DATA(Bool, SshNoUserAuth);
@@ -1112,7 +1130,10 @@ void TSessionData::DoSave(THierarchicalStorage *Storage,
     WRITE_DATA(Integer, SFTPMaxVersion);
     WRITE_DATA(Integer, SFTPMaxPacketSize);
     WRITE_DATA(Integer, SFTPMinPacketSize);
+    WRITE_DATA(Integer, SshMaxPacketSize);
     WRITE_DATA(Integer, SFTPDownloadQueue);
+    WRITE_DATA(Bool, SFTPDownloadQueueAuto);
+    WRITE_DATA(Bool, SFTPBatchTransfer);
     WRITE_DATA(Integer, SFTPUploadQueue);
     WRITE_DATA(Integer, SFTPListingQueue);
 
@@ -2453,6 +2474,16 @@ void TSessionData::SetCompression(bool Value)
   SET_SESSION_PROPERTY(Compression);
 }
 
+void TSessionData::SetCompressionLevel(intptr_t Value)
+{
+  SET_SESSION_PROPERTY(CompressionLevel);
+}
+
+void TSessionData::SetSshCryptoThread(bool Value)
+{
+  SET_SESSION_PROPERTY(SshCryptoThread);
+}
+
 void TSessionData::SetSshProt(TSshProt Value)
 {
   SET_SESSION_PROPERTY(SshProt);
@@ -3977,6 +4008,16 @@ void TSessionData::SetSFTPDownloadQueue(intptr_t Value)
   SET_SESSION_PROPERTY(SFTPDownloadQueue);
 }
 
+void TSessionData::SetSFTPDownloadQueueAuto(bool Value)
+{
+  SET_SESSION_PROPERTY(SFTPDownloadQueueAuto);
+}
+
+void TSessionData::SetSFTPBatchTransfer(bool Value)
+{
+  SET_SESSION_PROPERTY(SFTPBatchTransfer);
+}
+
 void TSessionData::SetSFTPUploadQueue(intptr_t Value)
 {
   SET_SESSION_PROPERTY(SFTPUploadQueue);
@@ -3997,6 +4038,11 @@ void TSessionData::SetSFTPMaxPacketSize(intptr_t Value)
   SET_SESSION_PROPERTY(SFTPMaxPacketSize);
 }
 
+void TSessionData::SetSshMaxPacketSize(intptr_t Value)
+{
+  SET_SESSION_PROPERTY(SshMaxPacketSize);
+}
+
 void TSessionData::SetSFTPBug(TSftpBug Bug, TAutoSwitch Value)
 {
   DebugAssert(Bug >= 0 && static_cast<uint32_t>(Bug) < _countof(FSFTPBugs));
@@ -4545,9 +4591,15 @@ void TStoredSessionList::Load(THierarchicalStorage *Storage,
 
     if (!AsModified)
     {
+      // Loaded->IndexOf for each site would be quadratic in the site count
+      rde::map<const TObject *, bool> LoadedSet;
+      for (intptr_t Index = 0; Index < Loaded->GetCount(); ++Index)
+      {
+        LoadedSet[static_cast<const TObject *>(Loaded->GetItem(Index))] = true;
+      }
       for (intptr_t Index = 0; Index < TObjectList::GetCount(); ++Index)
       {
-        if (Loaded->IndexOf(GetObj(Index)) < 0)
+        if (LoadedSet.find(GetObj(Index)) == LoadedSet.end())
         {
           Delete(Index);
           Index--;
@@ -4951,21 +5003,39 @@ void TStoredSessionList::SelectAll(bool Select)
 void TStoredSessionList::Import(TStoredSessionList *From,
      bool OnlySelected, TList *Imported)
 {
-  for (intptr_t Index = 0; Index < From->GetCount(); ++Index)
+  // sort once after all sites are added, as Load does
+  DebugAssert(FAutoSort);
+  FAutoSort = false;
+  try__finally
   {
-    if (!OnlySelected || From->GetSession(Index)->GetSelected())
+    SCOPE_EXIT
+    {
+      FAutoSort = true;
+      AlphaSort();
+    };
+    for (intptr_t Index = 0; Index < From->GetCount(); ++Index)
     {
-      TSessionData *Session = new TSessionData(L"");
-      Session->Assign(From->GetSession(Index));
-      Session->SetModified(true);
-      Session->MakeUniqueIn(this);
-      Add(Session);
-      if (Imported != nullptr)
+      if (!OnlySelected || From->GetSession(Index)->GetSelected())
       {
-        Imported->Add(Session);
+        TSessionData *Session = new TSessionData(L"");
+        Session->Assign(From->GetSession(Index));
+        Session->SetModified(true);
+        Session->MakeUniqueIn(this);
+        Add(Session);
+        if (Imported != nullptr)
+        {
+          Imported->Add(Session);
+        }
       }
     }
   }
+  __finally
+  {
+#if 0
+    AutoSort = true;
+    AlphaSort();
+#endif // #if 0
+  };
   // only modified, explicit
   Save(false, true);
 }
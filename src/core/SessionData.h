@@ -201,6 +201,8 @@ private:
   bool FGSSAPIFwdTGT;
   bool FChangeUsername;
   bool FCompression;
+  intptr_t FCompressionLevel;
+  bool FSshCryptoThread;
   TSshProt FSshProt;
   bool FSsh2DES;
   bool FSshNoUserAuth;
@@ -255,10 +257,13 @@ private:
   TDateTime FTimeDifference;
   bool FTimeDifferenceAuto;
   intptr_t FSFTPDownloadQueue;
+  bool FSFTPDownloadQueueAuto;
+  bool FSFTPBatchTransfer;
   intptr_t FSFTPUploadQueue;
   intptr_t FSFTPListingQueue;
   intptr_t FSFTPMaxVersion;
   intptr_t FSFTPMaxPacketSize;
+  intptr_t FSshMaxPacketSize;
   TDSTMode FDSTMode;
   TAutoSwitch FSFTPBugs[SFTP_BUG_COUNT];
   bool FDeleteToRecycleBin;
@@ -328,6 +333,8 @@ public:
   void SetGSSAPIFwdTGT(bool Value);
   void SetChangeUsername(bool Value);
   void SetCompression(bool Value);
+  void SetCompressionLevel(intptr_t Value);
+  void SetSshCryptoThread(bool Value);
   void SetSshProt(TSshProt Value);
   void SetSsh2DES(bool Value);
   void SetSshNoUserAuth(bool Value);
@@ -409,10 +416,13 @@ public:
   void SetResolveSymlinks(bool Value);
   void SetFollowDirectorySymlinks(bool Value);
   void SetSFTPDownloadQueue(intptr_t Value);
+  void SetSFTPDownloadQueueAuto(bool Value);
+  void SetSFTPBatchTransfer(bool Value);
   void SetSFTPUploadQueue(intptr_t Value);
   void SetSFTPListingQueue(intptr_t Value);
   void SetSFTPMaxVersion(intptr_t Value);
   void SetSFTPMaxPacketSize(intptr_t Value);
+  void SetSshMaxPacketSize(intptr_t Value);
   void SetSFTPBug(TSftpBug Bug, TAutoSwitch Value);
   TAutoSwitch GetSFTPBug(TSftpBug Bug) const;
   void SetSCPLsFullTime(TAutoSwitch Value);
@@ -613,6 +623,8 @@ public:
   __property bool GSSAPIFwdTGT = { read=FGSSAPIFwdTGT, write=SetGSSAPIFwdTGT };
   __property bool ChangeUsername  = { read=FChangeUsername, write=SetChangeUsername };
   __property bool Compression  = { read=FCompression, write=SetCompression };
+  __property intptr_t CompressionLevel = { read = FCompressionLevel, write = SetCompressionLevel };
+  __property bool SshCryptoThread = { read = FSshCryptoThread, write = SetSshCryptoThread };
   __property TSshProt SshProt  = { read=FSshProt, write=SetSshProt };
   __property bool UsesSsh = { read = GetUsesSsh };
   __property bool Ssh2DES  = { read=FSsh2DES, write=SetSsh2DES };
@@ -683,10 +695,13 @@ public:
   __property bool ResolveSymlinks = { read = FResolveSymlinks, write = SetResolveSymlinks };
   __property bool FollowDirectorySymlinks = { read = FFollowDirectorySymlinks, write = SetFollowDirectorySymlinks };
   __property intptr_t SFTPDownloadQueue = { read = FSFTPDownloadQueue, write = SetSFTPDownloadQueue };
+  __property bool SFTPDownloadQueueAuto = { read = FSFTPDownloadQueueAuto, write = SetSFTPDownloadQueueAuto };
+  __property bool SFTPBatchTransfer = { read = FSFTPBatchTransfer, write = SetSFTPBatchTransfer };
   __property intptr_t SFTPUploadQueue = { read = FSFTPUploadQueue, write = SetSFTPUploadQueue };
   __property intptr_t SFTPListingQueue = { read = FSFTPListingQueue, write = SetSFTPListingQueue };
   __property intptr_t SFTPMaxVersion = { read = FSFTPMaxVersion, write = SetSFTPMaxVersion };
   __property uintptr_t SFTPMaxPacketSize = { read = FSFTPMaxPacketSize, write = SetSFTPMaxPacketSize };
+  __property intptr_t SshMaxPacketSize = { read = FSshMaxPacketSize, write = SetSshMaxPacketSize };
   __property TAutoSwitch SFTPBug[TSftpBug Bug]  = { read=GetSFTPBug, write=SetSFTPBug };
   __property TAutoSwitch SCPLsFullTime = { read = FSCPLsFullTime, write = SetSCPLsFullTime };
   __property TAutoSwitch FtpListAll = { read = FFtpListAll, write = SetFtpListAll };
@@ -764,6 +779,8 @@ public:
   bool GetGSSAPIFwdTGT() const { return FGSSAPIFwdTGT; }
   bool GetChangeUsername() const { return FChangeUsername; }
   bool GetCompression() const { return FCompression; }
+  intptr_t GetCompressionLevel() const { return FCompressionLevel; }
+  bool GetSshCryptoThread() const { return FSshCryptoThread; }
   TSshProt GetSshProt() const { return FSshProt; }
   bool GetSsh2DES() const { return FSsh2DES; }
   bool GetSshNoUserAuth() const { return FSshNoUserAuth; }
@@ -814,11 +831,14 @@ public:
   bool GetResolveSymlinks() const { return FResolveSymlinks; }
   bool GetFollowDirectorySymlinks() const { return FFollowDirectorySymlinks; }
   intptr_t GetSFTPDownloadQueue() const { return FSFTPDownloadQueue; }
+  bool GetSFTPDownloadQueueAuto() const { return FSFTPDownloadQueueAuto; }
+  bool GetSFTPBatchTransfer() const { return FSFTPBatchTransfer; }
   intptr_t GetSFTPUploadQueue() const { return FSFTPUploadQueue; }
   intptr_t GetSFTPListingQueue() const { return FSFTPListingQueue; }
   intptr_t GetSFTPMaxVersion() const { return FSFTPMaxVersion; }
   intptr_t GetSFTPMinPacketSize() const { return FSFTPMinPacketSize; }
   intptr_t GetSFTPMaxPacketSize() const { return FSFTPMaxPacketSize; }
+  intptr_t GetSshMaxPacketSize() const { return FSshMaxPacketSize; }
   TAutoSwitch GetSCPLsFullTime() const { return FSCPLsFullTime; }
   TAutoSwitch GetFtpListAll() const { return FFtpListAll; }
   TAutoSwitch GetFtpHost() const { return FFtpHost; }
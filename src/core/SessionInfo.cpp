@@ -622,6 +622,90 @@ TSessionInfo::TSessionInfo() :
 {
 }
 
+TTransferStatistics::TTransferStatistics()
+{
+  Clear();
+}
+
+void TTransferStatistics::Clear()
+{
+  UploadedBytes = 0;
+  UploadedFiles = 0;
+  DownloadedBytes = 0;
+  DownloadedFiles = 0;
+  ListedDirectories = 0;
+  RoundTrips = 0;
+  NetworkWaitTime = 0;
+  DiskTime = 0;
+  QueueDepthSamples = 0;
+  QueueDepthTotal = 0;
+  QueueDepthMax = 0;
+  GapFills = 0;
+  Gaps = 0;
+  PacketAllocations = 0;
+}
+
+void TTransferStatistics::SampleQueueDepth(intptr_t Depth)
+{
+  QueueDepthSamples++;
+  QueueDepthTotal += Depth;
+  QueueDepthMax = Max(QueueDepthMax, static_cast<int64_t>(Depth));
+}
+
+UnicodeString TTransferStatistics::GetLogStr() const
+{
+  int64_t AverageQueueDepth =
+    (QueueDepthSamples > 0) ? (QueueDepthTotal / QueueDepthSamples) : 0;
+  int64_t TransferredBytes = UploadedBytes + DownloadedBytes;
+  int64_t PacketAllocationsPerGB =
+    (TransferredBytes > 0) ? static_cast<int64_t>(PacketAllocations * 1073741824.0 / TransferredBytes) : 0;
+  return FORMAT("Uploaded: %s bytes in %s files, Downloaded: %s bytes in %s files, "
+    "Listed directories: %s, Round trips: %s, Network wait: %s ms, Disk: %s ms, "
+    "Queue depth: %s average, %s max, Gap fills: %s for %s gaps, "
+    "Packet allocations: %s (%s per GB)",
+    ::Int64ToStr(UploadedBytes), ::Int64ToStr(UploadedFiles),
+    ::Int64ToStr(DownloadedBytes), ::Int64ToStr(DownloadedFiles),
+    ::Int64ToStr(ListedDirectories), ::Int64ToStr(RoundTrips),
+    ::Int64ToStr(NetworkWaitTime / 1000), ::Int64ToStr(DiskTime / 1000),
+    ::Int64ToStr(AverageQueueDepth), ::Int64ToStr(QueueDepthMax),
+    ::Int64ToStr(GapFills), ::Int64ToStr(Gaps),
+    ::Int64ToStr(PacketAllocations), ::Int64ToStr(PacketAllocationsPerGB));
+}
+
+static int64_t PerformanceCounterFrequency()
+{
+  static int64_t Frequency = 0;
+  if (Frequency == 0)
+  {
+    LARGE_INTEGER Value;
+    Frequency = (::QueryPerformanceFrequency(&Value) && (Value.QuadPart > 0)) ? Value.QuadPart : 1;
+  }
+  return Frequency;
+}
+
+static int64_t PerformanceCounter()
+{
+  LARGE_INTEGER Value;
+  ::QueryPerformanceCounter(&Value);
+  return Value.QuadPart;
+}
+
+TTransferStatisticsTimer::TTransferStatisticsTimer(int64_t *Counter) :
+  FCounter(Counter),
+  FStart((Counter != nullptr) ? PerformanceCounter() : 0)
+{
+}
+
+TTransferStatisticsTimer::~TTransferStatisticsTimer()
+{
+  if (FCounter != nullptr)
+  {
+    int64_t Elapsed = PerformanceCounter() - FStart;
+    int64_t Frequency = PerformanceCounterFrequency();
+    *FCounter += (Elapsed / Frequency) * 1000000 + ((Elapsed % Frequency) * 1000000) / Frequency;
+  }
+}
+
 TFileSystemInfo::TFileSystemInfo()
 {
   ClearArray(IsCapable);
@@ -1150,6 +1234,14 @@ void TSessionLog::DoAddStartupInfo(TSessionData *Data)
     {
       ADF("SSH protocol version: %s; Compression: %s",
         Data->GetSshProtStr(), BooleanToEngStr(Data->GetCompression()));
+      if (Data->GetCompression() && (Data->GetCompressionLevel() > 0))
+      {
+        ADF("Compression level: %d", Data->GetCompressionLevel());
+      }
+      if (Data->GetSshCryptoThread())
+      {
+        ADF("Encryption on separate thread: %s", BooleanToEngStr(Data->GetSshCryptoThread()));
+      }
       ADF("Bypass authentication: %s",
         BooleanToEngStr(Data->GetSshNoUserAuth()));
       ADF("Try agent: %s; Agent forwarding: %s; TIS/CryptoCard: %s; KI: %s; GSSAPI: %s",
@@ -1192,6 +1284,9 @@ void TSessionLog::DoAddStartupInfo(TSessionData *Data)
       }
       ADF("SFTP Bugs: %s", Bugs);
       ADF("SFTP Server: %s", Data->GetSftpServer().IsEmpty() ? UnicodeString(L"default") : Data->GetSftpServer());
+      ADF("SFTP Download queue: %d, Auto: %s",
+        ToInt(Data->GetSFTPDownloadQueue()), BooleanToEngStr(Data->GetSFTPDownloadQueueAuto()));
+      ADF("SFTP Batch transfer: %s", BooleanToEngStr(Data->GetSFTPBatchTransfer()));
     }
     bool FtpsOn = false;
     if (Data->GetFSProtocol() == fsFTP)
@@ -1453,6 +1548,32 @@ void TActionLog::AddFailure(Exception *E)
   }
 }
 
+void TActionLog::AddStatistics(const TTransferStatistics &Statistics)
+{
+  if (FLogging)
+  {
+    AddIndented(L"<statistics>");
+#define ADD_STATISTIC(NAME, VALUE) \
+      AddIndented(FORMAT(L"  <%s value=\"%s\" />", NAME, ::Int64ToStr(VALUE)))
+    ADD_STATISTIC(L"uploadedbytes", Statistics.UploadedBytes);
+    ADD_STATISTIC(L"uploadedfiles", Statistics.UploadedFiles);
+    ADD_STATISTIC(L"downloadedbytes", Statistics.DownloadedBytes);
+    ADD_STATISTIC(L"downloadedfiles", Statistics.DownloadedFiles);
+    ADD_STATISTIC(L"listeddirectories", Statistics.ListedDirectories);
+    ADD_STATISTIC(L"roundtrips", Statistics.RoundTrips);
+    ADD_STATISTIC(L"networkwaitus", Statistics.NetworkWaitTime);
+    ADD_STATISTIC(L"diskus", Statistics.DiskTime);
+    ADD_STATISTIC(L"queuedepthsamples", Statistics.QueueDepthSamples);
+    ADD_STATISTIC(L"queuedepthtotal", Statistics.QueueDepthTotal);
+    ADD_STATISTIC(L"queuedepthmax", Statistics.QueueDepthMax);
+    ADD_STATISTIC(L"gapfills", Statistics.GapFills);
+    ADD_STATISTIC(L"gaps", Statistics.Gaps);
+    ADD_STATISTIC(L"packetallocations", Statistics.PacketAllocations);
+#undef ADD_STATISTIC
+    AddIndented(L"</statistics>");
+  }
+}
+
 void TActionLog::AddMessages(UnicodeString Indent, TStrings *Messages)
 {
   for (intptr_t Index = 0; Index < Messages->GetCount(); ++Index)
@@ -36,6 +36,47 @@ struct NB_CORE_EXPORT TSessionInfo
   UnicodeString Certificate;
 };
 
+// Per-connection transfer counters, kept by TTerminal for the session lifetime
+struct NB_CORE_EXPORT TTransferStatistics
+{
+  CUSTOM_MEM_ALLOCATION_IMPL
+  TTransferStatistics();
+
+  void Clear();
+  void SampleQueueDepth(intptr_t Depth);
+  UnicodeString GetLogStr() const;
+
+  int64_t UploadedBytes;
+  int64_t UploadedFiles;
+  int64_t DownloadedBytes;
+  int64_t DownloadedFiles;
+  int64_t ListedDirectories;
+  int64_t RoundTrips;
+  // microseconds
+  int64_t NetworkWaitTime;
+  int64_t DiskTime;
+  int64_t QueueDepthSamples;
+  int64_t QueueDepthTotal;
+  int64_t QueueDepthMax;
+  int64_t GapFills;
+  int64_t Gaps;
+  // heap allocations made by the SSH packet layer
+  int64_t PacketAllocations;
+};
+
+// Adds time spent in its scope to a TTransferStatistics time counter
+class NB_CORE_EXPORT TTransferStatisticsTimer
+{
+  NB_DISABLE_COPY(TTransferStatisticsTimer)
+public:
+  explicit TTransferStatisticsTimer(int64_t *Counter);
+  ~TTransferStatisticsTimer();
+
+private:
+  int64_t *FCounter;
+  int64_t FStart;
+};
+
 enum TFSCapability
 {
   fcUserGroupListing = 0, fcModeChanging, fcGroupChanging,
@@ -51,7 +92,7 @@ enum TFSCapability
   fcModeChangingUpload, fcPreservingTimestampUpload, fcShellAnyCommand,
   fcSecondaryShell, fcRemoveCtrlZUpload, fcRemoveBOMUpload, fcMoveToQueue,
   fcLocking, fcPreservingTimestampDirs, fcResumeSupport,
-  fcChangePassword, fsSkipTransfer, fsParallelTransfers,
+  fcChangePassword, fsSkipTransfer, fsParallelTransfers, fsParallelSegments,
   fcCount,
 };
 
@@ -349,6 +390,7 @@ public:
   void AddFailure(TStrings *Messages);
   void BeginGroup(UnicodeString Name);
   void EndGroup();
+  void AddStatistics(const TTransferStatistics &Statistics);
 
 #if 0
   __property UnicodeString CurrentFileName = { read = FCurrentFileName };
@@ -5,6 +5,7 @@
 #include <Common.h>
 #include <Exceptions.h>
 #include <WideStrUtils.hpp>
+#include <rdestl/list.h>
 #include <memory>
 
 #include "SftpFileSystem.h"
@@ -1319,6 +1320,7 @@ public:
     std::unique_ptr<TSFTPQueuePacket> Request(FRequests->GetAs<TSFTPQueuePacket>(0));
     try__finally
     {
+      FFileSystem->FTerminal->GetStatistics()->SampleQueueDepth(FRequests->GetCount());
       FRequests->Delete(0);
       DebugAssert(Request.get());
       if (Token != nullptr)
@@ -1536,6 +1538,13 @@ private:
   bool FReceiveHandlerRegistered;
 };
 
+// Interval in which the adaptive download queue evaluates the measured
+// throughput and round-trip time
+static const DWORD DownloadQueueAdaptInterval = 1000;
+// Hard limits of the adaptive download queue
+static const intptr_t DownloadQueueMaxLen = 1024;
+static const int64_t DownloadQueueMaxInFlight = 64 * 1024 * 1024;
+
 class TSFTPDownloadQueue : public TSFTPFixedLenQueue
 {
   NB_DISABLE_COPY(TSFTPDownloadQueue)
@@ -1543,7 +1552,16 @@ public:
   explicit TSFTPDownloadQueue(TSFTPFileSystem *AFileSystem, uintptr_t CodePage) :
     TSFTPFixedLenQueue(AFileSystem, CodePage),
     OperationProgress(nullptr),
-    FTransferred(0)
+    FTransferred(0),
+    FReceived(0),
+    FEnd(-1),
+    FAdaptive(false),
+    FQueueLen(0),
+    FPreferredQueueLen(0),
+    FBlockSize(0),
+    FIntervalStart(0),
+    FIntervalBytes(0),
+    FMinLatency(0)
   {
   }
 
@@ -1551,12 +1569,22 @@ public:
   {
   }
 
+  // AEnd limits the requests to a range of the file, -1 = read up to the end
   bool Init(intptr_t QueueLen, RawByteString AHandle, int64_t ATransferred,
-    TFileOperationProgressType *AOperationProgress)
+    TFileOperationProgressType *AOperationProgress, bool Adaptive = false, int64_t AEnd = -1)
   {
     FHandle = AHandle;
     FTransferred = ATransferred;
+    FReceived = ATransferred;
+    FEnd = AEnd;
     OperationProgress = AOperationProgress;
+    FAdaptive = Adaptive;
+    FQueueLen = QueueLen;
+    FPreferredQueueLen = QueueLen;
+    FBlockSize = 0;
+    FIntervalStart = ::GetTickCount();
+    FIntervalBytes = 0;
+    FMinLatency = 0;
 
     return TSFTPFixedLenQueue::Init(QueueLen);
   }
@@ -1572,19 +1600,109 @@ public:
     void *Token;
     bool Result = TSFTPFixedLenQueue::ReceivePacket(Packet, SSH_FXP_DATA, asEOF, &Token);
     BlockSize = reinterpret_cast<uintptr_t>(Token);
+    if (Result && (Packet != nullptr) && (Packet->GetType() == SSH_FXP_DATA))
+    {
+      FReceived += BlockSize;
+    }
+    if (FAdaptive && !FSendTicks.empty())
+    {
+      // responses come in the order of requests
+      DWORD Latency = ::GetTickCount() - FSendTicks.front();
+      FSendTicks.pop_front();
+      if (Result && (Packet != nullptr) && (Packet->GetType() == SSH_FXP_DATA))
+      {
+        Adapt(static_cast<uint32_t>(BlockSize), Latency);
+      }
+    }
     return Result;
   }
 
 protected:
   virtual bool InitRequest(TSFTPQueuePacket *Request) override
   {
-    uint32_t BlockSize = FFileSystem->DownloadBlockSize(OperationProgress);
+    if ((FEnd >= 0) && (FTransferred >= FEnd))
+    {
+      return false;
+    }
+    uint32_t BlockSize = FFileSystem->DownloadBlockSize(OperationProgress, FBlockSize);
+    if ((FEnd >= 0) && (FTransferred + BlockSize > FEnd))
+    {
+      BlockSize = static_cast<uint32_t>(FEnd - FTransferred);
+    }
     InitRequest(Request, FTransferred, BlockSize);
     Request->Token = ToPtr(BlockSize);
     FTransferred += BlockSize;
     return true;
   }
 
+  virtual void SendPacket(TSFTPQueuePacket *Packet) override
+  {
+    if (FAdaptive)
+    {
+      FSendTicks.push_back(::GetTickCount());
+    }
+    TSFTPFixedLenQueue::SendPacket(Packet);
+  }
+
+  // Sizes the pipeline to about twice the bandwidth-delay product,
+  // where bandwidth is the throughput of the last interval and delay
+  // is the lowest response latency seen. While the pipeline is too shallow,
+  // the throughput grows with each enlargement, while it is too deep,
+  // queued responses inflate the latency and the pipeline shrinks.
+  void Adapt(uint32_t DataLen, DWORD Latency)
+  {
+    FIntervalBytes += DataLen;
+    if ((FMinLatency == 0) || (Latency < FMinLatency))
+    {
+      FMinLatency = Max(Latency, static_cast<DWORD>(1));
+    }
+
+    DWORD Now = ::GetTickCount();
+    DWORD Elapsed = Now - FIntervalStart;
+    if (Elapsed >= DownloadQueueAdaptInterval)
+    {
+      int64_t Throughput = (FIntervalBytes * 1000) / Elapsed;
+      int64_t TargetInFlight = (2 * Throughput * FMinLatency) / 1000;
+      // do not queue reads past the end of the file (or range)
+      int64_t Remaining = ((FEnd >= 0) ? FEnd : OperationProgress->GetTransferSize()) - FReceived;
+      TargetInFlight = Min(TargetInFlight, Remaining);
+      TargetInFlight = Max(Min(TargetInFlight, DownloadQueueMaxInFlight), static_cast<int64_t>(1));
+
+      // prefer more requests up to configured queue length,
+      // beyond that prefer larger blocks (capped by server's max read size);
+      // the speed limit is left to InitRequest, which applies it to each request
+      uint32_t BlockSize = FFileSystem->DownloadBlockSize(OperationProgress,
+        static_cast<uint32_t>(Max(TargetInFlight / FPreferredQueueLen, static_cast<int64_t>(1))), false);
+      if (BlockSize == 0)
+      {
+        BlockSize = DataLen;
+      }
+      intptr_t QueueLen = static_cast<intptr_t>((TargetInFlight + BlockSize - 1) / BlockSize);
+      // change gradually, at most twice up or down in one interval
+      QueueLen = Min(QueueLen, FQueueLen * 2);
+      QueueLen = Max(QueueLen, FQueueLen / 2);
+      // but drop the requests past the end at once
+      QueueLen = Min(QueueLen, static_cast<intptr_t>((Max(Remaining, static_cast<int64_t>(0)) + BlockSize - 1) / BlockSize));
+      QueueLen = Max(Min(QueueLen, DownloadQueueMaxLen), static_cast<intptr_t>(1));
+
+      if ((QueueLen != FQueueLen) || (BlockSize != FBlockSize))
+      {
+        FFileSystem->FTerminal->LogEvent(FORMAT(
+          L"Adjusting download queue to %d requests of %d bytes "
+          L"(throughput %s B/s, round-trip %d ms)",
+          ToInt(QueueLen), ToInt(BlockSize), ::Int64ToStr(Throughput), ToInt(FMinLatency)));
+        // negative value suppresses sending new requests until enough responses
+        // arrive, the positive value is sent with the next response
+        FMissedRequests += QueueLen - FQueueLen;
+        FQueueLen = QueueLen;
+        FBlockSize = BlockSize;
+      }
+
+      FIntervalStart = Now;
+      FIntervalBytes = 0;
+    }
+  }
+
   void InitRequest(TSFTPPacket *Request, int64_t Offset,
     uint32_t Size) const
   {
@@ -1602,7 +1720,18 @@ protected:
 private:
   TFileOperationProgressType *OperationProgress;
   int64_t FTransferred;
+  // offset up to which the responses were received
+  int64_t FReceived;
+  int64_t FEnd;
   RawByteString FHandle;
+  bool FAdaptive;
+  intptr_t FQueueLen;
+  intptr_t FPreferredQueueLen;
+  uint32_t FBlockSize;
+  rde::list<DWORD> FSendTicks;
+  DWORD FIntervalStart;
+  int64_t FIntervalBytes;
+  DWORD FMinLatency;
 };
 
 class TSFTPUploadQueue : public TSFTPAsynchronousQueue
@@ -1662,6 +1791,7 @@ protected:
       FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(READ_ERROR, FFileName), "",
       [&]()
       {
+        TTransferStatisticsTimer Timer(&FTerminal->GetStatistics()->DiskTime);
         BlockBuf.LoadStream(FStream, BlockSize, false);
       });
 
@@ -1851,6 +1981,87 @@ private:
   intptr_t FIndex;
 };
 
+class TSFTPReadSymlinksQueue : public TSFTPFixedLenQueue
+{
+  NB_DISABLE_COPY(TSFTPReadSymlinksQueue)
+public:
+  explicit TSFTPReadSymlinksQueue(TSFTPFileSystem *AFileSystem, uintptr_t CodePage) :
+    TSFTPFixedLenQueue(AFileSystem, CodePage),
+    FFileList(nullptr),
+    FIndex(0),
+    FStatPending(false)
+  {
+  }
+
+  virtual ~TSFTPReadSymlinksQueue()
+  {
+  }
+
+  bool Init(uintptr_t QueueLen, TList *AFileList)
+  {
+    FFileList = AFileList;
+
+    return TSFTPFixedLenQueue::Init(QueueLen);
+  }
+
+  bool ReceivePacket(TSFTPPacket *Packet, TRemoteFile *&File)
+  {
+    void *Token;
+    bool Result = TSFTPFixedLenQueue::ReceivePacket(Packet, -1, asAll, &Token);
+    File = get_as<TRemoteFile>(Token);
+    return Result;
+  }
+
+protected:
+  // Each symlink takes two requests, SSH_FXP_READLINK and SSH_FXP_STAT,
+  // the same as TSFTPFileSystem::ReadSymlink sends.
+  virtual bool InitRequest(TSFTPQueuePacket *Request) override
+  {
+    TRemoteFile *File = FFileList->GetAs<TRemoteFile>(FIndex);
+    UnicodeString FileName = FFileSystem->LocalCanonify(File->GetFullFileName());
+
+    if (!FStatPending)
+    {
+      File->SetLinkTo(L"");
+      Request->ChangeType(SSH_FXP_READLINK);
+      Request->AddPathString(FileName, FFileSystem->FUtfStrings);
+      FStatPending = true;
+    }
+    else
+    {
+      Request->ChangeType(SSH_FXP_STAT);
+      Request->AddPathString(FileName, FFileSystem->FUtfStrings);
+      if (FFileSystem->FVersion >= 4)
+      {
+        Request->AddCardinal(SSH_FILEXFER_ATTR_COMMON);
+      }
+      FStatPending = false;
+      ++FIndex;
+    }
+    Request->Token = File;
+
+    return true;
+  }
+
+  virtual bool SendRequest() override
+  {
+    bool Result =
+      (FIndex < FFileList->GetCount()) &&
+      TSFTPFixedLenQueue::SendRequest();
+    return Result;
+  }
+
+  virtual bool End(TSFTPPacket * /*Response*/) override
+  {
+    return (FRequests->GetCount() == 0);
+  }
+
+private:
+  TList *FFileList;
+  intptr_t FIndex;
+  bool FStatPending;
+};
+
 class TSFTPCalculateFilesChecksumQueue : public TSFTPFixedLenQueue
 {
   NB_DISABLE_COPY(TSFTPCalculateFilesChecksumQueue)
@@ -1998,6 +2209,25 @@ struct TSinkFileParams
 };
 #endif // #if 0
 //===========================================================================
+// OPEN request sent for the next file of a batch transfer,
+// while the current file is still being transferred
+struct TSFTPOpenAhead : public TObject
+{
+  NB_DISABLE_COPY(TSFTPOpenAhead)
+public:
+  explicit TSFTPOpenAhead(uintptr_t CodePage) :
+    OpenType(0),
+    Request(SSH_FXP_OPEN, CodePage),
+    Response(CodePage)
+  {
+  }
+
+  UnicodeString FileName;
+  SSH_FXF_TYPES OpenType;
+  TSFTPPacket Request;
+  TSFTPPacket Response;
+};
+//===========================================================================
 TSFTPFileSystem::TSFTPFileSystem(TTerminal *ATerminal) :
   TCustomFileSystem(OBJECT_CLASS_TSFTPFileSystem, ATerminal),
   FSecureShell(nullptr),
@@ -2017,7 +2247,11 @@ TSFTPFileSystem::TSFTPFileSystem(TTerminal *ATerminal) :
   FFixedPaths(nullptr),
   FMaxPacketSize(0),
   FSupportsStatVfsV2(false),
-  FSupportsHardlink(false)
+  FSupportsHardlink(false),
+  FOpenAhead(nullptr),
+  FOpenAheadFile(nullptr),
+  FOpenAheadFileSize(0),
+  FOpenAheadIndex(0)
 {
   FCodePage = GetSessionData()->GetCodePageAsNumber();
 }
@@ -2206,6 +2440,12 @@ void TSFTPFileSystem::Idle()
 
 void TSFTPFileSystem::ResetConnection()
 {
+  // handle opened ahead is lost with the connection
+  if (FOpenAhead != nullptr)
+  {
+    UnreserveResponse(&FOpenAhead->Response);
+    SAFE_DESTROY(FOpenAhead);
+  }
   // there must be no valid packet reservation at the end
   for (intptr_t Index = 0; Index < FPacketReservations->GetCount(); ++Index)
   {
@@ -2238,6 +2478,7 @@ bool TSFTPFileSystem::IsCapable(intptr_t Capability) const
     case fcResumeSupport:
     case fsSkipTransfer:
     case fsParallelTransfers:
+    case fsParallelSegments:
       return true;
 
     case fcRename:
@@ -2362,7 +2603,9 @@ inline void TSFTPFileSystem::BusyEnd()
 uint32_t TSFTPFileSystem::TransferBlockSize(uint32_t Overhead,
   TFileOperationProgressType *OperationProgress,
   uint32_t MinPacketSize,
-  uint32_t MaxPacketSize) const
+  uint32_t MaxPacketSize,
+  uint32_t PreferredSize,
+  bool LimitCPS) const
 {
   const uint32_t minPacketSize = MinPacketSize ? MinPacketSize : 32 * 1024;
 
@@ -2372,7 +2615,8 @@ uint32_t TSFTPFileSystem::TransferBlockSize(uint32_t Overhead,
   (void)AMinPacketSize;
   uint32_t AMaxPacketSize = FSecureShell->MaxPacketSize();
   bool MaxPacketSizeValid = (AMaxPacketSize > 0);
-  uint32_t Result = static_cast<uint32_t>(OperationProgress->CPS());
+  uint32_t Result =
+    (PreferredSize > 0) ? PreferredSize : static_cast<uint32_t>(OperationProgress->CPS());
 
   if ((MaxPacketSize > 0) &&
     ((MaxPacketSize < AMaxPacketSize) || !MaxPacketSizeValid))
@@ -2417,7 +2661,11 @@ uint32_t TSFTPFileSystem::TransferBlockSize(uint32_t Overhead,
     }
   }
 
-  Result = static_cast<uint32_t>(OperationProgress->AdjustToCPSLimit(Result));
+  // the limit takes the tokens, so apply it only to a block that is going to be sent
+  if (LimitCPS)
+  {
+    Result = static_cast<uint32_t>(OperationProgress->AdjustToCPSLimit(Result));
+  }
 
   return Result;
 }
@@ -2434,11 +2682,13 @@ uint32_t TSFTPFileSystem::UploadBlockSize(RawByteString Handle,
 }
 
 uint32_t TSFTPFileSystem::DownloadBlockSize(
-  TFileOperationProgressType *OperationProgress) const
+  TFileOperationProgressType *OperationProgress, uint32_t PreferredSize,
+  bool LimitCPS) const
 {
   uint32_t Result = TransferBlockSize(sizeof(uint32_t), OperationProgress,
       static_cast<uint32_t>(GetSessionData()->GetSFTPMinPacketSize()),
-      static_cast<uint32_t>(GetSessionData()->GetSFTPMaxPacketSize()));
+      static_cast<uint32_t>(GetSessionData()->GetSFTPMaxPacketSize()),
+      PreferredSize, LimitCPS);
   if (FSupport->Loaded && (FSupport->MaxReadSize > 0) &&
     (Result > FSupport->MaxReadSize))
   {
@@ -2461,6 +2711,7 @@ void TSFTPFileSystem::SendPacket(const TSFTPPacket *Packet)
     FUtfDisablingAnnounced = true;
   }
 
+  FTerminal->GetStatistics()->RoundTrips++;
   BusyStart();
   try__finally
   {
@@ -2684,7 +2935,8 @@ bool TSFTPFileSystem::PeekPacket()
   if (Result)
   {
     intptr_t Length = PacketLength(Buf, static_cast<SSH_FXP_TYPES>(-1));
-    Result = FSecureShell->Peek(Buf, 4 + Length);
+    // no need to have the packet contiguous, we only check it is complete
+    Result = (FSecureShell->GetPendLen() >= 4 + Length);
   }
   return Result;
 }
@@ -3616,6 +3868,8 @@ void TSFTPFileSystem::ReadDirectory(TRemoteFileList *FileList)
     intptr_t Total = 0;
     bool HasParentDirectory = false;
     TRemoteFile *File = nullptr;
+    bool ResolveSymlinks = FTerminal->GetResolvingSymlinks();
+    std::unique_ptr<TList> Symlinks(new TList());
 
     Packet.ChangeType(SSH_FXP_READDIR);
     Packet.AddString(Handle);
@@ -3637,28 +3891,28 @@ void TSFTPFileSystem::ReadDirectory(TRemoteFileList *FileList)
 
         uint32_t Count = ListingPacket.GetCardinal();
 
-        intptr_t ResolvedLinks = 0;
         for (uint32_t Index = 0; !isEOF && (Index < Count); ++Index)
         {
-          File = LoadFile(&ListingPacket, nullptr, L"", FileList);
+          // symlinks are resolved all at once, when the listing is complete
+          File = LoadFile(&ListingPacket, nullptr, L"", FileList, false);
           if (FTerminal->GetConfiguration()->GetActualLogProtocol() >= 1)
           {
             FTerminal->LogEvent(FORMAT("Read file '%s' from listing", File->GetFileName()));
           }
-          if (File->GetLinkedFile() != nullptr)
-          {
-            ResolvedLinks++;
-          }
           if (File->GetIsParentDirectory())
           {
             HasParentDirectory = true;
           }
           FileList->AddFile(File);
           Total++;
+          if (ResolveSymlinks && File->GetIsSymLink())
+          {
+            Symlinks->Add(File);
+          }
 
           if (Total % 10 == 0)
           {
-            FTerminal->DoReadDirectoryProgress(Total, ResolvedLinks, isEOF);
+            FTerminal->DoReadDirectoryProgress(Total, 0, isEOF);
             if (isEOF)
             {
               FTerminal->DoReadDirectoryProgress(-2, 0, isEOF);
@@ -3691,6 +3945,11 @@ void TSFTPFileSystem::ReadDirectory(TRemoteFileList *FileList)
     }
     while (!isEOF);
 
+    if (Symlinks->GetCount() > 0)
+    {
+      ReadSymlinks(Symlinks.get(), Total);
+    }
+
     if (Total == 0)
     {
       bool Failure = false;
@@ -3817,6 +4076,79 @@ void TSFTPFileSystem::ReadSymlink(TRemoteFile *SymlinkFile,
       base::UnixExtractFileName(SymlinkFile->GetLinkTo()));
 }
 
+// Resolves symlinks of a directory listing with requests pipelined,
+// instead of a round trip per symlink in TRemoteFile::FindLinkedFile.
+void TSFTPFileSystem::ReadSymlinks(TList *ASymlinks, intptr_t Total)
+{
+  TSFTPReadSymlinksQueue Queue(this, FCodePage);
+  try__finally
+  {
+    SCOPE_EXIT
+    {
+      Queue.DisposeSafe();
+    };
+
+    // two requests per symlink
+    static intptr_t ReadSymlinksQueueLen = 32;
+    if (Queue.Init(ReadSymlinksQueueLen, ASymlinks))
+    {
+      TRemoteFile *File = nullptr;
+      TSFTPPacket Packet(FCodePage);
+      intptr_t ResolvedLinks = 0;
+      bool Cancel = false;
+      bool Next;
+      do
+      {
+        Next = Queue.ReceivePacket(&Packet, File);
+        DebugAssert(File != nullptr);
+        if (Packet.GetType() == SSH_FXP_NAME)
+        {
+          if (Packet.GetCardinal() != 1)
+          {
+            FTerminal->FatalError(nullptr, LoadStr(SFTP_NON_ONE_FXP_NAME_PACKET));
+          }
+          File->SetLinkTo(Packet.GetPathString(FUtfStrings));
+          FTerminal->LogEvent(FORMAT("Link \"%s\" resolved to \"%s\".", File->GetFileName(), File->GetLinkTo()));
+        }
+        else if (Packet.GetType() == SSH_FXP_ATTRS)
+        {
+          // without the target path the link is broken, as with ReadSymlink
+          if (!File->GetLinkTo().IsEmpty())
+          {
+            File->SetLinkedFile(LoadFile(&Packet, File,
+              base::UnixExtractFileName(File->GetLinkTo())));
+            ResolvedLinks++;
+            if (ResolvedLinks % 10 == 0)
+            {
+              FTerminal->DoReadDirectoryProgress(Total, ResolvedLinks, Cancel);
+            }
+          }
+        }
+        else
+        {
+          DebugAssert(Packet.GetType() == SSH_FXP_STATUS);
+          GotStatusPacket(&Packet, asAll);
+          FTerminal->LogEvent(FORMAT("Cannot resolve symlink \"%s\".", File->GetFileName()));
+        }
+
+        if (Cancel)
+        {
+          // the listing is incomplete, as when cancelled while reading it
+          FTerminal->DoReadDirectoryProgress(-2, 0, Cancel);
+          Next = false;
+        }
+      }
+      while (Next);
+    }
+  }
+  __finally
+  {
+#if 0
+    Queue.DisposeSafe();
+#endif // #if 0
+  };
+}
+
 void TSFTPFileSystem::ReadFile(UnicodeString AFileName,
   TRemoteFile *&AFile)
 {
@@ -4522,6 +4854,11 @@ void TSFTPFileSystem::CopyToRemote(const TStrings *AFilesToCopy,
 {
   DebugAssert(AFilesToCopy && OperationProgress);
 
+  SCOPE_EXIT
+  {
+    SFTPSetOpenAheadCandidate(UnicodeString(), nullptr, 0);
+    SFTPDiscardOpenAhead();
+  };
   UnicodeString FullTargetDir = base::UnixIncludeTrailingBackslash(TargetDir);
   intptr_t Index = 0;
   while (AFilesToCopy && (Index < AFilesToCopy->GetCount()) && !OperationProgress->GetCancel())
@@ -4531,6 +4868,19 @@ void TSFTPFileSystem::CopyToRemote(const TStrings *AFilesToCopy,
     TRemoteFile *File = AFilesToCopy->GetAs<TRemoteFile>(Index);
     UnicodeString RealFileName = File ? File->GetFileName() : FileName;
     UnicodeString FileNameOnly = base::ExtractFileName(RealFileName, false);
+    if (GetSessionData()->GetSFTPBatchTransfer())
+    {
+      // directories are not matched
+      TSearchRecChecked SearchRec;
+      UnicodeString NextFileName;
+      if ((Index + 1 < AFilesToCopy->GetCount()) &&
+          (::FindFirstUnchecked(AFilesToCopy->GetString(Index + 1), faReadOnly | faHidden | faSysFile | faArchive, SearchRec) == 0))
+      {
+        NextFileName = AFilesToCopy->GetString(Index + 1);
+        base::FindClose(SearchRec);
+      }
+      SFTPSetOpenAheadCandidate(NextFileName, nullptr, SearchRec.Size);
+    }
     DebugAssert(!FAvoidBusy);
     FAvoidBusy = true;
 
@@ -5064,6 +5414,21 @@ void TSFTPFileSystem::SFTPSource(UnicodeString AFileName,
         &OpenParams);
       OperationProgress->Progress();
 
+      // Create the next file exclusively, while this one is transferred.
+      // If it exists already, the open fails and the regular open will take care of it.
+      // Files that would be transferred resumably go via a temporary name, skip them.
+      if (GetSessionData()->GetSFTPBatchTransfer() && !FOpenAheadFileName.IsEmpty() &&
+          FLAGCLEAR(Params, cpAppend | cpResume) && !CopyParam->AllowResume(FOpenAheadFileSize) &&
+          SFTPAllowLocalOpenAhead(CopyParam))
+      {
+        UnicodeString NextDestFileName =
+          FTerminal->ChangeFileName(
+            CopyParam, base::ExtractFileName(FOpenAheadFileName, false), osLocal,
+            FLAGSET(Flags, tfFirstLevel));
+        SFTPOpenAhead(LocalCanonify(TargetDir + NextDestFileName),
+          SSH_FXF_WRITE | SSH_FXF_CREAT | SSH_FXF_EXCL);
+      }
+
       if (OpenParams.RemoteFileName != RemoteFileName)
       {
         DebugAssert(!DoResume);
@@ -5385,15 +5750,13 @@ void TSFTPFileSystem::SFTPSource(UnicodeString AFileName,
   }
 }
 
-RawByteString TSFTPFileSystem::SFTPOpenRemoteFile(
+void TSFTPFileSystem::SFTPAddOpenRequest(TSFTPPacket *Packet,
   UnicodeString AFileName, SSH_FXF_TYPES OpenType, int64_t Size)
 {
-  TSFTPPacket Packet(SSH_FXP_OPEN, FCodePage);
-
-  Packet.AddPathString(AFileName, FUtfStrings);
+  Packet->AddPathString(AFileName, FUtfStrings);
   if (FVersion < 5)
   {
-    Packet.AddCardinal(OpenType);
+    Packet->AddCardinal(OpenType);
   }
   else
   {
@@ -5424,8 +5787,8 @@ RawByteString TSFTPFileSystem::SFTPOpenRemoteFile(
       FLAGMASK(FLAGSET(OpenType, SSH_FXF_APPEND), SSH_FXF_ACCESS_APPEND_DATA) |
       FLAGMASK(FLAGSET(OpenType, SSH_FXF_TEXT), SSH_FXF_ACCESS_TEXT_MODE);
 
-    Packet.AddCardinal(Access);
-    Packet.AddCardinal(Flags);
+    Packet->AddCardinal(Access);
+    Packet->AddCardinal(Flags);
   }
 
   bool SendSize =
@@ -5436,13 +5799,155 @@ RawByteString TSFTPFileSystem::SFTPOpenRemoteFile(
     // It's SFTP-6 attribute, so support structure should be available.
     // It's actually not with VShell. But VShell supports the SSH_FILEXFER_ATTR_ALLOCATION_SIZE.
     // All servers should support SSH_FILEXFER_ATTR_SIZE (SFTP < 6)
-    (!FSupport->Loaded || FLAGSET(FSupport->AttributeMask, Packet.AllocationSizeAttribute(FVersion)));
-  Packet.AddProperties(nullptr, nullptr, nullptr, nullptr, nullptr,
+    (!FSupport->Loaded || FLAGSET(FSupport->AttributeMask, Packet->AllocationSizeAttribute(FVersion)));
+  Packet->AddProperties(nullptr, nullptr, nullptr, nullptr, nullptr,
     SendSize ? &Size : nullptr, false, FVersion, FUtfStrings);
+}
+
+RawByteString TSFTPFileSystem::SFTPOpenRemoteFile(
+  UnicodeString AFileName, SSH_FXF_TYPES OpenType, int64_t Size)
+{
+  RawByteString Handle;
+  if (!SFTPUseOpenAhead(AFileName, OpenType, Handle))
+  {
+    TSFTPPacket Packet(SSH_FXP_OPEN, FCodePage);
+    SFTPAddOpenRequest(&Packet, AFileName, OpenType, Size);
+    SendPacketAndReceiveResponse(&Packet, &Packet, SSH_FXP_HANDLE);
+    Handle = Packet.GetFileHandle();
+  }
+  return Handle;
+}
+
+void TSFTPFileSystem::SFTPSetOpenAheadCandidate(UnicodeString AFileName,
+  const TRemoteFile *AFile, int64_t Size)
+{
+  if (GetSessionData()->GetSFTPBatchTransfer())
+  {
+    FOpenAheadFileName = AFileName;
+    FOpenAheadFile = AFile;
+    FOpenAheadFileSize = Size;
+  }
+}
+
+bool TSFTPFileSystem::SFTPAllowLocalOpenAhead(const TCopyParamType *CopyParam) const
+{
+  // The checks of TTerminal::AllowLocalFileTransfer, without its logging and prompts,
+  // the file goes through that once its turn comes.
+  // Excluded or skipped files must not be created on the server.
+  TSearchRecChecked SearchRec;
+  bool Result =
+    (::FindFirstUnchecked(FOpenAheadFileName, faReadOnly | faHidden | faSysFile | faArchive, SearchRec) == 0);
+  if (Result)
+  {
+    base::FindClose(SearchRec);
+    TFileMasks::TParams MaskParams;
+    MaskParams.Size = SearchRec.Size;
+    MaskParams.Modification = ::FileTimeToDateTime(SearchRec.FindData.ftLastWriteTime);
+    Result =
+      CopyParam->AllowTransfer(FTerminal->GetBaseFileName(FOpenAheadFileName), osLocal, false, MaskParams) &&
+      !CopyParam->SkipTransfer(FOpenAheadFileName, false);
+  }
+  return Result;
+}
 
-  SendPacketAndReceiveResponse(&Packet, &Packet, SSH_FXP_HANDLE);
+void TSFTPFileSystem::SFTPOpenAhead(UnicodeString AFileName, SSH_FXF_TYPES OpenType)
+{
+  // only one file ahead, anything pending was consumed or discarded
+  // by the SFTPOpenRemoteFile of the current file
+  if ((FOpenAhead == nullptr) && !AFileName.IsEmpty())
+  {
+    std::unique_ptr<TSFTPOpenAhead> OpenAhead(new TSFTPOpenAhead(FCodePage));
+    OpenAhead->FileName = AFileName;
+    OpenAhead->OpenType = OpenType;
+    SFTPAddOpenRequest(&OpenAhead->Request, AFileName, OpenType, -1);
+    SendPacket(&OpenAhead->Request);
+    ReserveResponse(&OpenAhead->Request, &OpenAhead->Response);
+    FOpenAhead = OpenAhead.release();
+  }
+}
+
+bool TSFTPFileSystem::SFTPUseOpenAhead(UnicodeString AFileName, SSH_FXF_TYPES OpenType,
+  RawByteString &Handle)
+{
+  bool Result = false;
+  if (FOpenAhead != nullptr)
+  {
+    bool Compatible;
+    if (FLAGSET(FOpenAhead->OpenType, SSH_FXF_WRITE))
+    {
+      // exclusively created file is new and empty,
+      // so it can stand for any non-appending write open
+      DebugAssert(FLAGSET(FOpenAhead->OpenType, SSH_FXF_CREAT | SSH_FXF_EXCL));
+      Compatible =
+        FLAGSET(OpenType, SSH_FXF_WRITE | SSH_FXF_CREAT) &&
+        FLAGCLEAR(OpenType, SSH_FXF_READ | SSH_FXF_APPEND) &&
+        (FLAGSET(OpenType, SSH_FXF_TEXT) == FLAGSET(FOpenAhead->OpenType, SSH_FXF_TEXT));
+    }
+    else
+    {
+      Compatible = (OpenType == FOpenAhead->OpenType);
+    }
 
-  return Packet.GetFileHandle();
+    if (!Compatible || (FOpenAhead->FileName != AFileName))
+    {
+      SFTPDiscardOpenAhead();
+    }
+    else
+    {
+      std::unique_ptr<TSFTPOpenAhead> OpenAhead(FOpenAhead);
+      FOpenAhead = nullptr;
+      ReceiveResponse(&OpenAhead->Request, &OpenAhead->Response, -1, asAll);
+      if (OpenAhead->Response.GetType() == SSH_FXP_HANDLE)
+      {
+        FTerminal->LogEvent(FORMAT("Using file \"%s\" opened ahead.", AFileName));
+        Handle = OpenAhead->Response.GetFileHandle();
+        Result = true;
+      }
+      // otherwise let the regular open fail (or succeed) on its own
+    }
+  }
+  return Result;
+}
+
+void TSFTPFileSystem::SFTPDiscardOpenAhead()
+{
+  if (FOpenAhead != nullptr)
+  {
+    std::unique_ptr<TSFTPOpenAhead> OpenAhead(FOpenAhead);
+    FOpenAhead = nullptr;
+    if (!FTerminal->GetActive())
+    {
+      UnreserveResponse(&OpenAhead->Response);
+    }
+    else
+    {
+      // Called also when unwinding, so never throws.
+      // Connection errors are reported by the next operation.
+      try
+      {
+        ReceiveResponse(&OpenAhead->Request, &OpenAhead->Response, -1, asAll);
+        if (OpenAhead->Response.GetType() == SSH_FXP_HANDLE)
+        {
+          FTerminal->LogEvent(FORMAT("Discarding file \"%s\" opened ahead.", OpenAhead->FileName));
+          TSFTPPacket CloseRequest(SSH_FXP_CLOSE, FCodePage);
+          CloseRequest.AddString(OpenAhead->Response.GetFileHandle());
+          SendPacket(&CloseRequest);
+          ReserveResponse(&CloseRequest, nullptr);
+          // we have created the file, remove it again
+          if (FLAGSET(OpenAhead->OpenType, SSH_FXF_WRITE))
+          {
+            TSFTPPacket RemoveRequest(SSH_FXP_REMOVE, FCodePage);
+            RemoveRequest.AddPathString(OpenAhead->FileName, FUtfStrings);
+            SendPacket(&RemoveRequest);
+            ReserveResponse(&RemoveRequest, nullptr);
+          }
+        }
+      }
+      catch (...)
+      {
+      }
+    }
+  }
 }
 
 intptr_t TSFTPFileSystem::SFTPOpenRemote(void *AOpenParams, void * /*Param2*/)
@@ -5707,12 +6212,39 @@ void TSFTPFileSystem::SFTPDirectorySource(UnicodeString DirectoryName,
       {
         base::FindClose(SearchRec);
       };
+      auto FindNext = [&]()
+      {
+        FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(LIST_DIR_ERROR, DirectoryName), "",
+        [&]()
+        {
+          FindOK = (::FindNextChecked(SearchRec) == 0);
+        });
+      };
+      bool BatchTransfer = GetSessionData()->GetSFTPBatchTransfer();
+
       while (FindOK && !OperationProgress->GetCancel())
       {
         UnicodeString FileName = DirectoryName + SearchRec.Name;
+        bool ProcessEntry = (SearchRec.Name != THISDIRECTORY) && (SearchRec.Name != PARENTDIRECTORY);
+        bool LookedAhead = false;
+        if (BatchTransfer)
+        {
+          // look one entry ahead, so that it can be opened while this one is transferred,
+          // on error, leave it to the regular FindNext below, after this entry is processed
+          DWORD FindResult = base::FindNext(SearchRec);
+          LookedAhead =
+            (FindResult == ERROR_SUCCESS) || (FindResult == ERROR_FILE_NOT_FOUND) || (FindResult == ERROR_NO_MORE_FILES);
+          if (LookedAhead)
+          {
+            FindOK = (FindResult == ERROR_SUCCESS);
+          }
+          SFTPSetOpenAheadCandidate(
+            (LookedAhead && FindOK && FLAGCLEAR(SearchRec.Attr, faDirectory)) ? DirectoryName + SearchRec.Name : UnicodeString(),
+            nullptr, LookedAhead ? SearchRec.Size : 0);
+        }
         try
         {
-          if ((SearchRec.Name != THISDIRECTORY) && (SearchRec.Name != PARENTDIRECTORY))
+          if (ProcessEntry)
           {
             SFTPSourceRobust(FileName, nullptr, DestFullName, CopyParam, Params, OperationProgress,
               Flags & ~tfFirstLevel);
@@ -5731,11 +6263,10 @@ void TSFTPFileSystem::SFTPDirectorySource(UnicodeString DirectoryName,
           }
         }
 
-        FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(LIST_DIR_ERROR, DirectoryName), "",
-        [&]()
+        if (!LookedAhead)
         {
-          FindOK = (::FindNextChecked(SearchRec) == 0);
-        });
+          FindNext();
+        }
       }
     }
     __finally
@@ -5784,6 +6315,11 @@ void TSFTPFileSystem::CopyToLocal(const TStrings *AFilesToCopy,
 {
   DebugAssert(AFilesToCopy && OperationProgress);
 
+  SCOPE_EXIT
+  {
+    SFTPSetOpenAheadCandidate(UnicodeString(), nullptr, 0);
+    SFTPDiscardOpenAhead();
+  };
   UnicodeString FullTargetDir = ::IncludeTrailingBackslash(TargetDir);
   intptr_t Index = 0;
   while (AFilesToCopy && (Index < AFilesToCopy->GetCount()) && !OperationProgress->GetCancel())
@@ -5791,6 +6327,11 @@ void TSFTPFileSystem::CopyToLocal(const TStrings *AFilesToCopy,
     bool Success = false;
     UnicodeString FileName = AFilesToCopy->GetString(Index);
     const TRemoteFile *File = AFilesToCopy->GetAs<TRemoteFile>(Index);
+    const TRemoteFile *NextFile =
+      (Index + 1 < AFilesToCopy->GetCount()) ? AFilesToCopy->GetAs<TRemoteFile>(Index + 1) : nullptr;
+    SFTPSetOpenAheadCandidate(
+      (NextFile != nullptr) ? LocalCanonify(AFilesToCopy->GetString(Index + 1)) : UnicodeString(),
+      NextFile, (NextFile != nullptr) ? NextFile->GetSize() : 0);
 
     DebugAssert(!FAvoidBusy);
     FAvoidBusy = true;
@@ -5834,6 +6375,43 @@ void TSFTPFileSystem::CopyToLocal(const TStrings *AFilesToCopy,
   }
 }
 
+void TSFTPFileSystem::CopyToLocalSegment(const TParallelSegment &Segment,
+  TParallelOperation *ParallelOperation, TFileOperationProgressType *OperationProgress)
+{
+  UnicodeString OnlyFileName = base::UnixExtractFileName(Segment.FileName);
+  RawByteString RemoteHandle;
+  FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(SFTP_OPEN_FILE_ERROR, Segment.FileName), "",
+  [&]()
+  {
+    RemoteHandle = SFTPOpenRemoteFile(Segment.FileName, SSH_FXF_READ);
+    OperationProgress->Progress();
+  });
+
+  try__finally
+  {
+    SCOPE_EXIT
+    {
+      if (FTerminal->GetActive())
+      {
+        // do not wait for response
+        SFTPCloseRemote(RemoteHandle, OnlyFileName, OperationProgress,
+          true, true, nullptr);
+      }
+    };
+    SFTPSinkRange(RemoteHandle, Segment, ParallelOperation, OperationProgress);
+  }
+  __finally
+  {
+#if 0
+    if (FTerminal->Active)
+    {
+      SFTPCloseRemote(RemoteHandle, OnlyFileName, OperationProgress,
+        true, true, nullptr);
+    }
+#endif // #if 0
+  };
+}
+
 void TSFTPFileSystem::SFTPSinkRobust(UnicodeString AFileName,
   const TRemoteFile *AFile, UnicodeString TargetDir,
   const TCopyParamType *CopyParam, intptr_t Params,
@@ -6034,6 +6612,7 @@ void TSFTPFileSystem::SFTPSink(UnicodeString AFileName,
     HANDLE LocalFileHandle = INVALID_HANDLE_VALUE;
     TStream *FileStream = nullptr;
     bool DeleteLocalFile = false;
+    bool Segmented = false;
     RawByteString RemoteHandle;
     UnicodeString LocalFileName = DestFullName;
     TOverwriteMode OverwriteMode = omOverwrite;
@@ -6048,7 +6627,8 @@ void TSFTPFileSystem::SFTPSink(UnicodeString AFileName,
         {
           SAFE_DESTROY(FileStream);
         }
-        if (DeleteLocalFile && (!ResumeAllowed || OperationProgress->GetLocallyUsed() == 0) &&
+        // partially downloaded segmented file cannot be resumed, as it is preallocated
+        if (DeleteLocalFile && (!ResumeAllowed || (OperationProgress->GetLocallyUsed() == 0) || Segmented) &&
           (OverwriteMode == omOverwrite))
         {
           FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(CORE_DELETE_LOCAL_FILE_ERROR, LocalFileName), "",
@@ -6131,6 +6711,51 @@ void TSFTPFileSystem::SFTPSink(UnicodeString AFileName,
         OperationProgress->Progress();
       });
 
+      if (GetSessionData()->GetSFTPBatchTransfer())
+      {
+        // First level candidate is set by CopyToLocal,
+        // files of a directory are transferred in the listing order
+        if (FLAGCLEAR(Flags, tfFirstLevel))
+        {
+          TRemoteFileList *FileList = AFile->GetDirectory();
+          const TRemoteFile *NextFile = nullptr;
+          intptr_t NextIndex = 0;
+          if (FileList != nullptr)
+          {
+            // usually the current file was the candidate of the previous one
+            NextIndex =
+              (((FOpenAheadFile == AFile) && (FOpenAheadIndex < FileList->GetCount()) &&
+                (FileList->GetFile(FOpenAheadIndex) == AFile)) ? FOpenAheadIndex : FileList->IndexOf(AFile)) + 1;
+            if ((NextIndex > 0) && (NextIndex < FileList->GetCount()))
+            {
+              NextFile = FileList->GetFile(NextIndex);
+            }
+          }
+          SFTPSetOpenAheadCandidate(
+            (NextFile != nullptr) ? base::UnixExtractFilePath(AFileName) + NextFile->GetFileName() : UnicodeString(),
+            NextFile, (NextFile != nullptr) ? NextFile->GetSize() : 0);
+          FOpenAheadIndex = NextIndex;
+        }
+
+        const TRemoteFile *NextFile = FOpenAheadFile;
+        if ((NextFile != nullptr) && !NextFile->GetIsDirectory())
+        {
+          TFileMasks::TParams NextMaskParams;
+          NextMaskParams.Size = NextFile->GetSize();
+          NextMaskParams.Modification = NextFile->GetModification();
+          UnicodeString NextBaseFileName = FTerminal->GetBaseFileName(FOpenAheadFileName);
+          if (CopyParam->AllowTransfer(NextBaseFileName, osRemote, false, NextMaskParams))
+          {
+            SSH_FXF_TYPES NextOpenType = SSH_FXF_READ;
+            if ((FVersion >= 4) && CopyParam->UseAsciiTransfer(NextBaseFileName, osRemote, NextMaskParams))
+            {
+              NextOpenType |= SSH_FXF_TEXT;
+            }
+            SFTPOpenAhead(FOpenAheadFileName, NextOpenType);
+          }
+        }
+      }
+
       TDateTime Modification;
       FILETIME AcTime;
       ClearStruct(AcTime);
@@ -6267,7 +6892,26 @@ void TSFTPFileSystem::SFTPSink(UnicodeString AFileName,
 
       FileStream = new TSafeHandleStream(LocalFileHandle);
 
+      TParallelOperation *ParallelOperation = FTerminal->GetParallelOperation();
+      int64_t ParallelTransferThreshold = FTerminal->GetConfiguration()->GetParallelTransferThreshold();
+      Segmented =
+        (ParallelOperation != nullptr) &&
+        (ParallelTransferThreshold > 0) &&
+        (OperationProgress->GetTransferSize() >= ParallelTransferThreshold) &&
+        !OperationProgress->GetAsciiTransfer() &&
+        !ResumeTransfer &&
+        (OverwriteMode == omOverwrite) &&
+        IsCapable(fsParallelSegments);
+      if (Segmented)
+      {
+        SFTPSinkSegmented(AFileName, RemoteHandle, LocalFileHandle, LocalFileName, ParallelOperation, OperationProgress);
+        SFTPCloseRemote(RemoteHandle, DestFileName, OperationProgress,
+          true, true, nullptr);
+        RemoteHandle.Clear(); // do not close file again in __finally block
+      }
+
       // at end of this block queue is discarded
+      if (!Segmented)
       {
         TSFTPDownloadQueue Queue(this, FCodePage);
         try__finally
@@ -6290,7 +6934,7 @@ void TSFTPFileSystem::SFTPSink(UnicodeString AFileName,
             QueueLen = 1;
           }
           Queue.Init(QueueLen, RemoteHandle, OperationProgress->GetTransferredSize(),
-            OperationProgress);
+            OperationProgress, GetSessionData()->GetSFTPDownloadQueueAuto());
 
           bool Eof = false;
           bool PrevIncomplete = false;
@@ -6397,6 +7041,7 @@ void TSFTPFileSystem::SFTPSink(UnicodeString AFileName,
               FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(WRITE_ERROR, LocalFileName), "",
               [&]()
               {
+                TTransferStatisticsTimer Timer(&FTerminal->GetStatistics()->DiskTime);
                 BlockBuf.WriteToStream(FileStream, BlockBuf.GetSize());
               });
 
@@ -6421,6 +7066,8 @@ void TSFTPFileSystem::SFTPSink(UnicodeString AFileName,
             FTerminal->LogEvent(FORMAT(
                 L"%d requests to fill %d data gaps were issued.",
                 GapFillCount, GapCount));
+            FTerminal->GetStatistics()->GapFills += GapFillCount;
+            FTerminal->GetStatistics()->Gaps += GapCount;
           }
         }
         __finally
@@ -6513,6 +7160,271 @@ void TSFTPFileSystem::SFTPSink(UnicodeString AFileName,
   }
 }
 
+// The handle is shared by all connections downloading segments of the file,
+// so the writes cannot rely on the file pointer
+static void WriteLocalFileAt(HANDLE LocalFileHandle, int64_t Offset, const void *Buffer, uint32_t Size)
+{
+  OVERLAPPED Overlapped;
+  ClearStruct(Overlapped);
+  Overlapped.Offset = static_cast<DWORD>(Offset & 0xFFFFFFFF);
+  Overlapped.OffsetHigh = static_cast<DWORD>(Offset >> 32);
+  DWORD Written = 0;
+  THROWOSIFFALSE(::WriteFile(LocalFileHandle, Buffer, Size, &Written, &Overlapped));
+  DebugAssert(Written == Size);
+}
+
+void TSFTPFileSystem::SFTPSinkRange(RawByteString RemoteHandle, const TParallelSegment &Segment,
+  TParallelOperation *ParallelOperation, TFileOperationProgressType *OperationProgress)
+{
+  int64_t End = (Segment.Length >= 0) ? (Segment.Offset + Segment.Length) : -1;
+  int64_t Position = Segment.Offset;
+
+  // at end of this block queue is discarded
+  {
+    TSFTPDownloadQueue Queue(this, FCodePage);
+    try__finally
+    {
+      SCOPE_EXIT
+      {
+        Queue.DisposeSafe();
+      };
+      TSFTPPacket DataPacket(FCodePage);
+
+      intptr_t QueueLen;
+      if (End >= 0)
+      {
+        uintptr_t BlSize = DownloadBlockSize(OperationProgress);
+        QueueLen = static_cast<intptr_t>(Segment.Length / (BlSize != 0 ? BlSize : 1)) + 1;
+        if (QueueLen > GetSessionData()->GetSFTPDownloadQueue())
+        {
+          QueueLen = GetSessionData()->GetSFTPDownloadQueue();
+        }
+      }
+      else
+      {
+        // the rest of a file that has grown since the listing, usually nothing
+        QueueLen = 1;
+      }
+      if (QueueLen < 1)
+      {
+        QueueLen = 1;
+      }
+      Queue.Init(QueueLen, RemoteHandle, Position,
+        OperationProgress, GetSessionData()->GetSFTPDownloadQueueAuto(), End);
+
+      bool Eof = false;
+      int32_t GapFillCount = 0;
+      int32_t GapCount = 0;
+      uint32_t MissingLen = 0;
+      uintptr_t BlockSize = 0;
+
+      while (!Eof && ((End < 0) || (Position < End)))
+      {
+        if (MissingLen > 0)
+        {
+          Queue.InitFillGapRequest(Position, MissingLen, &DataPacket);
+          GapFillCount++;
+          SendPacketAndReceiveResponse(&DataPacket, &DataPacket,
+            SSH_FXP_DATA, asEOF);
+        }
+        else
+        {
+          Queue.ReceivePacket(&DataPacket, BlockSize);
+        }
+
+        if (DataPacket.GetType() == SSH_FXP_STATUS)
+        {
+          // must be SSH_FX_EOF, any other status packet would raise exception
+          Eof = true;
+          if (End >= 0)
+          {
+            // the file has shrunk since the listing
+            FTerminal->LogEvent(FORMAT(
+                L"Reached end of file at offset %s, before end of segment at %s",
+                ::Int64ToStr(Position), ::Int64ToStr(End)));
+            FTerminal->TerminalError(nullptr, LoadStr(SFTP_INCOMPLETE_BEFORE_EOF));
+          }
+        }
+        else
+        {
+          uint32_t DataLen = DataPacket.GetCardinal();
+          if (MissingLen > 0)
+          {
+            DebugAssert(DataLen <= MissingLen);
+            MissingLen -= DataLen;
+          }
+          else if (DataLen < BlockSize)
+          {
+            // the requests never cross the end of the range,
+            // so getting less than requested is always a gap
+            GapCount++;
+            MissingLen = static_cast<uint32_t>(BlockSize - DataLen);
+          }
+
+          DebugAssert((End < 0) || (Position + DataLen <= End));
+          const void *Data = DataPacket.GetNextData(DataLen);
+          FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(WRITE_ERROR, Segment.LocalFileName), "",
+          [&]()
+          {
+            TTransferStatisticsTimer Timer(&FTerminal->GetStatistics()->DiskTime);
+            WriteLocalFileAt(Segment.LocalFileHandle, Position, Data, DataLen);
+          });
+          DataPacket.DataConsumed(DataLen);
+          Position += DataLen;
+
+          OperationProgress->AddTransferred(DataLen);
+          OperationProgress->AddLocallyUsed(DataLen);
+
+          if ((End < 0) && (FVersion >= 6) && DataPacket.CanGetBool() && (MissingLen == 0))
+          {
+            Eof = DataPacket.GetBool();
+          }
+        }
+
+        if (OperationProgress->GetCancel() != csContinue)
+        {
+          if (OperationProgress->ClearCancelFile())
+          {
+            ThrowSkipFileNull();
+          }
+          else
+          {
+            Abort();
+          }
+        }
+        // the owner of the file gave up
+        if (ParallelOperation->IsSegmentCancelled(Segment))
+        {
+          Abort();
+        }
+      }
+
+      if (GapCount > 0)
+      {
+        FTerminal->LogEvent(FORMAT(
+            L"%d requests to fill %d data gaps were issued.",
+            GapFillCount, GapCount));
+        FTerminal->GetStatistics()->GapFills += GapFillCount;
+        FTerminal->GetStatistics()->Gaps += GapCount;
+      }
+    }
+    __finally
+    {
+#if 0
+      Queue.DisposeSafe();
+#endif // #if 0
+    };
+    // queue is discarded here
+  }
+}
+
+void TSFTPFileSystem::SFTPSinkSegmented(UnicodeString AFileName, RawByteString RemoteHandle,
+  HANDLE LocalFileHandle, UnicodeString LocalFileName,
+  TParallelOperation *ParallelOperation, TFileOperationProgressType *OperationProgress)
+{
+  int64_t Size = OperationProgress->GetTransferSize();
+  FTerminal->LogEvent(FORMAT("Downloading \"%s\" in segments over parallel connections.", AFileName));
+
+  // allocate the whole file, so that the segments can be written in any order
+  FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(WRITE_ERROR, LocalFileName), "",
+  [&]()
+  {
+    THROWOSIFFALSE((::FileSeek(LocalFileHandle, Size, FILE_BEGIN) == Size) && ::SetEndOfFile(LocalFileHandle));
+  });
+
+  void *Token = ParallelOperation->AddSegmentedFile(AFileName, LocalFileName, LocalFileHandle, Size);
+  try__finally
+  {
+    SCOPE_EXIT
+    {
+      ParallelOperation->RemoveSegmentedFile(Token);
+    };
+
+    // segments done by this and by the other connections, as already added to the progress
+    int64_t OwnDone = 0;
+    int64_t OthersDone = 0;
+    bool Continue = true;
+    while (Continue)
+    {
+      TParallelSegment Segment;
+      intptr_t GotNext = ParallelOperation->GetNextSegment(Token, Segment);
+      if (GotNext > 0)
+      {
+        bool Success = false;
+        try__finally
+        {
+          SCOPE_EXIT
+          {
+            ParallelOperation->SegmentDone(Segment, Success);
+          };
+          SFTPSinkRange(RemoteHandle, Segment, ParallelOperation, OperationProgress);
+          Success = true;
+          OwnDone += Segment.Length;
+        }
+        __finally
+        {
+#if 0
+          ParallelOperation->SegmentDone(Segment, Success);
+#endif // #if 0
+        };
+      }
+      else if (GotNext == 0)
+      {
+        if (OperationProgress->GetCancel() != csContinue)
+        {
+          if (OperationProgress->ClearCancelFile())
+          {
+            ThrowSkipFileNull();
+          }
+          else
+          {
+            Abort();
+          }
+        }
+        ParallelOperation->WaitForSegmentChange(Token, GUIUpdateInterval);
+      }
+      else
+      {
+        Continue = false;
+      }
+
+      // the other connections have added their data to the totals already,
+      // here it is added to the progress of the file only
+      int64_t Done = ParallelOperation->GetSegmentsDone(Token) - OwnDone;
+      if (Done > OthersDone)
+      {
+        OperationProgress->AddTransferred(Done - OthersDone, false);
+        OperationProgress->AddLocallyUsed(Done - OthersDone);
+        OthersDone = Done;
+      }
+    }
+
+    int64_t LocalSize = ::FileSeek(LocalFileHandle, 0, FILE_END);
+    if (!DebugAlwaysTrue(OwnDone + OthersDone == Size) || (LocalSize != Size))
+    {
+      FTerminal->LogEvent(FORMAT("Segmented download is incomplete, %s of %s bytes downloaded, local file has %s bytes.",
+        ::Int64ToStr(OwnDone + OthersDone), ::Int64ToStr(Size), ::Int64ToStr(LocalSize)));
+      FTerminal->TerminalError(nullptr, FMTLOAD(WRITE_ERROR, LocalFileName));
+    }
+    FTerminal->LogEvent(FORMAT("All segments downloaded, %s bytes by other connections.", ::Int64ToStr(OthersDone)));
+
+    // the file may have grown since the listing
+    TParallelSegment Tail;
+    Tail.FileName = AFileName;
+    Tail.LocalFileName = LocalFileName;
+    Tail.LocalFileHandle = LocalFileHandle;
+    Tail.Offset = Size;
+    Tail.Length = -1;
+    SFTPSinkRange(RemoteHandle, Tail, ParallelOperation, OperationProgress);
+  }
+  __finally
+  {
+#if 0
+    ParallelOperation->RemoveSegmentedFile(Token);
+#endif // #if 0
+  };
+}
+
 void TSFTPFileSystem::SFTPSinkFile(UnicodeString AFileName,
   const TRemoteFile *AFile, void *Param)
 {
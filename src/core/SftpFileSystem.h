@@ -13,6 +13,7 @@ typedef uint32_t ACE4_TYPES;
 class TSFTPPacket;
 struct TOverwriteFileParams;
 struct TSFTPSupport;
+struct TSFTPOpenAhead;
 class TSecureShell;
 
 #if 0
@@ -28,6 +29,7 @@ class TSFTPFileSystem : public TCustomFileSystem
   friend class TSFTPUploadQueue;
   friend class TSFTPDownloadQueue;
   friend class TSFTPLoadFilesPropertiesQueue;
+  friend class TSFTPReadSymlinksQueue;
   friend class TSFTPCalculateFilesChecksumQueue;
   friend class TSFTPBusy;
 public:
@@ -63,6 +65,8 @@ public:
     UnicodeString TargetDir, const TCopyParamType *CopyParam,
     intptr_t Params, TFileOperationProgressType *OperationProgress,
     TOnceDoneOperation &OnceDoneOperation) override;
+  virtual void CopyToLocalSegment(const TParallelSegment &Segment,
+    TParallelOperation *ParallelOperation, TFileOperationProgressType *OperationProgress) override;
   virtual void CopyToRemote(const TStrings *AFilesToCopy,
     UnicodeString TargetDir, const TCopyParamType *CopyParam,
     intptr_t Params, TFileOperationProgressType *OperationProgress,
@@ -128,6 +132,11 @@ protected:
   bool FSupportsHardlink;
   std::unique_ptr<TStringList> FChecksumAlgs;
   std::unique_ptr<TStringList> FChecksumSftpAlgs;
+  TSFTPOpenAhead *FOpenAhead;
+  UnicodeString FOpenAheadFileName;
+  const TRemoteFile *FOpenAheadFile;
+  int64_t FOpenAheadFileSize;
+  intptr_t FOpenAheadIndex;
 
   void SendCustomReadFile(TSFTPPacket *Packet, TSFTPPacket *Response,
     uint32_t Flags);
@@ -169,6 +178,7 @@ protected:
     TFileOperationProgressType *OperationProgress, bool FirstLevel);
   void RegisterChecksumAlg(UnicodeString Alg, UnicodeString SftpAlg);
   void DoDeleteFile(UnicodeString AFileName, SSH_FXP_TYPES Type);
+  void ReadSymlinks(TList *ASymlinks, intptr_t Total);
 
   void SFTPSourceRobust(UnicodeString AFileName,
     const TRemoteFile *AFile,
@@ -181,9 +191,18 @@ protected:
     TOverwriteFileParams &FileParams,
     TFileOperationProgressType *OperationProgress, uintptr_t Flags,
     TUploadSessionAction &Action, bool &ChildError);
+  void SFTPAddOpenRequest(TSFTPPacket *Packet, UnicodeString AFileName,
+    SSH_FXF_TYPES OpenType, int64_t Size);
   RawByteString SFTPOpenRemoteFile(UnicodeString AFileName,
     SSH_FXF_TYPES OpenType, int64_t Size = -1);
   intptr_t SFTPOpenRemote(void *AOpenParams, void *Param2);
+  bool SFTPAllowLocalOpenAhead(const TCopyParamType *CopyParam) const;
+  void SFTPOpenAhead(UnicodeString AFileName, SSH_FXF_TYPES OpenType);
+  bool SFTPUseOpenAhead(UnicodeString AFileName, SSH_FXF_TYPES OpenType,
+    RawByteString &Handle);
+  void SFTPDiscardOpenAhead();
+  void SFTPSetOpenAheadCandidate(UnicodeString AFileName,
+    const TRemoteFile *AFile, int64_t Size);
   void SFTPCloseRemote(RawByteString Handle,
     UnicodeString AFileName, TFileOperationProgressType *OperationProgress,
     bool TransferFinished, bool Request, TSFTPPacket *Packet);
@@ -205,6 +224,11 @@ protected:
     const TCopyParamType *CopyParam, intptr_t Params,
     TFileOperationProgressType *OperationProgress, uintptr_t Flags,
     TDownloadSessionAction &Action, bool &ChildError);
+  void SFTPSinkSegmented(UnicodeString AFileName, RawByteString RemoteHandle,
+    HANDLE LocalFileHandle, UnicodeString LocalFileName,
+    TParallelOperation *ParallelOperation, TFileOperationProgressType *OperationProgress);
+  void SFTPSinkRange(RawByteString RemoteHandle, const TParallelSegment &Segment,
+    TParallelOperation *ParallelOperation, TFileOperationProgressType *OperationProgress);
   void SFTPSinkFile(UnicodeString AFileName,
     const TRemoteFile *AFile, void *Param);
   char *GetEOL() const;
@@ -213,11 +237,14 @@ protected:
   uint32_t TransferBlockSize(uint32_t Overhead,
     TFileOperationProgressType *OperationProgress,
     uint32_t MinPacketSize = 0,
-    uint32_t MaxPacketSize = 0) const;
+    uint32_t MaxPacketSize = 0,
+    uint32_t PreferredSize = 0,
+    bool LimitCPS = true) const;
   uint32_t UploadBlockSize(RawByteString Handle,
     TFileOperationProgressType *OperationProgress) const;
   uint32_t DownloadBlockSize(
-    TFileOperationProgressType *OperationProgress) const;
+    TFileOperationProgressType *OperationProgress, uint32_t PreferredSize = 0,
+    bool LimitCPS = true) const;
   intptr_t PacketLength(uint8_t *LenBuf, SSH_FXP_TYPES ExpectedType) const;
   void Progress(TFileOperationProgressType *OperationProgress);
 
@@ -838,7 +838,8 @@ TParallelOperation::TParallelOperation(TOperationSide Side) :
   FProbablyEmpty(false),
   FClients(0),
   FMainOperationProgress(nullptr),
-  FSide(Side)
+  FSide(Side),
+  FChangeEvent(::CreateEvent(nullptr, false, false, nullptr))
 {
   DebugAssert((Side == osLocal) || (Side == osRemote));
 }
@@ -864,6 +865,9 @@ void TParallelOperation::Init(
 TParallelOperation::~TParallelOperation()
 {
   WaitFor();
+  // the owners remove their segmented files before finishing
+  DebugAssert(FSegmentedFiles.empty());
+  SAFE_CLOSE_HANDLE(FChangeEvent);
 }
 
 bool TParallelOperation::IsInitialized() const
@@ -897,6 +901,14 @@ void TParallelOperation::RemoveClient()
 {
   TGuard Guard(*FSection.get());
   FClients--;
+  // signal while still in the section, as once WaitFor sees no clients,
+  // the operation (and the event) may be destroyed
+  ::SetEvent(FChangeEvent);
+}
+
+void TParallelOperation::WaitForChange(uintptr_t Timeout)
+{
+  ::WaitForSingleObject(FChangeEvent, static_cast<DWORD>(Timeout));
 }
 
 void TParallelOperation::WaitFor()
@@ -916,9 +928,11 @@ void TParallelOperation::WaitFor()
 
       if (!Done)
       {
+        // the clients signal when they finish a file or leave,
+        // the timeout only keeps the progress updated while they transfer
+        WaitForChange(GUIUpdateInterval);
         // propagate the total progress incremented by the parallel operations
         FMainOperationProgress->Progress();
-        Sleep(200);
       }
     }
     while (!Done);
@@ -932,6 +946,11 @@ void TParallelOperation::WaitFor()
 
 void TParallelOperation::Done(UnicodeString FileName, bool Dir, bool Success)
 {
+  SCOPE_EXIT
+  {
+    // wake up the waiting for the parent directory or for the end of the operation
+    ::SetEvent(FChangeEvent);
+  };
   if (Dir)
   {
     TGuard Guard(*FSection.get());
@@ -1101,11 +1120,202 @@ intptr_t TParallelOperation::GetNext(TTerminal *Terminal, UnicodeString &FileNam
     }
   }
 
-  FProbablyEmpty = (FFileList->GetCount() == 0);
+  FProbablyEmpty = (FFileList->GetCount() == 0) && !AnyPendingSegment();
+
+  return Result;
+}
+
+// a file is split to about this many segments, but not to too small or too large ones
+static const int64_t SegmentsPerFile = 64;
+static const int64_t MinSegmentSize = 8 * 1024 * 1024;
+static const int64_t MaxSegmentSize = 256 * 1024 * 1024;
+// segments failing repeatedly on other connections are left to the owner of the file
+static const intptr_t MaxSegmentFailures = 3;
+
+void *TParallelOperation::AddSegmentedFile(UnicodeString FileName, UnicodeString LocalFileName, HANDLE LocalFileHandle, int64_t Size)
+{
+  DebugAssert(Size > 0);
+  TSegmentedFile *File = new TSegmentedFile();
+  File->FileName = FileName;
+  File->LocalFileName = LocalFileName;
+  File->LocalFileHandle = LocalFileHandle;
+  File->Size = Size;
+  int64_t SegmentSize = Max(Min(Size / SegmentsPerFile, MaxSegmentSize), MinSegmentSize);
+  // round to whole megabytes
+  SegmentSize = ((SegmentSize + 1024 * 1024 - 1) / (1024 * 1024)) * (1024 * 1024);
+  File->SegmentSize = SegmentSize;
+  File->States.resize(static_cast<size_t>((Size + SegmentSize - 1) / SegmentSize));
+  File->Running = 0;
+  File->Done = 0;
+  File->Failures = 0;
+  File->Cancelled = false;
+  File->ChangeEvent = ::CreateEvent(nullptr, false, false, nullptr);
+
+  TGuard Guard(*FSection.get());
+  FSegmentedFiles.push_back(File);
+  // let the queue add connections to help with the segments
+  FProbablyEmpty = false;
+  // and wake the main connection, if it waits in CopyParallel, to help too
+  ::SetEvent(FChangeEvent);
+  return File;
+}
+
+void TParallelOperation::RemoveSegmentedFile(void *Token)
+{
+  TSegmentedFile *File = static_cast<TSegmentedFile *>(Token);
+  bool Idle;
+  do
+  {
+    {
+      TGuard Guard(*FSection.get());
+      // the other connections check this after each block
+      File->Cancelled = true;
+      Idle = (File->Running == 0);
+      if (Idle)
+      {
+        for (intptr_t Index = 0; Index < static_cast<intptr_t>(FSegmentedFiles.size()); ++Index)
+        {
+          if (FSegmentedFiles[Index] == File)
+          {
+            FSegmentedFiles.erase(FSegmentedFiles.begin() + Index);
+            break;
+          }
+        }
+      }
+    }
+
+    if (!Idle)
+    {
+      WaitForSegmentChange(File, GUIUpdateInterval);
+    }
+  }
+  while (!Idle);
+
+  SAFE_CLOSE_HANDLE(File->ChangeEvent);
+  SAFE_DESTROY_EX(TSegmentedFile, File);
+}
+
+void TParallelOperation::WaitForSegmentChange(void *Token, uintptr_t Timeout)
+{
+  ::WaitForSingleObject(static_cast<TSegmentedFile *>(Token)->ChangeEvent, static_cast<DWORD>(Timeout));
+}
+
+bool TParallelOperation::TakeSegment(TSegmentedFile *File, TParallelSegment &Segment)
+{
+  bool Result = false;
+  for (intptr_t Index = 0; !Result && (Index < static_cast<intptr_t>(File->States.size())); ++Index)
+  {
+    if (File->States[Index] == ssPending)
+    {
+      File->States[Index] = ssRunning;
+      File->Running++;
+      Segment.FileName = File->FileName;
+      Segment.LocalFileName = File->LocalFileName;
+      Segment.LocalFileHandle = File->LocalFileHandle;
+      Segment.Offset = Index * File->SegmentSize;
+      Segment.Length = Min(File->SegmentSize, File->Size - Segment.Offset);
+      Segment.Index = Index;
+      Segment.Token = File;
+      Result = true;
+    }
+  }
+  return Result;
+}
+
+bool TParallelOperation::AnyPendingSegment() const
+{
+  bool Result = false;
+  for (intptr_t FileIndex = 0; !Result && (FileIndex < static_cast<intptr_t>(FSegmentedFiles.size())); ++FileIndex)
+  {
+    const TSegmentedFile *File = FSegmentedFiles[FileIndex];
+    if (!File->Cancelled && (File->Failures < MaxSegmentFailures))
+    {
+      for (intptr_t Index = 0; !Result && (Index < static_cast<intptr_t>(File->States.size())); ++Index)
+      {
+        Result = (File->States[Index] == ssPending);
+      }
+    }
+  }
+  return Result;
+}
+
+intptr_t TParallelOperation::GetNextSegment(void *Token, TParallelSegment &Segment)
+{
+  TGuard Guard(*FSection.get());
+  TSegmentedFile *File = static_cast<TSegmentedFile *>(Token);
+  intptr_t Result;
+  if (TakeSegment(File, Segment))
+  {
+    Result = 1;
+  }
+  else if (File->Running > 0)
+  {
+    Result = 0; // wait for the other connections to finish their segments
+  }
+  else
+  {
+    Result = -1;
+  }
+  return Result;
+}
+
+bool TParallelOperation::GetNextSegment(TParallelSegment &Segment)
+{
+  TGuard Guard(*FSection.get());
+  bool Result = false;
+  for (intptr_t Index = 0; !Result && (Index < static_cast<intptr_t>(FSegmentedFiles.size())); ++Index)
+  {
+    TSegmentedFile *File = FSegmentedFiles[Index];
+    if (!File->Cancelled && (File->Failures < MaxSegmentFailures))
+    {
+      Result = TakeSegment(File, Segment);
+    }
+  }
+  return Result;
+}
+
+void TParallelOperation::SegmentDone(const TParallelSegment &Segment, bool Success)
+{
+  TGuard Guard(*FSection.get());
+  TSegmentedFile *File = static_cast<TSegmentedFile *>(Segment.Token);
+  DebugAssert(File->States[Segment.Index] == ssRunning);
+  File->Running--;
+  if (Success)
+  {
+    File->States[Segment.Index] = ssDone;
+    File->Done += Segment.Length;
+  }
+  else
+  {
+    // the segment is written again from its start by whoever takes it next
+    File->States[Segment.Index] = ssPending;
+    File->Failures++;
+    FProbablyEmpty = FProbablyEmpty && !AnyPendingSegment();
+    // wake the main connection, if it waits in CopyParallel, to take the segment over
+    // (the queue connections do not wait, they ask for the next segment right away)
+    ::SetEvent(FChangeEvent);
+  }
+  // wake the connection owning the file
+  ::SetEvent(File->ChangeEvent);
+}
 
+bool TParallelOperation::IsSegmentCancelled(const TParallelSegment &Segment) const
+{
+  bool Result = false;
+  if (Segment.Token != nullptr)
+  {
+    TGuard Guard(*FSection.get());
+    Result = static_cast<const TSegmentedFile *>(Segment.Token)->Cancelled;
+  }
   return Result;
 }
 
+int64_t TParallelOperation::GetSegmentsDone(void *Token) const
+{
+  TGuard Guard(*FSection.get());
+  return static_cast<const TSegmentedFile *>(Token)->Done;
+}
+
 
 TTerminal::TTerminal(TObjectClassId Kind) :
   TSessionUI(Kind),
@@ -1131,6 +1341,7 @@ TTerminal::TTerminal(TObjectClassId Kind) :
   FOnInitializeLog(nullptr),
   FUsersGroupsLookedup(false),
   FOperationProgress(nullptr),
+  FParallelOperation(nullptr),
   FUseBusyCursor(false),
   FDirectoryCache(nullptr),
   FDirectoryChangesCache(nullptr),
@@ -1202,7 +1413,8 @@ void TTerminal::Init(TSessionData *SessionData,
 
   FUseBusyCursor = True;
   FLockDirectory.Clear();
-  FDirectoryCache = new TRemoteDirectoryCache();
+  FDirectoryCache = new TRemoteDirectoryCache(
+    static_cast<int64_t>(FConfiguration->GetCacheDirectoriesMaxSize()) * 1024 * 1024);
   FDirectoryChangesCache = nullptr;
   FFSProtocol = cfsUnknown;
   FCommandSession = nullptr;
@@ -1356,7 +1568,17 @@ void TTerminal::Close()
   if (FStatus == ssClosing)
     return;
   FStatus = ssClosing;
+  if (GetSessionData()->GetCacheDirectories())
+  {
+    LogEvent(FORMAT("Directory cache: %d hits, %d misses, %d evictions, %d listings cached (%s bytes)",
+      ToInt(FDirectoryCache->GetHits()), ToInt(FDirectoryCache->GetMisses()),
+      ToInt(FDirectoryCache->GetEvictions()), ToInt(FDirectoryCache->GetCount()),
+      ::Int64ToStr(FDirectoryCache->GetSize())));
+  }
   FFileSystem->Close();
+  // after closing the file system, so that it can contribute its counters
+  LogEvent(L"Transfer statistics: " + FStatistics.GetLogStr());
+  GetActionLog()->AddStatistics(FStatistics);
 
   // Cannot rely on CommandSessionOpened here as Status is set to ssClosed too late
   if ((FCommandSession != nullptr) && FCommandSession->GetActive())
@@ -1603,6 +1825,7 @@ void TTerminal::InitFileSystem()
         SAFE_DESTROY(FSecureShell);
       };
       FSecureShell = new TSecureShell(this, FSessionData, GetLog(), FConfiguration);
+      FSecureShell->SetStatistics(&FStatistics);
       try
       {
         // there will be only one channel in this session
@@ -3722,6 +3945,8 @@ void TTerminal::CustomReadDirectory(TRemoteFileList *AFileList)
   }
   while (RobustLoop.Retry());
 
+  FStatistics.ListedDirectories++;
+
   if (GetLog()->GetLogging())
   {
     for (intptr_t Index = 0; Index < AFileList->GetCount(); ++Index)
@@ -3911,18 +4136,7 @@ void TTerminal::ProcessDirectory(UnicodeString ADirName,
   {
     try__finally
     {
-      UnicodeString Directory = base::UnixIncludeTrailingBackslash(ADirName);
-
-      for (intptr_t Index = 0; Index < FileList->GetCount(); ++Index)
-      {
-        TRemoteFile *File = FileList->GetFile(Index);
-        if (!File->GetIsParentDirectory() && !File->GetIsThisDirectory())
-        {
-          CallBackFunc(Directory + File->GetFileName(), File, Param);
-          // We should catch EScpSkipFile here as we do in ProcessFiles.
-          // Now we have to handle EScpSkipFile in every callback implementation.
-        }
-      }
+      ProcessDirectoryListing(ADirName, FileList.get(), CallBackFunc, Param);
     }
     __finally
     {
@@ -3933,6 +4147,23 @@ void TTerminal::ProcessDirectory(UnicodeString ADirName,
   }
 }
 
+void TTerminal::ProcessDirectoryListing(UnicodeString ADirName,
+  const TRemoteFileList *FileList, TProcessFileEvent CallBackFunc, void *Param)
+{
+  UnicodeString Directory = base::UnixIncludeTrailingBackslash(ADirName);
+
+  for (intptr_t Index = 0; Index < FileList->GetCount(); ++Index)
+  {
+    TRemoteFile *File = FileList->GetFile(Index);
+    if (!File->GetIsParentDirectory() && !File->GetIsThisDirectory())
+    {
+      CallBackFunc(Directory + File->GetFileName(), File, Param);
+      // We should catch EScpSkipFile here as we do in ProcessFiles.
+      // Now we have to handle EScpSkipFile in every callback implementation.
+    }
+  }
+}
+
 void TTerminal::ReadDirectory(TRemoteFileList *AFileList)
 {
   DebugAssert(AFileList);
@@ -5843,6 +6074,91 @@ public:
 
 const intptr_t sfFirstLevel = 0x01;
 
+// Reads local directory in background, while the remote directory is being listed.
+// Errors are not handled here, the directory is then read again
+// the usual way, so that the user can retry or skip.
+class TLocalDirectoryScanThread : public TSimpleThread
+{
+  NB_DISABLE_COPY(TLocalDirectoryScanThread)
+public:
+  static inline bool classof(const TObject *Obj) { return Obj->is(OBJECT_CLASS_TLocalDirectoryScanThread); }
+  virtual bool is(TObjectClassId Kind) const override { return (Kind == OBJECT_CLASS_TLocalDirectoryScanThread) || TSimpleThread::is(Kind); }
+public:
+  struct TFile
+  {
+    UnicodeString Name;
+    intptr_t Attr;
+    int64_t Size;
+    FILETIME LastWriteTime;
+  };
+
+  explicit TLocalDirectoryScanThread(UnicodeString Directory) :
+    TSimpleThread(OBJECT_CLASS_TLocalDirectoryScanThread),
+    FDirectory(Directory.c_str()),
+    FFound(false),
+    FError(ERROR_SUCCESS),
+    FTerminated(false)
+  {
+  }
+
+  virtual ~TLocalDirectoryScanThread()
+  {
+    Close();
+  }
+
+  void InitLocalDirectoryScanThread()
+  {
+    InitSimpleThread();
+    Start();
+  }
+
+  virtual void Terminate() override
+  {
+    FTerminated = true;
+  }
+
+  bool GetFound() const { return FFound; }
+  DWORD GetError() const { return FError; }
+  const rde::vector<TFile> &GetFiles() const { return FFiles; }
+
+protected:
+  virtual void Execute() override
+  {
+    TSearchRecChecked SearchRec;
+    DWORD FindAttrs = faReadOnly | faHidden | faSysFile | faDirectory | faArchive;
+    DWORD Result = FindFirstUnchecked(FDirectory + L"*.*", FindAttrs, SearchRec);
+    FFound = (Result == ERROR_SUCCESS);
+    while ((Result == ERROR_SUCCESS) && !FTerminated)
+    {
+      TFile File;
+      File.Name = SearchRec.Name;
+      File.Attr = SearchRec.Attr;
+      File.Size =
+        (static_cast<int64_t>(SearchRec.FindData.nFileSizeHigh) << 32) +
+        SearchRec.FindData.nFileSizeLow;
+      File.LastWriteTime = SearchRec.FindData.ftLastWriteTime;
+      FFiles.push_back(File);
+      Result = base::FindNext(SearchRec);
+    }
+    if (FFound)
+    {
+      base::FindClose(SearchRec);
+    }
+    // the same errors as FindCheck tolerates
+    if ((Result != ERROR_FILE_NOT_FOUND) && (Result != ERROR_NO_MORE_FILES))
+    {
+      FError = Result;
+    }
+  }
+
+private:
+  UnicodeString FDirectory;
+  rde::vector<TFile> FFiles;
+  bool FFound;
+  DWORD FError;
+  bool FTerminated;
+};
+
 struct TSynchronizeData : public TObject
 {
 public:
@@ -5995,98 +6311,146 @@ void TTerminal::DoSynchronizeCollectDirectory(UnicodeString ALocalDirectory,
       Data.DeleteLocalFileList();
     };
     bool Found = false;
-    TSearchRecChecked SearchRec;
     Data.LocalFileList = CreateSortedStringList();
 
-    FileOperationLoopCustom(this, OperationProgress, True, FMTLOAD(LIST_DIR_ERROR, ALocalDirectory), "",
-    [&]()
+    auto CollectLocalFile = [&](UnicodeString FileName, intptr_t Attr, int64_t Size, const FILETIME &LastWriteTime)
+    {
+      // add dirs for recursive mode or when we are interested in newly
+      // added subdirs
+      TDateTime Modification = ::FileTimeToDateTime(LastWriteTime);
+      TFileMasks::TParams MaskParams;
+      MaskParams.Size = Size;
+      MaskParams.Modification = Modification;
+      UnicodeString RemoteFileName =
+        ChangeFileName(CopyParam, FileName, osLocal, false);
+      UnicodeString FullLocalFileName = Data.LocalDirectory + FileName;
+      UnicodeString BaseFileName = GetBaseFileName(FullLocalFileName);
+      if ((FileName != THISDIRECTORY) && (FileName != PARENTDIRECTORY) &&
+        CopyParam->AllowTransfer(BaseFileName, osLocal,
+          FLAGSET(Attr, faDirectory), MaskParams) &&
+        !FFileSystem->TemporaryTransferFile(FileName) &&
+        (FLAGCLEAR(Level, sfFirstLevel) ||
+          (Options == nullptr) ||
+          Options->MatchesFilter(FileName) ||
+          Options->MatchesFilter(RemoteFileName)))
+      {
+        TSynchronizeFileData *FileData = new TSynchronizeFileData();
+
+        FileData->IsDirectory = FLAGSET(Attr, faDirectory);
+        FileData->Info.FileName = FileName;
+        FileData->Info.Directory = Data.LocalDirectory;
+        FileData->Info.Modification = Modification;
+        FileData->Info.ModificationFmt = mfFull;
+        FileData->Info.Size = Size;
+        FileData->LocalLastWriteTime = LastWriteTime;
+        FileData->New = true;
+        FileData->Modified = false;
+        Data.LocalFileList->AddObject(FileName, FileData);
+        LogEvent(FORMAT("Local file %s included to synchronization",
+            FormatFileDetailsForLog(FullLocalFileName, Modification, Size)));
+      }
+      else
+      {
+        LogEvent(FORMAT("Local file %s excluded from synchronization",
+            FormatFileDetailsForLog(FullLocalFileName, Modification, Size)));
+      }
+    };
+
+    std::unique_ptr<TRemoteFileList> RemoteFileList;
+    bool RemoteListed = false;
+    auto ReadRemoteListing = [&]()
     {
-      DWORD FindAttrs = faReadOnly | faHidden | faSysFile | faDirectory | faArchive;
-      Found = ::FindFirstChecked(Data.LocalDirectory + L"*.*", FindAttrs, SearchRec) == 0;
-    });
+      // can we expect that reading remote directory would take so little time
+      // that we can postpone showing progress window until anything actually happens?
+      bool Cached = FLAGSET(Params, spUseCache) && GetSessionData()->GetCacheDirectories() &&
+        FDirectoryCache->HasFileList(ARemoteDirectory);
 
-    if (Found)
+      if (!Cached && FLAGSET(Params, spDelayProgress))
+      {
+        DoSynchronizeProgress(Data, true);
+      }
+
+      RemoteFileList.reset(CustomReadDirectoryListing(ARemoteDirectory, FLAGSET(Params, spUseCache)));
+      RemoteListed = true;
+    };
+
+    // the local directory is read in background, while the remote directory is listed,
+    // but only when there is a local directory to compare the remote one with
+    std::unique_ptr<TLocalDirectoryScanThread> LocalScan;
+    if (::DirectoryExists(ApiPath(ALocalDirectory)))
     {
-      try__finally
+      LocalScan.reset(new TLocalDirectoryScanThread(Data.LocalDirectory));
+      LocalScan->InitLocalDirectoryScanThread();
+
+      ReadRemoteListing();
+
+      LocalScan->WaitFor();
+      if (LocalScan->GetError() == ERROR_SUCCESS)
+      {
+        Found = LocalScan->GetFound();
+        const rde::vector<TLocalDirectoryScanThread::TFile> &Files = LocalScan->GetFiles();
+        for (size_t Index = 0; Index < Files.size(); ++Index)
+        {
+          const TLocalDirectoryScanThread::TFile &File = Files[Index];
+          CollectLocalFile(File.Name, File.Attr, File.Size, File.LastWriteTime);
+        }
+      }
+      else
+      {
+        LogEvent(FORMAT("Reading local directory '%s' in background failed (%d), reading it again",
+          ALocalDirectory, int(LocalScan->GetError())));
+      }
+    }
+
+    if ((LocalScan.get() == nullptr) || (LocalScan->GetError() != ERROR_SUCCESS))
+    {
+      TSearchRecChecked SearchRec;
+      FileOperationLoopCustom(this, OperationProgress, True, FMTLOAD(LIST_DIR_ERROR, ALocalDirectory), "",
+      [&]()
+      {
+        DWORD FindAttrs = faReadOnly | faHidden | faSysFile | faDirectory | faArchive;
+        Found = ::FindFirstChecked(Data.LocalDirectory + L"*.*", FindAttrs, SearchRec) == 0;
+      });
+
+      if (Found)
       {
         SCOPE_EXIT
         {
           base::FindClose(SearchRec);
         };
-        while (Found)
+        bool More = true;
+        while (More)
         {
-          UnicodeString FileName = SearchRec.Name;
-          // add dirs for recursive mode or when we are interested in newly
-          // added subdirs
           // SearchRec.Size in C++B2010 is int64_t,
           // so we should be able to use it instead of FindData.nFileSize*
           int64_t Size =
             (static_cast<int64_t>(SearchRec.FindData.nFileSizeHigh) << 32) +
             SearchRec.FindData.nFileSizeLow;
-          TDateTime Modification = ::FileTimeToDateTime(SearchRec.FindData.ftLastWriteTime);
-          TFileMasks::TParams MaskParams;
-          MaskParams.Size = Size;
-          MaskParams.Modification = Modification;
-          UnicodeString RemoteFileName =
-            ChangeFileName(CopyParam, FileName, osLocal, false);
-          UnicodeString FullLocalFileName = Data.LocalDirectory + FileName;
-          UnicodeString BaseFileName = GetBaseFileName(FullLocalFileName);
-          if ((FileName != THISDIRECTORY) && (FileName != PARENTDIRECTORY) &&
-            CopyParam->AllowTransfer(BaseFileName, osLocal,
-              FLAGSET(SearchRec.Attr, faDirectory), MaskParams) &&
-            !FFileSystem->TemporaryTransferFile(FileName) &&
-            (FLAGCLEAR(Level, sfFirstLevel) ||
-              (Options == nullptr) ||
-              Options->MatchesFilter(FileName) ||
-              Options->MatchesFilter(RemoteFileName)))
-          {
-            TSynchronizeFileData *FileData = new TSynchronizeFileData();
-
-            FileData->IsDirectory = FLAGSET(SearchRec.Attr, faDirectory);
-            FileData->Info.FileName = FileName;
-            FileData->Info.Directory = Data.LocalDirectory;
-            FileData->Info.Modification = Modification;
-            FileData->Info.ModificationFmt = mfFull;
-            FileData->Info.Size = Size;
-            FileData->LocalLastWriteTime = SearchRec.FindData.ftLastWriteTime;
-            FileData->New = true;
-            FileData->Modified = false;
-            Data.LocalFileList->AddObject(FileName, FileData);
-            LogEvent(FORMAT("Local file %s included to synchronization",
-                FormatFileDetailsForLog(FullLocalFileName, Modification, Size)));
-          }
-          else
-          {
-            LogEvent(FORMAT("Local file %s excluded from synchronization",
-                FormatFileDetailsForLog(FullLocalFileName, Modification, Size)));
-          }
+          CollectLocalFile(SearchRec.Name, SearchRec.Attr, Size, SearchRec.FindData.ftLastWriteTime);
 
           FileOperationLoopCustom(this, OperationProgress, True, FMTLOAD(LIST_DIR_ERROR, ALocalDirectory), "",
           [&]()
           {
-            Found = (::FindNextChecked(SearchRec) == 0);
+            More = (::FindNextChecked(SearchRec) == 0);
           });
         }
       }
-      __finally
-      {
-#if 0
-        FindClose(SearchRec);
-#endif // #if 0
-      };
-
-      // can we expect that ProcessDirectory would take so little time
-      // that we can postpone showing progress window until anything actually happens?
-      bool Cached = FLAGSET(Params, spUseCache) && GetSessionData()->GetCacheDirectories() &&
-        FDirectoryCache->HasFileList(ARemoteDirectory);
+    }
+    LocalScan.reset();
 
-      if (!Cached && FLAGSET(Params, spDelayProgress))
+    if (Found)
+    {
+      if (!RemoteListed)
       {
-        DoSynchronizeProgress(Data, true);
+        ReadRemoteListing();
       }
 
-      ProcessDirectory(ARemoteDirectory, nb::bind(&TTerminal::SynchronizeCollectFile, this), &Data,
-        FLAGSET(Params, spUseCache));
+      // skip if directory listing fails and user selects "skip"
+      if (RemoteFileList.get() != nullptr)
+      {
+        ProcessDirectoryListing(ARemoteDirectory, RemoteFileList.get(),
+          nb::bind(&TTerminal::SynchronizeCollectFile, this), &Data);
+      }
 
       TSynchronizeFileData *FileData;
       for (intptr_t Index = 0; Index < Data.LocalFileList->GetCount(); ++Index)
@@ -6937,6 +7301,17 @@ bool TTerminal::GetStoredCredentialsTried() const
 
 intptr_t TTerminal::CopyToParallel(TParallelOperation *ParallelOperation, TFileOperationProgressType *OperationProgress)
 {
+  // help with segments of large files first, not to delay their completion
+  if (FFileSystem->IsCapable(fsParallelSegments))
+  {
+    TParallelSegment Segment;
+    if (ParallelOperation->GetNextSegment(Segment))
+    {
+      CopySegmentParallel(ParallelOperation, Segment, OperationProgress);
+      return 1;
+    }
+  }
+
   UnicodeString FileName;
   TObject *Object;
   UnicodeString TargetDir;
@@ -6971,8 +7346,10 @@ intptr_t TTerminal::CopyToParallel(TParallelOperation *ParallelOperation, TFileO
         bool Success = (Prev < OperationProgress->GetFilesFinishedSuccessfully());
         ParallelOperation->Done(FileName, Dir, Success);
         FOperationProgress = nullptr;
+        FParallelOperation = nullptr;
       };
       FOperationProgress = OperationProgress;
+      FParallelOperation = ParallelOperation;
       if (ParallelOperation->GetSide() == osLocal)
       {
         FFileSystem->CopyToRemote(
@@ -6997,6 +7374,51 @@ intptr_t TTerminal::CopyToParallel(TParallelOperation *ParallelOperation, TFileO
   return Result;
 }
 
+void TTerminal::CopySegmentParallel(TParallelOperation *ParallelOperation, const TParallelSegment &Segment,
+  TFileOperationProgressType *OperationProgress)
+{
+  LogEvent(FORMAT("Downloading segment %d of \"%s\" (offset %s, length %s).",
+    ToInt(Segment.Index), Segment.FileName, ::Int64ToStr(Segment.Offset), ::Int64ToStr(Segment.Length)));
+
+  bool Success = false;
+  try__finally
+  {
+    SCOPE_EXIT
+    {
+      ParallelOperation->SegmentDone(Segment, Success);
+      FOperationProgress = nullptr;
+    };
+    FOperationProgress = OperationProgress;
+    OperationProgress->SetFile(Segment.FileName);
+    OperationProgress->SetTransferSize(Segment.Length);
+    OperationProgress->SetLocalSize(Segment.Length);
+    try
+    {
+      FFileSystem->CopyToLocalSegment(Segment, ParallelOperation, OperationProgress);
+      Success = true;
+    }
+    catch (Exception &E)
+    {
+      // the segment will be downloaded again from its start, do not count it twice
+      OperationProgress->RollbackTransfer();
+      if (!GetActive() || (OperationProgress->GetCancel() != csContinue))
+      {
+        throw;
+      }
+      // the owner of the file or other connection will take the segment over
+      LogEvent(FORMAT("Downloading segment %d failed.", ToInt(Segment.Index)));
+      GetLog()->AddException(&E);
+    }
+  }
+  __finally
+  {
+#if 0
+    ParallelOperation->SegmentDone(Segment, Success);
+    FOperationProgress = nullptr;
+#endif // #if 0
+  };
+}
+
 bool TTerminal::CanParallel(
   const TCopyParamType *CopyParam, intptr_t Params, TParallelOperation *ParallelOperation) const
 {
@@ -7028,7 +7450,8 @@ void TTerminal::CopyParallel(TParallelOperation *ParallelOperation, TFileOperati
       }
       else if (GotNext == 0)
       {
-        Sleep(100);
+        // wait for the parent directory to be created by other client
+        ParallelOperation->WaitForChange(GUIUpdateInterval);
       }
     }
     while (Continue && !OperationProgress->GetCancel());
@@ -7082,6 +7505,16 @@ void TTerminal::LogTotalTransferDetails(
 void TTerminal::LogTotalTransferDone(TFileOperationProgressType *OperationProgress)
 {
   LogEvent(L"Copying finished: " + OperationProgress->GetLogStr(true));
+  if (OperationProgress->GetSide() == osLocal)
+  {
+    FStatistics.UploadedBytes += OperationProgress->GetTotalTransferred();
+    FStatistics.UploadedFiles += OperationProgress->GetFilesFinishedSuccessfully();
+  }
+  else
+  {
+    FStatistics.DownloadedBytes += OperationProgress->GetTotalTransferred();
+    FStatistics.DownloadedFiles += OperationProgress->GetFilesFinishedSuccessfully();
+  }
 }
 
 bool TTerminal::CopyToRemote(const TStrings *AFilesToCopy,
@@ -32,6 +32,7 @@ struct TFilesFindParams;
 class TTunnelUI;
 class TCallbackGuard;
 class TParallelOperation;
+struct TParallelSegment;
 class TCollectedFileList;
 
 #if 0
@@ -305,9 +306,11 @@ private:
   TFileOperationProgressEvent FOnProgress;
   TFileOperationFinishedEvent FOnFinished;
   TFileOperationProgressType *FOperationProgress;
+  TParallelOperation *FParallelOperation;
   bool FUseBusyCursor;
   TRemoteDirectoryCache *FDirectoryCache;
   TRemoteDirectoryChangesCache *FDirectoryChangesCache;
+  TTransferStatistics FStatistics;
   TSecureShell *FSecureShell;
   UnicodeString FLastDirectoryChange;
   TCurrentFSProtocol FFSProtocol;
@@ -416,6 +419,8 @@ protected:
   void ProcessDirectory(UnicodeString ADirName,
     TProcessFileEvent CallBackFunc, void *Param = nullptr, bool UseCache = false,
     bool IgnoreErrors = false);
+  void ProcessDirectoryListing(UnicodeString ADirName, const TRemoteFileList *FileList,
+    TProcessFileEvent CallBackFunc, void *Param);
   void AnnounceFileListOperation();
   UnicodeString TranslateLockedPath(UnicodeString APath, bool Lock);
   void ReadDirectory(TRemoteFileList *AFileList);
@@ -553,6 +558,8 @@ protected:
   bool DoOnCustomCommand(UnicodeString Command);
   bool CanParallel(const TCopyParamType *CopyParam, intptr_t Params, TParallelOperation *ParallelOperation) const;
   void CopyParallel(TParallelOperation *ParallelOperation, TFileOperationProgressType *OperationProgress);
+  void CopySegmentParallel(TParallelOperation *ParallelOperation, const TParallelSegment &Segment,
+    TFileOperationProgressType *OperationProgress);
 
 #if 0
   __property TFileOperationProgressType *OperationProgress = { read = FOperationProgress };
@@ -560,6 +567,8 @@ protected:
   const TFileOperationProgressType *GetOperationProgress() const { return FOperationProgress; }
   TFileOperationProgressType *GetOperationProgress() { return FOperationProgress; }
   void SetOperationProgress(TFileOperationProgressType *OperationProgress) { FOperationProgress = OperationProgress; }
+  // the parallel operation the current transfer is part of, if any
+  TParallelOperation *GetParallelOperation() const { return FParallelOperation; }
 
 public:
   explicit TTerminal(TObjectClassId Kind = OBJECT_CLASS_TTerminal);
@@ -739,6 +748,7 @@ public:
   TSessionLog *GetLog() const { return FLog; }
   TSessionLog *GetLog() { return FLog; }
   TActionLog *GetActionLog() const { return FActionLog; }
+  TTransferStatistics *GetStatistics() { return &FStatistics; }
   const TConfiguration *GetConfiguration() const { return FConfiguration; }
   TConfiguration *GetConfiguration() { return FConfiguration; }
   TSessionStatus GetStatus() const { return FStatus; }
@@ -1132,6 +1142,23 @@ private:
   TFileDataList FList;
 };
 
+// A byte range of a file being downloaded in segments,
+// see TParallelOperation::AddSegmentedFile
+struct TParallelSegment
+{
+  CUSTOM_MEM_ALLOCATION_IMPL
+  TParallelSegment() : LocalFileHandle(INVALID_HANDLE_VALUE), Offset(0), Length(0), Index(-1), Token(nullptr) {}
+
+  UnicodeString FileName;
+  UnicodeString LocalFileName;
+  HANDLE LocalFileHandle;
+  int64_t Offset;
+  // -1 = up to the end of the file
+  int64_t Length;
+  intptr_t Index;
+  void *Token;
+};
+
 class TParallelOperation : public TObject
 {
 public:
@@ -1147,11 +1174,21 @@ public:
   bool ShouldAddClient() const;
   void AddClient();
   void RemoveClient();
+  void WaitForChange(uintptr_t Timeout);
+  void WaitForSegmentChange(void *Token, uintptr_t Timeout);
   intptr_t GetNext(
     TTerminal *Terminal, UnicodeString &FileName, TObject *&Object, UnicodeString &TargetDir,
     bool &Dir, bool &Recursed);
   void Done(UnicodeString FileName, bool Dir, bool Success);
 
+  void *AddSegmentedFile(UnicodeString FileName, UnicodeString LocalFileName, HANDLE LocalFileHandle, int64_t Size);
+  void RemoveSegmentedFile(void *Token);
+  intptr_t GetNextSegment(void *Token, TParallelSegment &Segment);
+  bool GetNextSegment(TParallelSegment &Segment);
+  void SegmentDone(const TParallelSegment &Segment, bool Success);
+  bool IsSegmentCancelled(const TParallelSegment &Segment) const;
+  int64_t GetSegmentsDone(void *Token) const;
+
 #if 0
   __property TOperationSide Side = { read = FSide };
   __property const TCopyParamType * CopyParam = { read = FCopyParam };
@@ -1176,6 +1213,25 @@ private:
     bool Exists;
   };
 
+  enum TSegmentState { ssPending, ssRunning, ssDone };
+
+  struct TSegmentedFile
+  {
+    CUSTOM_MEM_ALLOCATION_IMPL
+    UnicodeString FileName;
+    UnicodeString LocalFileName;
+    HANDLE LocalFileHandle;
+    int64_t Size;
+    int64_t SegmentSize;
+    rde::vector<TSegmentState> States;
+    intptr_t Running;
+    int64_t Done;
+    intptr_t Failures;
+    bool Cancelled;
+    // set whenever a segment of the file finishes
+    HANDLE ChangeEvent;
+  };
+
   std::unique_ptr<TStrings> FFileList;
   intptr_t FIndex;
   typedef rde::map<UnicodeString, TDirectoryData> TDirectories;
@@ -1189,8 +1245,13 @@ private:
   TFileOperationProgressType *FMainOperationProgress;
   TOperationSide FSide;
   UnicodeString FMainName;
+  // set when a client finishes a file or leaves
+  HANDLE FChangeEvent;
+  rde::vector<TSegmentedFile *> FSegmentedFiles;
 
   bool CheckEnd(TCollectedFileList *Files);
+  bool AnyPendingSegment() const;
+  static bool TakeSegment(TSegmentedFile *File, TParallelSegment &Segment);
 };
 
 NB_CORE_EXPORT UnicodeString GetSessionUrl(const TTerminal *Terminal, bool WithUserName = false);
@@ -741,6 +741,7 @@ bool TWebDAVFileSystem::IsCapable(intptr_t Capability) const
   case fcPreservingTimestampDirs:
   case fcResumeSupport:
   case fcChangePassword:
+  case fsParallelSegments:
     return false;
 
   case fcLocking:
@@ -1946,6 +1947,7 @@ void TWebDAVFileSystem::NeonPreSend(
 {
   TWebDAVFileSystem *FileSystem = static_cast<TWebDAVFileSystem *>(UserData);
 
+  FileSystem->FTerminal->GetStatistics()->RoundTrips++;
   FileSystem->FAuthorizationProtocol = L"";
   UnicodeString HeaderBuf(StrFromNeon(UTF8String(Header->data, Header->used)));
   const UnicodeString AuthorizationHeaderName(L"Authorization:");
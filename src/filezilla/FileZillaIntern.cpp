@@ -6,16 +6,35 @@
 
 TFileZillaIntern::TFileZillaIntern(TFileZillaIntf * AOwner) :
   // TObject(OBJECT_CLASS_TFileZillaIntern),
-  FOwner(AOwner)
+  FOwner(AOwner),
+  FTransferStatusSerial(0),
+  FTransferStatusPending(false)
 {
   FDebugLevel = 0;
+  FTransferStatus.bytes = -1;
+  FTransferStatus.transfersize = -1;
+  FTransferStatus.bFileTransfer = FALSE;
 }
 
-bool TFileZillaIntern::FZPostMessage(WPARAM wParam, LPARAM lParam) const
+bool TFileZillaIntern::FZPostMessage(WPARAM wParam, LPARAM lParam)
 {
   bool Result;
   unsigned int MessageID = FZ_MSG_ID(wParam);
 
+  if ((MessageID == FZ_MSG_TRANSFERSTATUS) && (lParam == 0))
+  {
+    // the transfer has ended, a status posted after this
+    // must not be coalesced into the marker queued before it,
+    // so the marker gets the values it has now
+    FTransferStatusSection.Lock();
+    if (FTransferStatusPending)
+    {
+      FEndedTransferStatuses[FTransferStatusSerial] = FTransferStatus;
+      FTransferStatusPending = false;
+    }
+    FTransferStatusSection.Unlock();
+  }
+
   switch (MessageID)
   {
     case FZ_MSG_STATUS:
@@ -36,6 +55,62 @@ bool TFileZillaIntern::FZPostMessage(WPARAM wParam, LPARAM lParam) const
   return Result;
 }
 
+bool TFileZillaIntern::FZPostTransferStatus(int64_t Bytes, int64_t TransferSize, bool FileTransfer)
+{
+  bool Post;
+  LPARAM Serial;
+
+  FTransferStatusSection.Lock();
+  FTransferStatus.bytes = Bytes;
+  FTransferStatus.transfersize = TransferSize;
+  FTransferStatus.bFileTransfer = FileTransfer ? TRUE : FALSE;
+  // the marker queued earlier will pick up the new values
+  Post = !FTransferStatusPending;
+  if (Post)
+  {
+    FTransferStatusPending = true;
+    // zero is reserved for the "transfer ended" message
+    if (++FTransferStatusSerial == 0)
+    {
+      ++FTransferStatusSerial;
+    }
+  }
+  Serial = FTransferStatusSerial;
+  FTransferStatusSection.Unlock();
+
+  bool Result = true;
+  if (Post)
+  {
+    Result = FOwner->FZPostMessage(FZ_MSG_MAKEMSG(FZ_MSG_TRANSFERSTATUS, 0), Serial);
+  }
+  return Result;
+}
+
+bool TFileZillaIntern::GetTransferStatus(LPARAM Serial, t_ffam_transferstatus & Status)
+{
+  FTransferStatusSection.Lock();
+  bool Result;
+  rde::map<LPARAM, t_ffam_transferstatus>::iterator Ended = FEndedTransferStatuses.find(Serial);
+  if (Ended != FEndedTransferStatuses.end())
+  {
+    // marker queued before the transfer ended
+    Status = Ended->second;
+    FEndedTransferStatuses.erase(Serial);
+    Result = true;
+  }
+  else
+  {
+    Result = (Serial == FTransferStatusSerial) && FTransferStatusPending;
+    if (Result)
+    {
+      Status = FTransferStatus;
+      FTransferStatusPending = false;
+    }
+  }
+  FTransferStatusSection.Unlock();
+  return Result;
+}
+
 CString TFileZillaIntern::GetOption(int OptionID) const
 {
   return FOwner->Option(OptionID);
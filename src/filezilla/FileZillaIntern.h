@@ -2,6 +2,7 @@
 #define FileZillaInternH
 
 #include <headers.hpp>
+#include <rdestl/map.h>
 
 class TFileZillaIntf;
 
@@ -12,7 +13,9 @@ NB_DISABLE_COPY(TFileZillaIntern)
 public:
   explicit TFileZillaIntern(TFileZillaIntf * AOwner);
 
-  bool FZPostMessage(WPARAM wParam, LPARAM lParam) const;
+  bool FZPostMessage(WPARAM wParam, LPARAM lParam);
+  bool FZPostTransferStatus(int64_t Bytes, int64_t TransferSize, bool FileTransfer);
+  bool GetTransferStatus(LPARAM Serial, t_ffam_transferstatus & Status);
   CString GetOption(int OptionID) const;
   int GetOptionVal(int OptionID) const;
 
@@ -24,6 +27,15 @@ public:
 protected:
   TFileZillaIntf * FOwner;
   int FDebugLevel;
+  // the latest transfer status, only a marker carrying FTransferStatusSerial
+  // is queued while the previous one is pending
+  CCriticalSection FTransferStatusSection;
+  t_ffam_transferstatus FTransferStatus;
+  LPARAM FTransferStatusSerial;
+  bool FTransferStatusPending;
+  // values of markers that were pending when the transfer ended,
+  // kept by serial, so that a status posted afterwards cannot replace them
+  rde::map<LPARAM, t_ffam_transferstatus> FEndedTransferStatuses;
 };
 
 #endif // FileZillaInternH
@@ -515,12 +515,19 @@ bool TFileZillaIntf::HandleMessage(WPARAM wParam, LPARAM lParam)
     case FZ_MSG_TRANSFERSTATUS:
       {
         DebugAssert(FZ_MSG_PARAM(wParam) == 0);
-        t_ffam_transferstatus * Status = reinterpret_cast<t_ffam_transferstatus *>(lParam);
-        if (Status != NULL)
+        // non-zero lParam is a marker of coalesced status kept by FIntern
+        if (lParam != 0)
         {
-          Result = HandleTransferStatus(
-            true, Status->transfersize, Status->bytes, Status->bFileTransfer != FALSE);
-          delete Status;
+          t_ffam_transferstatus Status;
+          if (FIntern->GetTransferStatus(lParam, Status))
+          {
+            Result = HandleTransferStatus(
+              true, Status.transfersize, Status.bytes, Status.bFileTransfer != FALSE);
+          }
+          else
+          {
+            Result = true;
+          }
         }
         else
         {
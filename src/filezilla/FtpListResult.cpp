@@ -147,9 +147,8 @@ CFtpListResult::CFtpListResult(t_server & server, bool *bUTF8, int *nCodePage)
 
   pos=0;
 
-  m_prevline=0;
-  m_curline=0;
   m_curlistaddpos=0;
+  m_lastFormat=FORMAT_NONE;
 
   //Fill the month names map
 
@@ -389,81 +388,12 @@ CFtpListResult::~CFtpListResult()
     ptr=ptr->next;
     delete ptr2;
   }
-  if (m_prevline)
-    nb_free(m_prevline);
-  if (m_curline)
-    nb_free(m_curline);
+  FreeLine(m_prevline);
 }
 
 t_directory::t_direntry *CFtpListResult::getList(int &num, bool mlst)
 {
-  #ifdef _DEBUG
-  USES_CONVERSION;
-  #endif
-  char *line=GetLine();
-  m_curline=line;
-  while (line)
-  {
-    int tmp;
-    char *tmpline = nb::chcalloc(strlen(line) + 1);
-    strcpy(tmpline, line);
-    t_directory::t_direntry direntry;
-    if (parseLine(tmpline, (int)strlen(tmpline), direntry, tmp, mlst))
-    {
-      nb_free(tmpline);
-      if (tmp)
-        m_server.nServerType |= tmp;
-      if (direntry.name!=L"." && direntry.name!=L"..")
-      {
-        AddLine(direntry);
-      }
-      if (m_prevline)
-      {
-        nb_free(m_prevline);
-        m_prevline=0;
-      }
-      if (m_curline!=line)
-        nb_free(m_curline);
-      nb_free(line);
-      line=GetLine();
-      m_curline=line;
-    }
-    else
-    {
-      nb_free(tmpline);
-      if (m_prevline)
-      {
-        if (m_curline!=line)
-        {
-          nb_free(m_prevline);
-          m_prevline=m_curline;
-          nb_free(line);
-          line=GetLine();
-          m_curline=line;
-        }
-        else
-        {
-          line=nb::chcalloc(strlen(m_prevline)+strlen(m_curline)+2);
-          sprintf(line, "%s %s", m_prevline, m_curline);
-        }
-      }
-      else
-      {
-        m_prevline=line;
-        line=GetLine();
-        m_curline=line;
-      }
-    }
-  }
-  if (m_prevline)
-  {
-    nb_free(m_prevline);
-    m_prevline=0;
-  }
-  if (m_curline!=line)
-    nb_free(m_curline);
-  nb_free(line);
-  m_curline=0;
+  ParseLines(mlst, false);
 
   num=(int)m_EntryList.size();
   if (!num)
@@ -481,68 +411,86 @@ t_directory::t_direntry *CFtpListResult::getList(int &num, bool mlst)
 
 BOOL CFtpListResult::parseLine(const char *lineToParse, const int linelen, t_directory::t_direntry &direntry, int &nFTPServerType, bool mlst)
 {
-  USES_CONVERSION;
-
   nFTPServerType = 0;
   direntry.ownergroup = L"";
   direntry.owner = L"";
   direntry.group = L"";
 
-  if (parseAsMlsd(lineToParse, linelen, direntry, mlst))
+  if ((m_lastFormat != FORMAT_NONE) &&
+      parseAs(m_lastFormat, lineToParse, linelen, direntry, mlst))
     return TRUE;
 
-  if (parseAsUnix(lineToParse, linelen, direntry))
-    return TRUE;
+  for (int format = FORMAT_MLSD; format <= FORMAT_IBMMVSPDS2; format++)
+  {
+    if ((format != m_lastFormat) &&
+        parseAs(format, lineToParse, linelen, direntry, mlst))
+    {
+      if (format != FORMAT_IBMMVSPDS2)
+        m_lastFormat = format;
+      return TRUE;
+    }
+  }
 
-  if (parseAsDos(lineToParse, linelen, direntry))
+  // name-only entries
+  if (strnchr(lineToParse, linelen, ' ') == NULL)
+  {
+    copyStr(direntry.name, 0, lineToParse, linelen);
     return TRUE;
+  }
 
-  if (parseAsEPLF(lineToParse, linelen, direntry))
-    return TRUE;
+  return FALSE;
+}
 
-  if (parseAsVMS(lineToParse, linelen, direntry))
+BOOL CFtpListResult::parseAs(int format, const char *line, const int linelen, t_directory::t_direntry &direntry, bool mlst)
+{
+  switch (format)
   {
+    case FORMAT_MLSD:
+      return parseAsMlsd(line, linelen, direntry, mlst);
+
+    case FORMAT_UNIX:
+      return parseAsUnix(line, linelen, direntry);
+
+    case FORMAT_DOS:
+      return parseAsDos(line, linelen, direntry);
+
+    case FORMAT_EPLF:
+      return parseAsEPLF(line, linelen, direntry);
+
+    case FORMAT_VMS:
+      if (parseAsVMS(line, linelen, direntry))
+      {
 #ifndef LISTDEBUG
-    m_server.nServerType |= FZ_SERVERTYPE_SUB_FTP_VMS;
+        m_server.nServerType |= FZ_SERVERTYPE_SUB_FTP_VMS;
 #endif // LISTDEBUG
-    return TRUE;
-  }
+        return TRUE;
+      }
+      return FALSE;
 
-  if (parseAsOther(lineToParse, linelen, direntry))
-    return TRUE;
+    case FORMAT_OTHER:
+      return parseAsOther(line, linelen, direntry);
 
-  if (parseAsIBMMVS(lineToParse, linelen, direntry))
-    return TRUE;
+    case FORMAT_IBMMVS:
+      return parseAsIBMMVS(line, linelen, direntry);
 
-  if (parseAsIBMMVSPDS(lineToParse, linelen, direntry))
-    return TRUE;
+    case FORMAT_IBMMVSPDS:
+      return parseAsIBMMVSPDS(line, linelen, direntry);
 
-  if (parseAsIBM(lineToParse, linelen, direntry))
-    return TRUE;
-
-  if (parseAsWfFtp(lineToParse, linelen, direntry))
-    return TRUE;
+    case FORMAT_IBM:
+      return parseAsIBM(line, linelen, direntry);
 
-  // Should be last
-  if (parseAsIBMMVSPDS2(lineToParse, linelen, direntry))
-    return TRUE;
+    case FORMAT_WFFTP:
+      return parseAsWfFtp(line, linelen, direntry);
 
-  // name-only entries
-  if (strchr(lineToParse, ' ') == NULL)
-  {
-    copyStr(direntry.name, 0, lineToParse, (int)strlen(lineToParse));
-    return TRUE;
+    case FORMAT_IBMMVSPDS2:
+      return parseAsIBMMVSPDS2(line, linelen, direntry);
   }
-
   return FALSE;
 }
 
 // Used only with LISTDEBUG
 void CFtpListResult::AddData(char *data, int size)
 {
-  #ifdef _DEBUG
-  USES_CONVERSION;
-  #endif
   if (!size)
     return;
 
@@ -562,81 +510,89 @@ void CFtpListResult::AddData(char *data, int size)
   m_curlistaddpos->len = size;
   m_curlistaddpos->next = 0;
 
+  //Try if there are already some complete lines
+  ParseLines(false, true);
+}
+
+void CFtpListResult::ParseLines(bool mlst, bool partial)
+{
   t_list *pOldListPos = curpos;
   int nOldListBufferPos = pos;
 
-  //Try if there are already some complete lines
-  t_directory::t_direntry direntry;
-  char *line = GetLine();
-  m_curline = line;
-  while (line)
+  // Line that failed to parse is retried joined with the previous one,
+  // for listings that wrap long entries
+  t_line curline;
+  t_line joinedline;
+  bool more = GetLine(curline);
+  while (more)
   {
-    if (curpos)
+    if (partial)
     {
+      if (!curpos)
+      {
+        // Incomplete line, parse it once more data arrives
+        FreeLine(curline);
+        break;
+      }
       pOldListPos = curpos;
       nOldListBufferPos = pos;
     }
-    else
-    {
-      nb_free(line);
-      if (m_curline != line)
-        nb_free(m_curline);
-      m_curline = 0;
-      break;
-    }
+    t_line &line = joinedline.str ? joinedline : curline;
+    t_directory::t_direntry direntry;
     int tmp;
-    char *tmpline = nb::chcalloc(strlen(line) + 1);
-    strcpy(tmpline, line);
-    if (parseLine(tmpline, (const int)strlen(tmpline), direntry, tmp, false))
+    if (parseLine(line.str, line.len, direntry, tmp, mlst))
     {
-      nb_free(tmpline);
       if (tmp)
         m_server.nServerType |= tmp;
       if (direntry.name!=L"." && direntry.name!=L"..")
       {
         AddLine(direntry);
       }
-      if (m_prevline)
-      {
-        nb_free(m_prevline);
-        m_prevline=0;
-      }
-      if (m_curline!=line)
-        nb_free(m_curline);
-      nb_free(line);
-      line = GetLine();
-      m_curline = line;
+      FreeLine(m_prevline);
+      FreeLine(joinedline);
+      FreeLine(curline);
+      more = GetLine(curline);
     }
-    else
+    else if (m_prevline.str)
     {
-      nb_free(tmpline);
-      if (m_prevline)
+      if (joinedline.str)
       {
-        if (m_curline != line)
-        {
-          nb_free(m_prevline);
-          m_prevline = m_curline;
-          nb_free(line);
-          line = GetLine();
-          m_curline = line;
-        }
-        else
-        {
-          line=nb::chcalloc(strlen(m_prevline)+strlen(m_curline)+2);
-          sprintf(line, "%s %s", m_prevline, m_curline);
-        }
+        FreeLine(joinedline);
+        FreeLine(m_prevline);
+        m_prevline = curline;
+        curline = t_line();
+        more = GetLine(curline);
       }
       else
       {
-        m_prevline=line;
-        line=GetLine();
-        m_curline=line;
+        joinedline.len = m_prevline.len + 1 + curline.len;
+        joinedline.str = nb::chcalloc(joinedline.len + 1);
+        joinedline.owned = true;
+        memcpy(joinedline.str, m_prevline.str, m_prevline.len);
+        joinedline.str[m_prevline.len] = ' ';
+        memcpy(&joinedline.str[m_prevline.len + 1], curline.str, curline.len);
+        joinedline.str[joinedline.len] = 0;
       }
     }
+    else
+    {
+      m_prevline = curline;
+      curline = t_line();
+      more = GetLine(curline);
+    }
   }
-  curpos=pOldListPos;
-  pos=nOldListBufferPos;
+  FreeLine(joinedline);
+  FreeLine(curline);
 
+  if (partial)
+  {
+    curpos = pOldListPos;
+    pos = nOldListBufferPos;
+  }
+  else
+  {
+    FreeLine(m_prevline);
+  }
 }
 
 void CFtpListResult::SendToMessageLog()
@@ -645,11 +601,12 @@ void CFtpListResult::SendToMessageLog()
   int oldbufferpos = pos;
   curpos = listhead;
   pos=0;
-  char *line = GetLine();
+  t_line line;
+  bool more = GetLine(line);
   // Note that FZ_LOG_INFO here is not checked against debug level, as the direct
   // call to PostMessage bypasses check in LogMessage.
   // So we get the listing on any logging level, what is actually what we want
-  if (!line)
+  if (!more)
   {
     //Displays a message in the message log
     t_ffam_statusmessage *pStatus = new t_ffam_statusmessage();
@@ -658,10 +615,10 @@ void CFtpListResult::SendToMessageLog()
     pStatus->type = FZ_LOG_INFO;
     GetIntern()->FZPostMessage(FZ_MSG_MAKEMSG(FZ_MSG_STATUS, 0), (LPARAM)pStatus);
   }
-  while (line)
+  while (more)
   {
-    CString status = line;
-    nb_free(line);
+    CString status = line.str;
+    FreeLine(line);
 
     //Displays a message in the message log
     t_ffam_statusmessage *pStatus = new t_ffam_statusmessage();
@@ -671,25 +628,34 @@ void CFtpListResult::SendToMessageLog()
     if (!GetIntern()->FZPostMessage(FZ_MSG_MAKEMSG(FZ_MSG_STATUS, 0), (LPARAM)pStatus))
       delete pStatus;
 
-    line = GetLine();
+    more = GetLine(line);
   }
   curpos = oldlistpos;
   pos = oldbufferpos;
 }
 
-char * CFtpListResult::GetLine()
+// Lines that were already returned are terminated in place by a null char,
+// so it is treated as a line end as well, to get the same lines when reading
+// the buffers again
+static inline bool IsLineEnd(char c)
+{
+  return (c == '\r') || (c == '\n') || (c == '\0');
+}
+
+bool CFtpListResult::GetLine(t_line & line)
 {
+  line = t_line();
   if (!curpos)
-    return 0;
+    return false;
   int len=curpos->len;
-  while (curpos->buffer[pos]=='\r' || curpos->buffer[pos]=='\n' || curpos->buffer[pos]==' ' || curpos->buffer[pos]=='\t')
+  while (IsLineEnd(curpos->buffer[pos]) || curpos->buffer[pos]==' ' || curpos->buffer[pos]=='\t')
   {
     pos++;
     if (pos>=len)
     {
       curpos=curpos->next;
       if (!curpos)
-        return 0;
+        return false;
       len=curpos->len;
       pos=0;
     }
@@ -701,7 +667,7 @@ char * CFtpListResult::GetLine()
 
   int emptylen=0;
 
-  while ((curpos->buffer[pos]!='\n')&&(curpos->buffer[pos]!='\r'))
+  while (!IsLineEnd(curpos->buffer[pos]))
   {
     if (curpos->buffer[pos]!=' ' && curpos->buffer[pos]!='\t')
     {
@@ -721,6 +687,16 @@ char * CFtpListResult::GetLine()
     }
   }
 
+  line.len = reslen;
+  if (startptr == curpos)
+  {
+    // The line and its end are in one buffer, no need to copy it,
+    // the end (or trailing whitespace) can be overwritten
+    line.str = &startptr->buffer[startpos];
+    line.str[reslen] = 0;
+    return true;
+  }
+
   char *res = nb::chcalloc(reslen+1);
   res[reslen]=0;
   int respos=0;
@@ -743,7 +719,16 @@ char * CFtpListResult::GetLine()
     memcpy(&res[respos], &curpos->buffer[startpos], copylen);
   }
 
-  return res;
+  line.str = res;
+  line.owned = true;
+  return true;
+}
+
+void CFtpListResult::FreeLine(t_line & line)
+{
+  if (line.owned)
+    nb_free(line.str);
+  line = t_line();
 }
 
 void CFtpListResult::AddLine(t_directory::t_direntry &direntry)
@@ -42,6 +42,7 @@ private:
   tEntryList m_EntryList;
 
   BOOL parseLine(const char * lineToParse, const int linelen, t_directory::t_direntry & direntry, int & nFTPServerType, bool mlst);
+  BOOL parseAs(int format, const char * line, const int linelen, t_directory::t_direntry & direntry, bool mlst);
 
   BOOL parseAsVMS(const char * line, const int linelen, t_directory::t_direntry & direntry);
   BOOL parseAsEPLF(const char * line, const int linelen, t_directory::t_direntry & direntry);
@@ -63,6 +64,26 @@ private:
 
   bool parseMlsdDateTime(const CString value, t_directory::t_direntry::t_date & date) const;
 
+  // Formats in the order they are tried, listings usually use one only,
+  // so the last one that succeeded is tried first
+  enum
+  {
+    FORMAT_NONE,
+    FORMAT_MLSD,
+    FORMAT_UNIX,
+    FORMAT_DOS,
+    FORMAT_EPLF,
+    FORMAT_VMS,
+    FORMAT_OTHER,
+    FORMAT_IBMMVS,
+    FORMAT_IBMMVSPDS,
+    FORMAT_IBM,
+    FORMAT_WFFTP,
+    // Should be last, it is too lax to be tried first
+    FORMAT_IBMMVSPDS2,
+  };
+  int m_lastFormat;
+
   int pos;
   struct t_list // : public TObject
   {
@@ -86,8 +107,18 @@ protected:
   const char * strnstr(const char * str, int len, const char * c) const;
   _int64 strntoi64(const char * str, int len) const;
   void AddLine(t_directory::t_direntry & direntry);
-  char * GetLine();
+  // Line either points directly into the received buffer (terminated in place)
+  // or, if it spans more buffers, is an allocated copy
+  struct t_line
+  {
+    t_line() : str(0), len(0), owned(false) {}
+    char * str;
+    int len;
+    bool owned;
+  };
+  bool GetLine(t_line & line);
+  void FreeLine(t_line & line);
+  void ParseLines(bool mlst, bool partial);
   bool IsNumeric(const char * str, int len) const;
-  char * m_prevline;
-  char * m_curline;
+  t_line m_prevline;
 };
@@ -14,6 +14,9 @@
 #endif
 
 #define BUFSIZE 16384
+// Download buffer starts here and doubles whenever a receive fills it
+#define MINDOWNLOADBUFSIZE (256 * 1024)
+#define MAXDOWNLOADBUFSIZE (4 * 1024 * 1024)
 
 #define STATE_WAITING    0
 #define STATE_STARTING    1
@@ -35,6 +38,7 @@ CTransferSocket::CTransferSocket(CFtpControlSocket *pOwner, int nMode)
   m_pBuffer2 = 0;
 #endif
   m_bufferpos = 0;
+  m_nBufSize = MINDOWNLOADBUFSIZE;
   m_pFile = 0;
   m_bListening = FALSE;
   m_bSentClose = FALSE;
@@ -159,11 +163,7 @@ void CTransferSocket::OnReceive(int nErrorCode)
 #endif
         m_pListResult->AddData(buffer, numread);
       m_transferdata.transfersize += numread;
-      t_ffam_transferstatus *status = new t_ffam_transferstatus();
-      status->bFileTransfer = FALSE;
-      status->transfersize = -1;
-      status->bytes = m_transferdata.transfersize;
-      GetIntern()->FZPostMessage(FZ_MSG_MAKEMSG(FZ_MSG_TRANSFERSTATUS, 0), (LPARAM)status);
+      GetIntern()->FZPostTransferStatus(m_transferdata.transfersize, -1, false);
     }
     else
       nb_free(buffer);
@@ -199,9 +199,9 @@ void CTransferSocket::OnReceive(int nErrorCode)
     bool beenWaiting = false;
     _int64 ableToRead;
     if (GetState() != closed)
-      ableToRead = m_pOwner->GetAbleToTransferSize(CFtpControlSocket::download, beenWaiting);
+      ableToRead = m_pOwner->GetAbleToTransferSize(CFtpControlSocket::download, beenWaiting, m_nBufSize);
     else
-      ableToRead = BUFSIZE;
+      ableToRead = m_nBufSize;
 
     if (!beenWaiting)
       DebugAssert(ableToRead);
@@ -212,23 +212,103 @@ void CTransferSocket::OnReceive(int nErrorCode)
     }
 
     if (!m_pBuffer)
-      m_pBuffer = nb::chcalloc(BUFSIZE);
+      m_pBuffer = nb::chcalloc(m_nBufSize);
 
-    int numread = CAsyncSocketEx::Receive(m_pBuffer, static_cast<int>(ableToRead));
-    if (numread!=SOCKET_ERROR)
+    // Collect all that the socket has ready, up to the buffer size,
+    // so that the file is written in large blocks, not per receive
+    int numread = 0;
+    int received;
+    do
     {
-      m_pOwner->SpeedLimitAddTransferredBytes(CFtpControlSocket::download, numread);
+      received = CAsyncSocketEx::Receive(m_pBuffer + numread, static_cast<int>(ableToRead) - numread);
+      if (received > 0)
+      {
+        m_pOwner->SpeedLimitAddTransferredBytes(CFtpControlSocket::download, received);
+        numread += received;
+      }
     }
+    while ((received > 0) && (numread < ableToRead));
+    int nError = (received == SOCKET_ERROR) ? GetLastError() : 0;
 
-    if (!numread)
+    if (numread > 0)
+    {
+      int written = 0;
+      m_LastActiveTime = CTime::GetCurrentTime();
+      TRY
+      {
+#ifndef MPEXT_NO_ZLIB
+        if (m_useZlib)
+        {
+          if (!m_pBuffer2)
+            m_pBuffer2 = nb::calloc(m_nBufSize);
+
+          m_zlibStream.next_in = (Bytef *)m_pBuffer;
+          m_zlibStream.avail_in = numread;
+          m_zlibStream.next_out = (Bytef *)m_pBuffer2;
+          m_zlibStream.avail_out = m_nBufSize;
+          int res = inflate(&m_zlibStream, 0);
+          while (res == Z_OK)
+          {
+            m_pFile->Write(m_pBuffer2, m_nBufSize - m_zlibStream.avail_out);
+            written += m_nBufSize - m_zlibStream.avail_out;
+            m_zlibStream.next_out = (Bytef *)m_pBuffer2;
+            m_zlibStream.avail_out = m_nBufSize;
+            res = inflate(&m_zlibStream, 0);
+          }
+          if (res == Z_STREAM_END)
+          {
+            m_pFile->Write(m_pBuffer2, m_nBufSize - m_zlibStream.avail_out);
+            written += m_nBufSize - m_zlibStream.avail_out;
+          }
+          else if (res != Z_OK && res != Z_BUF_ERROR)
+          {
+            m_pOwner->ShowStatus(L"Compression error", FZ_LOG_ERROR);
+            CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
+            return;
+          }
+        }
+        else
+#endif
+        {
+          m_pFile->Write(m_pBuffer, numread);
+          written = numread;
+        }
+      }
+      CATCH(CFileException,e)
+      {
+        LPTSTR msg = nb::wchcalloc(BUFSIZE);
+        if (e->GetErrorMessage(msg, BUFSIZE))
+          m_pOwner->ShowStatus(msg, FZ_LOG_ERROR);
+        nb_free(msg);
+        CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
+        return;
+      }
+      END_CATCH;
+      m_transferdata.transferleft -= written;
+
+      // The buffer was filled and the speed limit did not cap the read,
+      // so the data arrive faster than we take them, use larger buffers.
+      // They are reallocated on the next receive.
+      if ((numread == m_nBufSize) && (m_nBufSize < MAXDOWNLOADBUFSIZE))
+      {
+        m_nBufSize *= 2;
+        nb_free(m_pBuffer);
+        m_pBuffer = 0;
+#ifndef MPEXT_NO_ZLIB
+        nb_free(m_pBuffer2);
+        m_pBuffer2 = 0;
+#endif
+      }
+    }
+
+    if (!received)
     {
       CloseAndEnsureSendClose(0);
       return;
     }
 
-    if (numread == SOCKET_ERROR)
+    if (received == SOCKET_ERROR)
     {
-      int nError = GetLastError();
       if (nError == WSAENOTCONN)
       {
         //Not yet connected
@@ -244,64 +324,7 @@ void CTransferSocket::OnReceive(int nErrorCode)
         LogError(nError);
         CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
       }
-
-      UpdateStatusBar(false);
-      return;
-    }
-
-    int written = 0;
-    m_LastActiveTime = CTime::GetCurrentTime();
-    TRY
-    {
-#ifndef MPEXT_NO_ZLIB
-      if (m_useZlib)
-      {
-        if (!m_pBuffer2)
-          m_pBuffer2 = nb::calloc(BUFSIZE);
-
-        m_zlibStream.next_in = (Bytef *)m_pBuffer;
-        m_zlibStream.avail_in = numread;
-        m_zlibStream.next_out = (Bytef *)m_pBuffer2;
-        m_zlibStream.avail_out = BUFSIZE;
-        int res = inflate(&m_zlibStream, 0);
-        while (res == Z_OK)
-        {
-          m_pFile->Write(m_pBuffer2, BUFSIZE - m_zlibStream.avail_out);
-          written += BUFSIZE - m_zlibStream.avail_out;
-          m_zlibStream.next_out = (Bytef *)m_pBuffer2;
-          m_zlibStream.avail_out = BUFSIZE;
-          res = inflate(&m_zlibStream, 0);
-        }
-        if (res == Z_STREAM_END)
-        {
-          m_pFile->Write(m_pBuffer2, BUFSIZE - m_zlibStream.avail_out);
-          written += BUFSIZE - m_zlibStream.avail_out;
-        }
-        else if (res != Z_OK && res != Z_BUF_ERROR)
-        {
-          m_pOwner->ShowStatus(L"Compression error", FZ_LOG_ERROR);
-          CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
-          return;
-        }
-      }
-      else
-#endif
-      {
-        m_pFile->Write(m_pBuffer, numread);
-        written = numread;
-      }
     }
-    CATCH(CFileException,e)
-    {
-      LPTSTR msg = nb::wchcalloc(BUFSIZE);
-      if (e->GetErrorMessage(msg, BUFSIZE))
-        m_pOwner->ShowStatus(msg, FZ_LOG_ERROR);
-      nb_free(msg);
-      CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
-      return;
-    }
-    END_CATCH;
-    m_transferdata.transferleft -= written;
 
     UpdateStatusBar(false);
   }
@@ -876,12 +899,9 @@ void CTransferSocket::UpdateStatusBar(bool forceUpdate)
   }
 
   //Update the statusbar
-  t_ffam_transferstatus *status=new t_ffam_transferstatus;
-  status->bFileTransfer = m_nMode & (CSMODE_DOWNLOAD | CSMODE_UPLOAD);
-  status->transfersize = m_transferdata.transfersize;
-  status->bytes=m_transferdata.transfersize-m_transferdata.transferleft;
-
-  GetIntern()->FZPostMessage(FZ_MSG_MAKEMSG(FZ_MSG_TRANSFERSTATUS, 0), (LPARAM)status);
+  GetIntern()->FZPostTransferStatus(
+    m_transferdata.transfersize-m_transferdata.transferleft, m_transferdata.transfersize,
+    (m_nMode & (CSMODE_DOWNLOAD | CSMODE_UPLOAD)) != 0);
 }
 
 BOOL CTransferSocket::Create(BOOL bUseSsl)
@@ -67,6 +67,7 @@ protected:
   BOOL m_bSentClose;
   int m_bufferpos;
   char * m_pBuffer;
+  int m_nBufSize; // Download buffer size, grows with the transfer speed
 #ifndef MPEXT_NO_ZLIB
   char * m_pBuffer2; // Used by zlib transfers
 #endif